@@ -0,0 +1,342 @@
+#include "batch.h"
+
+#include <SDL3/SDL_assert.h>
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_timer.h>
+
+/* Games per unit of work. Each chunk runs all ticks of a run back to back. */
+#define BATCH_CHUNK_GAMES 64
+
+/* Chunk ranges are packed into one 32-bit atomic, begin in the low half */
+#define BATCH_MAX_CHUNKS 0xFFFF
+
+typedef struct BatchWorker
+{
+	/*
+	 * Chunks [begin, end) this worker has yet to claim, packed as
+	 * begin | end << 16. The owner takes from the front, thieves split off
+	 * the back half, both with a compare-and-swap.
+	 */
+	SDL_AtomicU32 range;
+	int index;
+	TetrisBatch* batch;
+	SDL_Thread* thread;
+
+	Uint64 ticks;
+	Uint64 games_over;
+	Uint64 slow_ticks;
+	Uint64 steals;
+
+	/* keep neighbouring workers' ranges off this cache line */
+	Uint8 padding[64];
+} BatchWorker;
+
+struct TetrisBatch
+{
+	Uint32 num_games;
+	Uint32 num_chunks;
+
+	/*
+	 * Structure of arrays for what every tick reads. Most ticks have no key
+	 * presses and gravity is not yet due, so they only touch these.
+	 */
+	Uint64* drop_timer;
+	Uint8* piece;
+
+	/* Everything else; drop_timer and piece in here are only synced around tetris_tick */
+	Tetris* games;
+
+	Uint64 tick;
+
+	int num_workers;
+	BatchWorker* workers;
+	SDL_Semaphore* start;
+	SDL_Semaphore* done;
+	SDL_AtomicInt quit;
+
+	/* Current run */
+	Uint32 num_ticks;
+	Uint64 dt_ns;
+	TetrisBatchInputFunc input_fn;
+	void* userdata;
+};
+
+static void
+run_chunk(BatchWorker* worker, Uint32 chunk)
+{
+	TetrisBatch* batch = worker->batch;
+	Uint32 begin = chunk * BATCH_CHUNK_GAMES;
+	Uint32 end = SDL_min(begin + BATCH_CHUNK_GAMES, batch->num_games);
+	Uint64* drop_timer = batch->drop_timer;
+	Uint8* piece = batch->piece;
+	Uint64 dt_ns = batch->dt_ns;
+
+	for (Uint32 t = 0; t < batch->num_ticks; ++t)
+	{
+		Uint64 tick = batch->tick + t;
+		for (Uint32 i = begin; i < end; ++i)
+		{
+			Uint32 inputs = batch->input_fn ? batch->input_fn(batch->userdata, batch, i, tick) : 0;
+
+			/* What tetris_tick does when there is nothing to do but wait for gravity */
+			if (inputs == 0 && piece[i] != 0 && drop_timer[i] > dt_ns)
+			{
+				drop_timer[i] -= dt_ns;
+				continue;
+			}
+
+			Tetris* game = &batch->games[i];
+			game->drop_timer = drop_timer[i];
+			game->piece = piece[i];
+			int events = tetris_tick(game, inputs, dt_ns);
+			drop_timer[i] = game->drop_timer;
+			piece[i] = game->piece;
+
+			worker->slow_ticks += 1;
+			worker->games_over += (events & TETRIS_TICK_GAME_OVER) != 0;
+		}
+	}
+
+	worker->ticks += (Uint64)(end - begin) * batch->num_ticks;
+}
+
+static int
+claim_own(BatchWorker* worker, Uint32* chunk)
+{
+	for (;;)
+	{
+		Uint32 range = SDL_GetAtomicU32(&worker->range);
+		Uint32 begin = range & 0xFFFF;
+		Uint32 end = range >> 16;
+		if (begin >= end)
+		{
+			return 0;
+		}
+		if (SDL_CompareAndSwapAtomicU32(&worker->range, range, (begin + 1) | (end << 16)))
+		{
+			*chunk = begin;
+			return 1;
+		}
+	}
+}
+
+/*
+ * Takes the back half of the first non-empty range found, runs its first
+ * chunk and keeps the rest as the own range. Ranges only ever shrink, so a
+ * stale non-empty value can never compare equal again.
+ */
+static int
+steal(BatchWorker* thief, Uint32* chunk)
+{
+	TetrisBatch* batch = thief->batch;
+	for (int i = 1; i < batch->num_workers; ++i)
+	{
+		BatchWorker* victim = &batch->workers[(thief->index + i) % batch->num_workers];
+		for (;;)
+		{
+			Uint32 range = SDL_GetAtomicU32(&victim->range);
+			Uint32 begin = range & 0xFFFF;
+			Uint32 end = range >> 16;
+			if (begin >= end)
+			{
+				break;
+			}
+
+			Uint32 mid = end - (end - begin + 1) / 2;
+			if (SDL_CompareAndSwapAtomicU32(&victim->range, range, begin | (mid << 16)))
+			{
+				thief->steals += 1;
+				*chunk = mid;
+				SDL_SetAtomicU32(&thief->range, (mid + 1) | (end << 16));
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static void
+work(BatchWorker* worker)
+{
+	Uint32 chunk;
+	while (claim_own(worker, &chunk) || steal(worker, &chunk))
+	{
+		run_chunk(worker, chunk);
+	}
+}
+
+static int SDLCALL
+worker_thread(void* data)
+{
+	BatchWorker* worker = data;
+	TetrisBatch* batch = worker->batch;
+	for (;;)
+	{
+		SDL_WaitSemaphore(batch->start);
+		if (SDL_GetAtomicInt(&batch->quit))
+		{
+			return 0;
+		}
+		work(worker);
+		SDL_SignalSemaphore(batch->done);
+	}
+}
+
+TetrisBatch*
+tetris_batch_create(Uint32 num_games, int num_threads)
+{
+	if (num_games == 0 || (num_games + BATCH_CHUNK_GAMES - 1) / BATCH_CHUNK_GAMES > BATCH_MAX_CHUNKS)
+	{
+		SDL_SetError("Batch size %u out of range", num_games);
+		return NULL;
+	}
+
+	TetrisBatch* batch = SDL_calloc(1, sizeof(TetrisBatch));
+	if (!batch)
+	{
+		return NULL;
+	}
+
+	batch->num_games = num_games;
+	batch->num_chunks = (num_games + BATCH_CHUNK_GAMES - 1) / BATCH_CHUNK_GAMES;
+	batch->num_workers = num_threads > 0 ? num_threads : SDL_GetNumLogicalCPUCores();
+	batch->num_workers = SDL_clamp(batch->num_workers, 1, (int)batch->num_chunks);
+
+	/* All games start out over, so they reset on their first tick */
+	batch->drop_timer = SDL_aligned_alloc(64, num_games * sizeof(Uint64));
+	batch->piece = SDL_aligned_alloc(64, num_games * sizeof(Uint8));
+	batch->games = SDL_aligned_alloc(64, num_games * sizeof(Tetris));
+	batch->workers = SDL_aligned_alloc(64, batch->num_workers * sizeof(BatchWorker));
+	batch->start = SDL_CreateSemaphore(0);
+	batch->done = SDL_CreateSemaphore(0);
+	if (!batch->drop_timer || !batch->piece || !batch->games || !batch->workers || !batch->start || !batch->done)
+	{
+		tetris_batch_destroy(batch);
+		return NULL;
+	}
+	SDL_memset(batch->drop_timer, 0, num_games * sizeof(Uint64));
+	SDL_memset(batch->piece, 0, num_games * sizeof(Uint8));
+	SDL_memset(batch->games, 0, num_games * sizeof(Tetris));
+	SDL_memset(batch->workers, 0, batch->num_workers * sizeof(BatchWorker));
+
+	/* Worker 0 is whichever thread calls tetris_batch_run */
+	for (int i = 0; i < batch->num_workers; ++i)
+	{
+		BatchWorker* worker = &batch->workers[i];
+		worker->index = i;
+		worker->batch = batch;
+		if (i > 0)
+		{
+			worker->thread = SDL_CreateThread(worker_thread, "tetris_batch", worker);
+			if (!worker->thread)
+			{
+				tetris_batch_destroy(batch);
+				return NULL;
+			}
+		}
+	}
+
+	return batch;
+}
+
+void
+tetris_batch_destroy(TetrisBatch* batch)
+{
+	if (!batch)
+	{
+		return;
+	}
+
+	if (batch->workers)
+	{
+		SDL_SetAtomicInt(&batch->quit, 1);
+		for (int i = 1; i < batch->num_workers; ++i)
+		{
+			SDL_SignalSemaphore(batch->start);
+		}
+		for (int i = 1; i < batch->num_workers; ++i)
+		{
+			SDL_WaitThread(batch->workers[i].thread, NULL);
+		}
+	}
+
+	SDL_DestroySemaphore(batch->start);
+	SDL_DestroySemaphore(batch->done);
+	SDL_aligned_free(batch->workers);
+	SDL_aligned_free(batch->games);
+	SDL_aligned_free(batch->piece);
+	SDL_aligned_free(batch->drop_timer);
+	SDL_free(batch);
+}
+
+Uint32
+tetris_batch_num_games(const TetrisBatch* batch)
+{
+	return batch->num_games;
+}
+
+void
+tetris_batch_run(TetrisBatch* batch, Uint32 num_ticks, Uint64 dt_ns,
+	TetrisBatchInputFunc input_fn, void* userdata, TetrisBatchStats* stats)
+{
+	Uint64 start_ns = SDL_GetTicksNS();
+
+	batch->num_ticks = num_ticks;
+	batch->dt_ns = dt_ns;
+	batch->input_fn = input_fn;
+	batch->userdata = userdata;
+
+	for (int i = 0; i < batch->num_workers; ++i)
+	{
+		BatchWorker* worker = &batch->workers[i];
+		Uint32 begin = (Uint32)((Uint64)batch->num_chunks * i / batch->num_workers);
+		Uint32 end = (Uint32)((Uint64)batch->num_chunks * (i + 1) / batch->num_workers);
+		SDL_SetAtomicU32(&worker->range, begin | (end << 16));
+		worker->ticks = 0;
+		worker->games_over = 0;
+		worker->slow_ticks = 0;
+		worker->steals = 0;
+	}
+
+	for (int i = 1; i < batch->num_workers; ++i)
+	{
+		SDL_SignalSemaphore(batch->start);
+	}
+	work(&batch->workers[0]);
+	for (int i = 1; i < batch->num_workers; ++i)
+	{
+		SDL_WaitSemaphore(batch->done);
+	}
+
+	batch->tick += num_ticks;
+
+	if (stats)
+	{
+		SDL_zerop(stats);
+		for (int i = 0; i < batch->num_workers; ++i)
+		{
+			stats->ticks += batch->workers[i].ticks;
+			stats->games_over += batch->workers[i].games_over;
+			stats->slow_ticks += batch->workers[i].slow_ticks;
+			stats->steals += batch->workers[i].steals;
+		}
+		stats->elapsed_ns = SDL_GetTicksNS() - start_ns;
+		if (stats->elapsed_ns > 0)
+		{
+			stats->ticks_per_sec = (double)stats->ticks * 1e9 / (double)stats->elapsed_ns;
+			stats->games_per_sec = (double)stats->games_over * 1e9 / (double)stats->elapsed_ns;
+		}
+	}
+}
+
+void
+tetris_batch_get(const TetrisBatch* batch, Uint32 game, Tetris* out)
+{
+	SDL_assert(game < batch->num_games);
+	*out = batch->games[game];
+	out->drop_timer = batch->drop_timer[game];
+	out->piece = batch->piece[game];
+}
@@ -0,0 +1,47 @@
+/*
+ * Steps many independent games in lockstep on all cores, for bots and
+ * benchmarks. Every game follows exactly the rules of tetris_tick.
+ */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <SDL3/SDL_stdinc.h>
+
+#include "tetris.h"
+
+typedef struct TetrisBatch TetrisBatch;
+
+/*
+ * Returns the TETRIS_INPUT_* key presses of one game for one tick. Called
+ * from worker threads, but never concurrently for the same game.
+ */
+typedef Uint32 (*TetrisBatchInputFunc)(void* userdata, const TetrisBatch* batch, Uint32 game, Uint64 tick);
+
+typedef struct TetrisBatchStats
+{
+	Uint64 ticks;       /* game ticks simulated, num_games per lockstep tick */
+	Uint64 games_over;  /* games that ended and restarted */
+	Uint64 slow_ticks;  /* ticks that went through tetris_tick, the rest only counted down gravity */
+	Uint64 steals;      /* work ranges taken from another thread */
+	Uint64 elapsed_ns;
+	double ticks_per_sec;
+	double games_per_sec;
+} TetrisBatchStats;
+
+/* num_threads <= 0 uses every logical core. Returns NULL on failure. */
+TetrisBatch* tetris_batch_create(Uint32 num_games, int num_threads);
+void tetris_batch_destroy(TetrisBatch* batch);
+
+Uint32 tetris_batch_num_games(const TetrisBatch* batch);
+
+/*
+ * Advances every game by num_ticks ticks of dt_ns nanoseconds each. input_fn
+ * may be NULL for no key presses. stats may be NULL.
+ */
+void tetris_batch_run(TetrisBatch* batch, Uint32 num_ticks, Uint64 dt_ns,
+	TetrisBatchInputFunc input_fn, void* userdata, TetrisBatchStats* stats);
+
+/* Copies out the full state of one game */
+void tetris_batch_get(const TetrisBatch* batch, Uint32 game, Tetris* out);
+
+#endif /* BATCH_H */
@@ -0,0 +1,1194 @@
+/*
+ * Microbenchmarks for the hot paths of sdlgputest. Plain console program;
+ * only the render benchmark needs a GPU, and it runs headless on the
+ * offscreen video driver. Every result is also collected as ns and heap
+ * allocations per operation, printed as JSON with --json.
+ */
+
+#include <stdio.h>
+
+#include <SDL3/SDL.h>
+
+#include "batch.h"
+#include "frametimes.h"
+#include "movegen.h"
+#include "render.h"
+#include "rewind.h"
+#include "versus.h"
+#include "tetris.h"
+#include "vecmath.h"
+
+/*
+ * The scalar float[16] matrix helpers main.c used before vecmath.h, kept
+ * here as the reference to compare against.
+ */
+static void
+rotate_matrix(float angle, float x, float y, float z, float* r)
+{
+	float radians, c, s, c1, u[3], length;
+	int i, j;
+
+	radians = angle * SDL_PI_F / 180.0f;
+
+	c = SDL_cosf(radians);
+	s = SDL_sinf(radians);
+
+	c1 = 1.0f - SDL_cosf(radians);
+
+	length = (float)SDL_sqrt(x * x + y * y + z * z);
+
+	u[0] = x / length;
+	u[1] = y / length;
+	u[2] = z / length;
+
+	for (i = 0; i < 16; i++) {
+		r[i] = 0.0;
+	}
+
+	r[15] = 1.0;
+
+	for (i = 0; i < 3; i++) {
+		r[i * 4 + (i + 1) % 3] = u[(i + 2) % 3] * s;
+		r[i * 4 + (i + 2) % 3] = -u[(i + 1) % 3] * s;
+	}
+
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 3; j++) {
+			r[i * 4 + j] += c1 * u[i] * u[j] + (i == j ? c : 0.0f);
+		}
+	}
+}
+
+static void
+perspective_matrix(float fovy, float aspect, float znear, float zfar, float* r)
+{
+	int i;
+	float f;
+
+	f = 1.0f / SDL_tanf(fovy * 0.5f);
+
+	for (i = 0; i < 16; i++) {
+		r[i] = 0.0;
+	}
+
+	r[0] = f / aspect;
+	r[5] = f;
+	r[10] = (znear + zfar) / (znear - zfar);
+	r[11] = -1.0f;
+	r[14] = (2.0f * znear * zfar) / (znear - zfar);
+	r[15] = 0.0f;
+}
+
+static void
+multiply_matrix(float* lhs, float* rhs, float* r)
+{
+	int i, j, k;
+	float tmp[16];
+
+	for (i = 0; i < 4; i++) {
+		for (j = 0; j < 4; j++) {
+			tmp[j * 4 + i] = 0.0;
+
+			for (k = 0; k < 4; k++) {
+				tmp[j * 4 + i] += lhs[k * 4 + i] * rhs[j * 4 + k];
+			}
+		}
+	}
+
+	for (i = 0; i < 16; i++) {
+		r[i] = tmp[i];
+	}
+}
+
+/* The piece cell lookup tetris.c used before the piece_shapes table */
+static void
+get_piece_coords(Uint8 piece, int x, int y, Uint8 rot, int* xs_out, int* ys_out)
+{
+	//                  L          J          S          Z          T          O          I
+	const int xs[] = { -1,-1, 1,  -1, 1, 1,  -1, 0, 1,  -1, 0,-1,  -1, 0, 1,  -1,-1, 0,  -2,-1, 1 };
+	const int ys[] = { -1, 0, 0,   0, 0,-1,  -1,-1, 0,   0,-1,-1,   0,-1, 0,  -1, 0,-1,   0, 0, 0 };
+	int o = (piece - 1) * 3;
+	switch (rot)
+	{
+	case 0:
+		xs_out[0] = x + xs[o + 0]; xs_out[1] = x + xs[o + 1]; xs_out[2] = x + xs[o + 2];
+		ys_out[0] = y + ys[o + 0]; ys_out[1] = y + ys[o + 1]; ys_out[2] = y + ys[o + 2];
+		break;
+	case 1:
+		xs_out[0] = x + ys[o + 0]; xs_out[1] = x + ys[o + 1]; xs_out[2] = x + ys[o + 2];
+		ys_out[0] = y - xs[o + 0]; ys_out[1] = y - xs[o + 1]; ys_out[2] = y - xs[o + 2];
+		break;
+	case 2:
+		xs_out[0] = x - xs[o + 0]; xs_out[1] = x - xs[o + 1]; xs_out[2] = x - xs[o + 2];
+		ys_out[0] = y - ys[o + 0]; ys_out[1] = y - ys[o + 1]; ys_out[2] = y - ys[o + 2];
+		break;
+	case 3:
+		xs_out[0] = x - ys[o + 0]; xs_out[1] = x - ys[o + 1]; xs_out[2] = x - ys[o + 2];
+		ys_out[0] = y + xs[o + 0]; ys_out[1] = y + xs[o + 1]; ys_out[2] = y + xs[o + 2];
+		break;
+	default:
+		SDL_assert_always(!"rot < 4");
+	}
+
+	xs_out[3] = x;
+	ys_out[3] = y;
+}
+
+/* Keeps results alive so the compiler cannot drop the benchmarked work */
+static volatile float sink;
+
+/* Every SDL_malloc, SDL_calloc and SDL_realloc, counted from main on */
+static SDL_AtomicInt num_allocs;
+static SDL_malloc_func real_malloc;
+static SDL_calloc_func real_calloc;
+static SDL_realloc_func real_realloc;
+static SDL_free_func real_free;
+
+static void* SDLCALL
+counting_malloc(size_t size)
+{
+	SDL_AddAtomicInt(&num_allocs, 1);
+	return real_malloc(size);
+}
+
+static void* SDLCALL
+counting_calloc(size_t nmemb, size_t size)
+{
+	SDL_AddAtomicInt(&num_allocs, 1);
+	return real_calloc(nmemb, size);
+}
+
+static void* SDLCALL
+counting_realloc(void* mem, size_t size)
+{
+	SDL_AddAtomicInt(&num_allocs, 1);
+	return real_realloc(mem, size);
+}
+
+typedef struct BenchResult
+{
+	const char* name;
+	double ns_per_op;
+	double allocs_per_op;
+} BenchResult;
+
+#define MAX_RESULTS 64
+
+static BenchResult results[MAX_RESULTS];
+static int num_results;
+
+static void
+record_result(const char* name, double ns_per_op, double allocs_per_op)
+{
+	if (num_results < MAX_RESULTS) {
+		results[num_results].name = name;
+		results[num_results].ns_per_op = ns_per_op;
+		results[num_results].allocs_per_op = allocs_per_op;
+		num_results += 1;
+	}
+}
+
+typedef struct BenchTimer
+{
+	Uint64 counter;
+	int allocs;
+} BenchTimer;
+
+static BenchTimer
+timer_start(void)
+{
+	BenchTimer timer;
+	timer.allocs = SDL_GetAtomicInt(&num_allocs);
+	timer.counter = SDL_GetPerformanceCounter();
+	return timer;
+}
+
+static double
+timer_ns(BenchTimer start, Uint64 ops)
+{
+	Uint64 elapsed = SDL_GetPerformanceCounter() - start.counter;
+	return (double)elapsed * 1e9 / (double)SDL_GetPerformanceFrequency() / (double)ops;
+}
+
+static double
+timer_allocs(BenchTimer start, Uint64 ops)
+{
+	return (double)(SDL_GetAtomicInt(&num_allocs) - start.allocs) / (double)ops;
+}
+
+/* Records the result under name and returns the ns per operation */
+static double
+timer_stop(BenchTimer start, const char* name, Uint64 ops)
+{
+	double ns = timer_ns(start, ops);
+	record_result(name, ns, timer_allocs(start, ops));
+	return ns;
+}
+
+/* Correctness checks done along the way, reported next to the timings */
+static float matrix_max_difference;
+static bool piece_coords_match = true;
+static bool batch_matches = true;
+static const char* render_status = "not run";
+static bool rewind_matches = true;
+static double rewind_bytes_per_tick;
+static double rewind_slowest_restore_ns;
+static const char* versus_status = "not run";
+static bool versus_matches = true;
+static Uint64 versus_rollbacks;
+static double versus_resim_8_ns;
+static TargetPoolStats resize_targets;
+static Uint32 headless_crc; /* of the first headless frame, the same on every run and machine if rendering is exact */
+static int msaa_samples;        /* of the 4x runs, fewer if the GPU has no 4x */
+static Uint64 msaa_bytes_saved; /* by resolving into the swapchain, the resolve texture the blit needs */
+static double msaa_ns_saved;    /* per frame, by resolving straight into the target instead of resolve plus blit */
+
+static float
+max_difference(const float* a, const mat4* b)
+{
+	float result = 0.0f;
+	for (int i = 0; i < 16; ++i) {
+		result = SDL_max(result, SDL_fabsf(a[i] - b->col[i / 4].f[i % 4]));
+	}
+	return result;
+}
+
+static void
+bench_matrix(int iterations)
+{
+	float lhs[16], rhs[16], out[16];
+	mat4 lhs4, rhs4, out4;
+	BenchTimer start;
+	double scalar_ns, vector_ns;
+
+	rotate_matrix(30.0f, 1.0f, 0.0f, 0.0f, lhs);
+	rotate_matrix(20.0f, 0.0f, 1.0f, 0.0f, rhs);
+	mat4_rotate(30.0f, 1.0f, 0.0f, 0.0f, &lhs4);
+	mat4_rotate(20.0f, 0.0f, 1.0f, 0.0f, &rhs4);
+
+	/* multiply */
+	start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		multiply_matrix(lhs, rhs, out);
+		rhs[12] = out[0];
+	}
+	scalar_ns = timer_stop(start, "matrix.multiply.scalar", iterations);
+	sink = out[0];
+
+	start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		mat4_mul(&lhs4, &rhs4, &out4);
+		rhs4.col[3].f[0] = out4.col[0].f[0];
+	}
+	vector_ns = timer_stop(start, "matrix.multiply.vecmath", iterations);
+	sink = out4.col[0].f[0];
+	SDL_Log("multiply     scalar %7.2f ns  vecmath %7.2f ns  (%.1fx)", scalar_ns, vector_ns, scalar_ns / vector_ns);
+
+	/* rotate */
+	start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		rotate_matrix((float)(i % 360), 0.0f, 1.0f, 0.0f, out);
+		sink = out[0];
+	}
+	scalar_ns = timer_stop(start, "matrix.rotate.scalar", iterations);
+
+	start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		mat4_rotate((float)(i % 360), 0.0f, 1.0f, 0.0f, &out4);
+		sink = out4.col[0].f[0];
+	}
+	vector_ns = timer_stop(start, "matrix.rotate.vecmath", iterations);
+	SDL_Log("rotate       scalar %7.2f ns  vecmath %7.2f ns  (%.1fx)", scalar_ns, vector_ns, scalar_ns / vector_ns);
+
+	/* perspective */
+	start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		perspective_matrix(45.0f, 1.0f + (float)(i & 7), 0.01f, 100.0f, out);
+		sink = out[0];
+	}
+	scalar_ns = timer_stop(start, "matrix.perspective.scalar", iterations);
+
+	start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		mat4_perspective(45.0f, 1.0f + (float)(i & 7), 0.01f, 100.0f, &out4);
+		sink = out4.col[0].f[0];
+	}
+	vector_ns = timer_stop(start, "matrix.perspective.vecmath", iterations);
+	SDL_Log("perspective  scalar %7.2f ns  vecmath %7.2f ns  (%.1fx)", scalar_ns, vector_ns, scalar_ns / vector_ns);
+
+	/* results must agree */
+	rotate_matrix(33.0f, 1.0f, 2.0f, 3.0f, lhs);
+	perspective_matrix(45.0f, 0.5f, 0.01f, 100.0f, rhs);
+	multiply_matrix(rhs, lhs, out);
+	mat4_rotate(33.0f, 1.0f, 2.0f, 3.0f, &lhs4);
+	mat4_perspective(45.0f, 0.5f, 0.01f, 100.0f, &rhs4);
+	mat4_mul(&rhs4, &lhs4, &out4);
+	float rotate_difference = max_difference(lhs, &lhs4);
+	float perspective_difference = max_difference(rhs, &rhs4);
+	float multiply_difference = max_difference(out, &out4);
+	SDL_Log("max difference rotate %g, perspective %g, multiply %g",
+		rotate_difference, perspective_difference, multiply_difference);
+	matrix_max_difference = SDL_max(rotate_difference, SDL_max(perspective_difference, multiply_difference));
+}
+
+/*
+ * The per-frame matrix work of Render for a full 220 cell board: before,
+ * a full multiply per cell; now one view-projection per frame and one
+ * translation column update per cell.
+ */
+static void
+bench_frame(int iterations)
+{
+	float modelview[16], perspective[16], final[16];
+	mat4 modelview4, perspective4, final4;
+	BenchTimer start;
+	double scalar_ns, vector_ns;
+
+	rotate_matrix(30.0f, 1.0f, 0.0f, 0.0f, modelview);
+	perspective_matrix(45.0f, 0.5f, 0.01f, 100.0f, perspective);
+	mat4_rotate(30.0f, 1.0f, 0.0f, 0.0f, &modelview4);
+	mat4_perspective(45.0f, 0.5f, 0.01f, 100.0f, &perspective4);
+
+	start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		modelview[14] = -22.0f;
+		for (int cell = 0; cell < 220; ++cell) {
+			modelview[12] = (float)(cell % 10) - 4.5f;
+			modelview[13] = (float)(cell / 10) - 10.5f;
+			multiply_matrix(perspective, modelview, final);
+			sink = final[12];
+		}
+	}
+	scalar_ns = timer_stop(start, "frame_matrices.scalar", iterations);
+
+	start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		mat4 viewproj;
+		mat4_mul(&perspective4, &modelview4, &viewproj);
+		for (int cell = 0; cell < 220; ++cell) {
+			mat4_translate(&viewproj, (float)(cell % 10) - 4.5f, (float)(cell / 10) - 10.5f, -22.0f, &final4);
+			sink = final4.col[3].f[0];
+		}
+	}
+	vector_ns = timer_stop(start, "frame_matrices.vecmath", iterations);
+	SDL_Log("220 cells    scalar %7.0f ns  vecmath %7.0f ns  (%.1fx)", scalar_ns, vector_ns, scalar_ns / vector_ns);
+}
+
+/* Headless simulation speed with a pseudo random stream of key presses */
+static void
+bench_tick(int iterations)
+{
+	static const Uint32 keys[8] = {
+		TETRIS_INPUT_LEFT, TETRIS_INPUT_RIGHT, TETRIS_INPUT_ROTATE, TETRIS_INPUT_DOWN,
+		TETRIS_INPUT_DROP, 0, 0, 0
+	};
+	Tetris tetris;
+	Uint32 seed = 1;
+	int games = 0;
+
+	tetris_reset(&tetris);
+	BenchTimer start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		seed = seed * 1664525u + 1013904223u;
+		games += (tetris_tick(&tetris, keys[seed >> 29], 16666667) & TETRIS_TICK_GAME_OVER) != 0;
+	}
+	double tick_ns = timer_stop(start, "tetris_tick", iterations);
+	SDL_Log("tetris_tick  %7.2f ns  (%.1f M ticks/s, %d games)", tick_ns, 1e3 / tick_ns, games);
+}
+
+static void
+bench_piece_coords(int iterations)
+{
+	static const Uint8 rots[8] = { 1, 4, 4, 2, 2, 4, 1, 2 };
+	int xs[4], ys[4];
+	int total = 0;
+
+	BenchTimer start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		Uint8 piece = (Uint8)(i % 7 + 1);
+		get_piece_coords(piece, 5, 10, (Uint8)(i % rots[piece]), xs, ys);
+		total += xs[i & 3] + ys[i & 3];
+	}
+	double old_ns = timer_stop(start, "piece_coords.get_piece_coords", iterations);
+
+	start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		Uint8 piece = (Uint8)(i % 7 + 1);
+		const PieceShape* shape = &piece_shapes[piece][i % rots[piece]];
+		for (int k = 0; k < 4; ++k) {
+			xs[k] = 5 + shape->xs[k];
+			ys[k] = 10 + shape->ys[k];
+		}
+		total += xs[i & 3] + ys[i & 3];
+	}
+	double table_ns = timer_stop(start, "piece_coords.piece_shapes", iterations);
+	sink = (float)total;
+
+	/* Same cells in the same order for every rotation a piece can be in */
+	for (Uint8 piece = 1; piece < 8; ++piece) {
+		for (Uint8 rot = 0; rot < rots[piece]; ++rot) {
+			get_piece_coords(piece, 5, 10, rot, xs, ys);
+			const PieceShape* shape = &piece_shapes[piece][rot];
+			for (int k = 0; k < 4; ++k) {
+				piece_coords_match &= xs[k] == 5 + shape->xs[k] && ys[k] == 10 + shape->ys[k];
+			}
+		}
+	}
+
+	SDL_Log("piece cells  get_piece_coords %5.2f ns  piece_shapes %5.2f ns  (%.1fx)%s",
+		old_ns, table_ns, old_ns / table_ns, piece_coords_match ? "" : "  DO NOT MATCH");
+}
+
+static void
+bench_try_move(int iterations)
+{
+	Tetris tetris;
+	int moved = 0;
+
+	/* Side to side over an empty board, every move fits */
+	tetris_reset(&tetris);
+	BenchTimer start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		moved += try_move(&tetris, (i & 1) ? 1 : -1, 0, 0);
+	}
+	double free_ns = timer_stop(start, "try_move.free", iterations);
+
+	/* Down against the floor, every move is blocked */
+	while (try_move(&tetris, 0, -1, 0)) {
+	}
+	start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		moved += try_move(&tetris, 0, -1, 0);
+	}
+	double blocked_ns = timer_stop(start, "try_move.blocked", iterations);
+
+	tetris_reset(&tetris);
+	start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		moved += try_rotate(&tetris);
+	}
+	double rotate_ns = timer_stop(start, "try_rotate", iterations);
+	sink = (float)moved;
+
+	SDL_Log("try_move     %5.2f ns free  %5.2f ns blocked  try_rotate %5.2f ns", free_ns, blocked_ns, rotate_ns);
+}
+
+/* Hard drop from the spawn row onto the floor: one try_move per row as tetris_tick used to, against the skyline */
+static void
+bench_hard_drop(int iterations)
+{
+	Tetris tetris;
+	int fallen = 0;
+
+	tetris_reset(&tetris);
+	Tetris* volatile target = &tetris;
+	BenchTimer start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		Tetris probe = *target;
+		while (try_move(&probe, 0, -1, 0)) {
+			++fallen;
+		}
+	}
+	double loop_ns = timer_stop(start, "hard_drop.try_move_loop", iterations);
+
+	start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		fallen += tetris_drop_distance(target);
+	}
+	double skyline_ns = timer_stop(start, "hard_drop.skyline", iterations);
+	sink = (float)fallen;
+
+	SDL_Log("hard drop    %5.2f ns try_move loop  %5.2f ns skyline  (%.1fx)", loop_ns, skyline_ns, loop_ns / skyline_ns);
+}
+
+/*
+ * A vertical I dropped into column 0 next to a stack of four rows, of
+ * which lines are complete. Each iteration restores the board first; that
+ * copy is timed on its own and taken off.
+ */
+static void
+bench_glue(int iterations)
+{
+	static const char* names[5] = { "glue.0_lines", "glue.1_lines", "glue.2_lines", "glue.3_lines", "glue.4_lines" };
+
+	for (int lines = 0; lines <= 4; ++lines) {
+		Tetris before;
+		tetris_reset(&before);
+		for (int y = 0; y < 4; ++y) {
+			for (int x = 1; x < (y < lines ? 10 : 9); ++x) {
+				before.board[x + y * 10] = 1;
+				before.rows[y] |= (Uint16)(1 << x);
+			}
+		}
+		tetris_update_heights(&before);
+		before.piece = 7;
+		before.rot = 1;
+		before.x = 0;
+		before.y = 1;
+
+		/* Through a volatile pointer so the copy cannot be left out */
+		Tetris tetris;
+		Tetris* volatile target = &tetris;
+
+		BenchTimer start = timer_start();
+		for (int i = 0; i < iterations; ++i) {
+			*target = before;
+		}
+		double copy_ns = timer_ns(start, iterations);
+
+		start = timer_start();
+		for (int i = 0; i < iterations; ++i) {
+			*target = before;
+			glue(target);
+		}
+		double glue_ns = timer_ns(start, iterations) - copy_ns;
+		record_result(names[lines], glue_ns, timer_allocs(start, iterations));
+
+		SDL_Log("glue         %5.2f ns  (%d lines, %u cleared)", glue_ns, lines, tetris.lines);
+	}
+}
+
+static void
+bench_movegen(int iterations)
+{
+	static const char* perft_names[4] = { NULL, "perft.1", "perft.2", "perft.3" };
+	static TetrisPlacement placements[TETRIS_MAX_PLACEMENTS];
+	Tetris tetris;
+	int count = 0;
+
+	tetris_reset(&tetris);
+	BenchTimer start = timer_start();
+	for (int i = 0; i < iterations; ++i) {
+		count = tetris_generate_placements(&tetris, placements, TETRIS_MAX_PLACEMENTS);
+	}
+	double generate_ns = timer_stop(start, "movegen.generate", iterations);
+	SDL_Log("movegen      %7.0f ns  (%d placements)", generate_ns, count);
+
+	/* Per node */
+	for (int depth = 1; depth <= 3; ++depth) {
+		start = timer_start();
+		Uint64 nodes = tetris_perft(&tetris, depth);
+		double node_ns = timer_stop(start, perft_names[depth], nodes);
+		SDL_Log("perft %d      %llu  (%.0f ms, %.2f M nodes/s)", depth, (unsigned long long)nodes,
+			node_ns * (double)nodes / 1e6, 1e3 / node_ns);
+	}
+}
+
+/* A key press on one tick in eight, the same for any thread layout */
+static Uint32
+batch_input(void* userdata, const TetrisBatch* batch, Uint32 game, Uint64 tick)
+{
+	static const Uint32 keys[8] = {
+		TETRIS_INPUT_LEFT, TETRIS_INPUT_RIGHT, TETRIS_INPUT_ROTATE, TETRIS_INPUT_DOWN,
+		TETRIS_INPUT_DROP, TETRIS_INPUT_LEFT, TETRIS_INPUT_RIGHT, TETRIS_INPUT_ROTATE
+	};
+	Uint32 hash = (Uint32)(tick * 0x9E3779B1u) ^ (game * 0x85EBCA77u);
+	hash ^= hash >> 15;
+	hash *= 0xC2B2AE3Du;
+	hash ^= hash >> 13;
+	return (hash & 7) == 0 ? keys[(hash >> 3) & 7] : 0;
+}
+
+static void
+bench_batch(Uint32 num_games, Uint32 num_ticks)
+{
+	TetrisBatch* batch = tetris_batch_create(num_games, 0);
+	if (!batch) {
+		SDL_Log("tetris_batch_create failed: %s", SDL_GetError());
+		batch_matches = false;
+		return;
+	}
+
+	TetrisBatchStats stats;
+	BenchTimer start = timer_start();
+	tetris_batch_run(batch, num_ticks, 16666667, batch_input, NULL, &stats);
+	timer_stop(start, "batch.tick", stats.ticks);
+	SDL_Log("batch        %u games x %u ticks: %.1f M ticks/s, %.0f games/s, %.1f%% slow ticks, %llu steals",
+		num_games, num_ticks, stats.ticks_per_sec / 1e6, stats.games_per_sec,
+		100.0 * (double)stats.slow_ticks / (double)stats.ticks, (unsigned long long)stats.steals);
+
+	/* Spot check against plain single game play */
+	for (Uint32 game = 0; game < num_games; game += SDL_max(num_games / 16, 1)) {
+		Tetris expected, actual;
+		SDL_zero(expected);
+		for (Uint32 tick = 0; tick < num_ticks; ++tick) {
+			tetris_tick(&expected, batch_input(NULL, batch, game, tick), 16666667);
+		}
+		tetris_batch_get(batch, game, &actual);
+		batch_matches &= SDL_memcmp(&expected, &actual, sizeof(Tetris)) == 0;
+	}
+	SDL_Log("batch        %s single game play", batch_matches ? "matches" : "DOES NOT MATCH");
+
+	tetris_batch_destroy(batch);
+}
+
+/* Rewind arena for the benchmark, small enough that it wraps many times */
+#define BENCH_REWIND_CAPACITY (256 * 1024)
+
+/*
+ * A game at the sim thread's 1 ms tick pushed into a rewind buffer, then
+ * restored at random kept ticks and compared against full copies, also
+ * after truncating halfway and playing on differently.
+ */
+static void
+bench_rewind(Uint32 num_ticks)
+{
+	RewindBuffer* buffer = rewind_create(BENCH_REWIND_CAPACITY, REWIND_DEFAULT_KEYFRAME_INTERVAL);
+	Tetris* states = SDL_malloc(num_ticks * sizeof(Tetris));
+	if (!buffer || !states) {
+		SDL_Log("rewind       skipped: %s", SDL_GetError());
+		rewind_matches = false;
+		rewind_destroy(buffer);
+		SDL_free(states);
+		return;
+	}
+
+	Tetris tetris;
+	SDL_zero(tetris);
+	BenchTimer start = timer_start();
+	for (Uint32 tick = 0; tick < num_ticks; ++tick) {
+		tetris_tick(&tetris, batch_input(NULL, NULL, 0, tick / 16), tick % 16 == 0 ? 1000000 : 0);
+		rewind_push(buffer, &tetris);
+		states[tick] = tetris;
+	}
+	double push_ns = timer_stop(start, "rewind.push", num_ticks);
+
+	RewindStats stats;
+	rewind_get_stats(buffer, &stats);
+	rewind_bytes_per_tick = (double)stats.bytes_used / (double)stats.num_ticks;
+
+	/* Random kept ticks */
+	Uint32 seed = 1;
+	const int restores = 10000;
+	start = timer_start();
+	for (int i = 0; i < restores; ++i) {
+		seed = seed * 1664525u + 1013904223u;
+		Uint64 tick = stats.first_tick + seed % stats.num_ticks;
+		Tetris restored;
+		rewind_matches &= rewind_restore(buffer, tick, &restored) && SDL_memcmp(&restored, &states[tick], TETRIS_STATE_BYTES) == 0;
+	}
+	double restore_ns = timer_stop(start, "rewind.restore", restores);
+
+	/* The oldest keyframe starts the oldest tick; the slowest restore is the last tick before the next one */
+	Uint64 slowest = stats.first_tick + REWIND_DEFAULT_KEYFRAME_INTERVAL - 1;
+	for (int i = 0; i < 100; ++i) {
+		Tetris restored;
+		Uint64 counter = SDL_GetPerformanceCounter();
+		rewind_restore(buffer, slowest, &restored);
+		double ns = (double)(SDL_GetPerformanceCounter() - counter) * 1e9 / (double)SDL_GetPerformanceFrequency();
+		rewind_slowest_restore_ns = i == 0 ? ns : SDL_min(rewind_slowest_restore_ns, ns);
+	}
+	rewind_matches &= !rewind_restore(buffer, stats.first_tick - 1, &tetris) || stats.first_tick == 0;
+
+	/* Rewind to the middle of what is kept and play on with other inputs */
+	Uint64 middle = stats.first_tick + stats.num_ticks / 2;
+	rewind_matches &= rewind_truncate(buffer, middle) && rewind_restore(buffer, middle, &tetris);
+	for (Uint64 tick = middle + 1; tick < num_ticks; ++tick) {
+		tetris_tick(&tetris, batch_input(NULL, NULL, 1, (Uint32)tick / 16), tick % 16 == 0 ? 1000000 : 0);
+		rewind_push(buffer, &tetris);
+		states[tick] = tetris;
+	}
+	rewind_get_stats(buffer, &stats);
+	for (Uint64 tick = stats.first_tick; tick < num_ticks; ++tick) {
+		Tetris restored;
+		rewind_matches &= rewind_restore(buffer, tick, &restored) && SDL_memcmp(&restored, &states[tick], TETRIS_STATE_BYTES) == 0;
+	}
+
+	SDL_Log("rewind       %.1f ns/push, %.1f ns/restore (%.1f ns through a whole keyframe interval), %.1f bytes/tick against %u for a copy",
+		push_ns, restore_ns, rewind_slowest_restore_ns, rewind_bytes_per_tick, (unsigned)sizeof(Tetris));
+	SDL_Log("rewind       %" SDL_PRIu64 " ticks kept in %u KiB, %s full copies", stats.num_ticks, BENCH_REWIND_CAPACITY / 1024,
+		rewind_matches ? "matches" : "DOES NOT MATCH");
+
+	rewind_destroy(buffer);
+	SDL_free(states);
+}
+
+/* Ticks the second versus peer is held back, so the first predicts that many */
+#define BENCH_VERSUS_LAG 8
+
+/*
+ * Versus over loopback UDP: two peers in one process, the second kept
+ * BENCH_VERSUS_LAG ticks behind the first, which so rolls back about that
+ * far for every key press of the second. Both must end up with the same
+ * games.
+ */
+static void
+bench_versus(Uint32 num_ticks)
+{
+	NetSocket* sockets[2] = { net_open(0), net_open(0) };
+	Versus* peers[2] = { NULL, NULL };
+	for (int p = 0; p < 2 && sockets[0] && sockets[1]; ++p) {
+		NetAddress peer = { 0x7F000001, net_local_port(sockets[1 - p]) };
+		peers[p] = versus_create(sockets[p], &peer);
+	}
+	if (!peers[0] || !peers[1]) {
+		SDL_Log("versus       skipped, no loopback UDP: %s", SDL_GetError());
+		versus_status = "no sockets";
+		versus_destroy(peers[0]);
+		versus_destroy(peers[1]);
+		net_close(sockets[0]);
+		net_close(sockets[1]);
+		return;
+	}
+
+	Uint32 ticks[2] = { 0, 0 };
+	BenchTimer start = timer_start();
+	for (Uint32 i = 0; (ticks[0] < num_ticks || ticks[1] < num_ticks) && i < num_ticks * 4; ++i) {
+		for (int p = 0; p < 2; ++p) {
+			bool due = p == 0 || ticks[1] + BENCH_VERSUS_LAG <= ticks[0] || ticks[0] == num_ticks;
+			if (ticks[p] < num_ticks && due) {
+				ticks[p] += versus_tick(peers[p], batch_input(NULL, NULL, p, ticks[p]));
+			}
+			else {
+				versus_poll(peers[p]);
+			}
+		}
+	}
+	timer_stop(start, "versus.tick", ticks[0] + ticks[1]);
+
+	/* Until both have every input */
+	VersusStats stats[2];
+	for (int i = 0; i < 100; ++i) {
+		versus_poll(peers[0]);
+		versus_poll(peers[1]);
+		versus_get_stats(peers[0], &stats[0]);
+		versus_get_stats(peers[1], &stats[1]);
+		if (stats[0].confirmed_tick == num_ticks && stats[1].confirmed_tick == num_ticks) {
+			break;
+		}
+	}
+
+	const Tetris* boards[2] = { versus_boards(peers[0]), versus_boards(peers[1]) };
+	versus_matches = stats[0].confirmed_tick == num_ticks && stats[1].confirmed_tick == num_ticks &&
+		stats[0].desyncs == 0 && stats[1].desyncs == 0 &&
+		SDL_memcmp(&boards[0][0], &boards[1][1], TETRIS_STATE_BYTES) == 0 &&
+		SDL_memcmp(&boards[0][1], &boards[1][0], TETRIS_STATE_BYTES) == 0;
+	versus_status = "ok";
+	versus_rollbacks = stats[0].rollbacks;
+
+	double tick_ns = stats[0].resim_ticks ? (double)stats[0].resim_ns / (double)stats[0].resim_ticks : 0.0;
+	versus_resim_8_ns = tick_ns * 8.0;
+	record_result("versus.resim_tick", tick_ns, 0.0);
+	SDL_Log("versus       %u ticks, %" SDL_PRIu64 " rollbacks of %.1f ticks avg, %.2f us per 8 ticks re-simulated, %.2f us at most",
+		num_ticks, stats[0].rollbacks, stats[0].rollbacks ? (double)stats[0].resim_ticks / (double)stats[0].rollbacks : 0.0,
+		versus_resim_8_ns / 1e3, (double)stats[0].max_resim_ns / 1e3);
+	SDL_Log("versus       peers %s, %" SDL_PRIu64 " stalls", versus_matches ? "match" : "DO NOT MATCH", stats[0].stalls + stats[1].stalls);
+
+	versus_destroy(peers[0]);
+	versus_destroy(peers[1]);
+	net_close(sockets[0]);
+	net_close(sockets[1]);
+}
+
+/*
+ * What the frame timers add to every frame: a row and a lap per stage,
+ * the same calls SDL_AppIterate and renderer_draw make. Kept below the
+ * ring size so no frame is dropped.
+ */
+static void
+bench_frametimes(void)
+{
+	const int frames = 4000;
+
+	FrameTimes* times = frametimes_create(NULL, false);
+	if (!times) {
+		SDL_Log("frametimes_create failed: %s", SDL_GetError());
+		return;
+	}
+
+	BenchTimer start = timer_start();
+	for (int i = 0; i < frames; ++i) {
+		Uint64 lap = frametimes_begin_frame(times);
+		for (int stage = 0; stage < FRAME_STAGE_COUNT; ++stage) {
+			lap = frametimes_lap(times, (FrameStage)stage, lap);
+		}
+		frametimes_end_frame(times);
+	}
+	double frame_ns = timer_stop(start, "frametimes.frame", frames);
+	frametimes_destroy(times);
+
+	SDL_Log("frametimes   %5.1f ns/frame", frame_ns);
+}
+
+#define BENCH_WALL_WINDOWS 4
+#define BENCH_SPECTATORS 256
+
+/* Hashes every downloaded headless frame, as a golden-image check would */
+static void
+crc_frame(void* userdata, int window_index, Uint64 frame, const Uint8* pixels, Uint32 width, Uint32 height)
+{
+	Uint32 crc = SDL_crc32(0, pixels, (size_t)width * height * 4);
+	if (frame == 0) {
+		*(Uint32*)userdata = crc;
+	}
+}
+
+/* Mode 0 submits each window on its own, the others go through renderer_draw_all */
+static void
+draw_wall(Renderer* renderer, int mode, int num_windows, const Tetris* tetris)
+{
+	renderer_begin_frame(renderer);
+	if (mode == 0) {
+		for (int i = 0; i < num_windows; ++i) {
+			renderer_draw(renderer, i, tetris);
+		}
+	}
+	else {
+		renderer_draw_all(renderer, tetris);
+	}
+}
+
+/*
+ * CPU time of renderer_draw, acquire to submit, for a board in mid game.
+ * Defaults to the offscreen video driver; SDL_VIDEO_DRIVER overrides it,
+ * and a software Vulkan driver such as lavapipe makes it run anywhere.
+ */
+static void
+bench_render(int frames)
+{
+	static const char* names[2] = { "render.frame", "render.frame_msaa" };
+	static const char* startup_names[2] = { "render.startup", "render.startup_msaa" };
+	static const Uint32 keys[8] = {
+		TETRIS_INPUT_LEFT, TETRIS_INPUT_RIGHT, TETRIS_INPUT_ROTATE, TETRIS_INPUT_DOWN,
+		TETRIS_INPUT_DROP, 0, 0, 0
+	};
+
+	SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+	if (!SDL_Init(SDL_INIT_VIDEO)) {
+		SDL_Log("render       skipped, no video: %s", SDL_GetError());
+		render_status = "no video";
+		return;
+	}
+
+	SDL_Window* window = SDL_CreateWindow("sdlgputest_bench", 200 + 20, 440 + 20, 0);
+	if (!window) {
+		SDL_Log("render       skipped, no window: %s", SDL_GetError());
+		render_status = "no window";
+		SDL_Quit();
+		return;
+	}
+
+	Tetris tetris;
+	Uint32 seed = 1;
+	SDL_zero(tetris);
+	for (int i = 0; i < 3000; ++i) {
+		seed = seed * 1664525u + 1013904223u;
+		tetris_tick(&tetris, keys[seed >> 29], 16666667);
+	}
+
+	render_status = "ok";
+	for (int msaa = 0; msaa < 2; ++msaa) {
+		/* Device and targets, then the pipeline from the loader thread */
+		BenchTimer start = timer_start();
+		Renderer* renderer = renderer_create(NULL, &window, 1, msaa ? 4 : 0, NULL, 0);
+		if (!renderer) {
+			SDL_Log("render       skipped, no GPU device: %s", SDL_GetError());
+			render_status = "no gpu";
+			break;
+		}
+		if (!renderer_wait_ready(renderer)) {
+			render_status = "no pipeline";
+			renderer_destroy(renderer);
+			break;
+		}
+		double startup_ns = timer_stop(start, startup_names[msaa], 1);
+		SDL_Log("render       %7.3f ms to the first frame%s", startup_ns / 1e6, msaa ? " msaa" : "");
+
+		for (int i = 0; i < 3; ++i) {
+			renderer_begin_frame(renderer);
+			renderer_draw(renderer, 0, &tetris);
+		}
+
+		start = timer_start();
+		for (int i = 0; i < frames; ++i) {
+			renderer_begin_frame(renderer);
+			renderer_draw(renderer, 0, &tetris);
+		}
+		double frame_ns = timer_stop(start, names[msaa], frames);
+		SDL_Log("render       %7.0f ns/frame%s  (%d frames, %s)", frame_ns, msaa ? " msaa" : "",
+			frames, SDL_GetCurrentVideoDriver());
+
+		renderer_destroy(renderer);
+	}
+
+	/* 4x MSAA resolved into the swapchain, then into a texture of its own that is blitted over */
+	double resolve_ns[2] = { 0.0, 0.0 };
+	Uint64 resolve_bytes[2] = { 0, 0 };
+	for (int blit = 0; blit < 2 && SDL_strcmp(render_status, "ok") == 0; ++blit) {
+		static const char* resolve_names[2] = { "render.msaa_resolve_direct", "render.msaa_resolve_blit" };
+		Renderer* renderer = renderer_create(NULL, &window, 1, 4, NULL, 0);
+		if (renderer && renderer_wait_ready(renderer)) {
+			renderer_set_msaa_blit(renderer, blit != 0);
+			for (int i = 0; i < 3; ++i) {
+				renderer_begin_frame(renderer);
+				renderer_draw(renderer, 0, &tetris);
+			}
+			BenchTimer start = timer_start();
+			for (int i = 0; i < frames; ++i) {
+				renderer_begin_frame(renderer);
+				renderer_draw(renderer, 0, &tetris);
+			}
+			resolve_ns[blit] = timer_stop(start, resolve_names[blit], frames);
+
+			TargetPoolStats stats;
+			renderer_get_target_stats(renderer, &stats);
+			resolve_bytes[blit] = stats.bytes_in_use;
+			msaa_samples = renderer_get_msaa(renderer);
+			SDL_Log("render       %7.0f ns/frame  (%dx MSAA %s, %" SDL_PRIu64 " KiB of targets)", resolve_ns[blit], msaa_samples,
+				blit ? "resolved and blitted" : "resolved into the swapchain", resolve_bytes[blit] / 1024);
+		}
+		renderer_destroy(renderer);
+	}
+	if (resolve_bytes[0] > 0 && resolve_bytes[1] > 0) {
+		msaa_bytes_saved = resolve_bytes[1] > resolve_bytes[0] ? resolve_bytes[1] - resolve_bytes[0] : 0;
+		msaa_ns_saved = resolve_ns[1] - resolve_ns[0];
+		SDL_Log("render       %7.0f ns/frame and %" SDL_PRIu64 " KiB saved resolving into the swapchain", msaa_ns_saved,
+			msaa_bytes_saved / 1024);
+	}
+
+	/* Each level of detail of the built-in mesh */
+	for (int lod = 0; lod < 2 && SDL_strcmp(render_status, "ok") == 0; ++lod) {
+		static const char* lod_names[2] = { "render.mesh_lod0", "render.mesh_lod1" };
+		Renderer* renderer = renderer_create(NULL, &window, 1, 0, NULL, lod);
+		if (renderer && renderer_wait_ready(renderer)) {
+			for (int i = 0; i < 3; ++i) {
+				renderer_begin_frame(renderer);
+				renderer_draw(renderer, 0, &tetris);
+			}
+			BenchTimer start = timer_start();
+			for (int i = 0; i < frames; ++i) {
+				renderer_begin_frame(renderer);
+				renderer_draw(renderer, 0, &tetris);
+			}
+			double frame_ns = timer_stop(start, lod_names[lod], frames);
+			SDL_Log("render       %7.0f ns/frame  (mesh LOD %d)", frame_ns, lod);
+		}
+		renderer_destroy(renderer);
+	}
+
+	/*
+	 * The locked cells as one draw over every slot, empty ones included, against one indirect draw per run.
+	 * The plain cube LOD keeps the index counts comparable.
+	 */
+	Renderer* renderer = SDL_strcmp(render_status, "ok") == 0 ? renderer_create(NULL, &window, 1, 0, NULL, 1) : NULL;
+	if (renderer && renderer_wait_ready(renderer)) {
+		static const char* stack_names[2] = { "render.stack_indirect", "render.stack_direct" };
+		int rows = 0, occupied = 0;
+		for (int i = 0; i < 220; ++i) {
+			occupied += tetris.board[i] != 0;
+			rows = tetris.board[i] ? i / 10 + 1 : rows;
+		}
+		for (int direct = 0; direct < 2; ++direct) {
+			renderer_set_direct_stack(renderer, direct != 0);
+			for (int i = 0; i < 3; ++i) {
+				renderer_begin_frame(renderer);
+				renderer_draw(renderer, 0, &tetris);
+			}
+			BenchTimer start = timer_start();
+			for (int i = 0; i < frames; ++i) {
+				renderer_begin_frame(renderer);
+				renderer_draw(renderer, 0, &tetris);
+			}
+			double frame_ns = timer_stop(start, stack_names[direct], frames);
+			SDL_Log("render       %7.0f ns/frame  (stack %s, %d indices)", frame_ns, direct ? "direct" : "indirect",
+				(direct ? rows * 10 : occupied) * 36);
+		}
+	}
+	renderer_destroy(renderer);
+
+	/* A drag resize, the window growing and shrinking a few pixels every frame */
+	renderer = SDL_strcmp(render_status, "ok") == 0 ? renderer_create(NULL, &window, 1, 4, NULL, 0) : NULL;
+	if (renderer && renderer_wait_ready(renderer)) {
+		BenchTimer start = timer_start();
+		for (int i = 0; i < frames; ++i) {
+			int step = i % 64 < 32 ? i % 32 : 32 - i % 32;
+			SDL_SetWindowSize(window, 200 + 20 + step * 4, 440 + 20 + step * 6);
+			renderer_begin_frame(renderer);
+			renderer_draw(renderer, 0, &tetris);
+		}
+		double frame_ns = timer_stop(start, "render.resize_msaa", frames);
+		renderer_get_target_stats(renderer, &resize_targets);
+		SDL_Log("render       %7.0f ns/frame resizing  (%u targets created, %u allocations avoided)", frame_ns,
+			resize_targets.created, resize_targets.kept + resize_targets.reused);
+
+		SDL_SetWindowSize(window, 200 + 20, 440 + 20);
+	}
+	renderer_destroy(renderer);
+
+	/* Headless, with no swapchain to wait for: drawing only, then with every frame downloaded and hashed */
+	for (int readback = 0; readback < 2 && SDL_strcmp(render_status, "ok") == 0; ++readback) {
+		static const char* headless_names[2] = { "render.headless", "render.headless_readback" };
+		renderer = renderer_create_headless(NULL, &window, 1, 0, NULL, 0);
+		if (renderer && renderer_wait_ready(renderer)) {
+			if (readback) {
+				renderer_set_frame_callback(renderer, crc_frame, &headless_crc);
+			}
+			for (int i = 0; i < 3; ++i) {
+				renderer_begin_frame(renderer);
+				renderer_draw(renderer, 0, &tetris);
+			}
+			BenchTimer start = timer_start();
+			for (int i = 0; i < frames; ++i) {
+				renderer_begin_frame(renderer);
+				renderer_draw(renderer, 0, &tetris);
+			}
+			renderer_finish_frames(renderer);
+			double frame_ns = timer_stop(start, headless_names[readback], frames);
+			SDL_Log("render       %7.0f ns/frame  (headless%s, %.0f frames/s)", frame_ns,
+				readback ? " with readback" : "", 1e9 / frame_ns);
+		}
+		renderer_destroy(renderer);
+	}
+
+	/* A spectator wall of BENCH_SPECTATORS bot games in one window, each frame stepping them once too */
+	TetrisBatch* batch = SDL_strcmp(render_status, "ok") == 0 ? tetris_batch_create(BENCH_SPECTATORS, 1) : NULL;
+	Tetris* boards = batch ? SDL_calloc(BENCH_SPECTATORS, sizeof(Tetris)) : NULL;
+	renderer = boards ? renderer_create(NULL, &window, 1, 0, NULL, 1) : NULL;
+	if (renderer && renderer_wait_ready(renderer)) {
+		SDL_SetWindowSize(window, 1280, 720);
+		BenchTimer start = timer_start();
+		for (int i = -3; i < frames; ++i) {
+			if (i == 0) {
+				start = timer_start();
+			}
+			tetris_batch_run(batch, 1, 16666667, batch_input, NULL, NULL);
+			for (Uint32 game = 0; game < BENCH_SPECTATORS; ++game) {
+				tetris_batch_get(batch, game, &boards[game]);
+			}
+			renderer_begin_frame(renderer);
+			renderer_draw_wall(renderer, 0, boards, BENCH_SPECTATORS);
+		}
+		double frame_ns = timer_stop(start, "render.spectator_wall", frames);
+		SDL_Log("render       %7.0f ns/frame  (spectator wall of %d games)", frame_ns, BENCH_SPECTATORS);
+		SDL_SetWindowSize(window, 200 + 20, 440 + 20);
+	}
+	renderer_destroy(renderer);
+	SDL_free(boards);
+	tetris_batch_destroy(batch);
+
+	/* A wall of windows: one submit per window, one for all, and all mirroring the first */
+	SDL_Window* wall[BENCH_WALL_WINDOWS] = { window };
+	int num_wall = 1;
+	while (SDL_strcmp(render_status, "ok") == 0 && num_wall < BENCH_WALL_WINDOWS) {
+		wall[num_wall] = SDL_CreateWindow("sdlgputest_bench", 200 + 20, 440 + 20, 0);
+		if (!wall[num_wall]) {
+			break;
+		}
+		++num_wall;
+	}
+	if (num_wall == BENCH_WALL_WINDOWS) {
+		static const char* wall_names[3] = { "render.wall.per_window", "render.wall.one_submit", "render.wall.mirrored" };
+		for (int mode = 0; mode < 3; ++mode) {
+			Renderer* renderer = renderer_create(NULL, wall, num_wall, 0, NULL, 0);
+			if (!renderer || !renderer_wait_ready(renderer)) {
+				renderer_destroy(renderer);
+				break;
+			}
+			renderer_set_mirrored(renderer, mode == 2);
+			for (int i = 0; i < 3; ++i) {
+				draw_wall(renderer, mode, num_wall, &tetris);
+			}
+
+			BenchTimer start = timer_start();
+			for (int i = 0; i < frames; ++i) {
+				draw_wall(renderer, mode, num_wall, &tetris);
+			}
+			double frame_ns = timer_stop(start, wall_names[mode], frames);
+			SDL_Log("render       %7.0f ns/frame  (%d windows, %s)", frame_ns, num_wall, wall_names[mode] + 12);
+
+			renderer_destroy(renderer);
+		}
+	}
+	for (int i = 1; i < num_wall; ++i) {
+		SDL_DestroyWindow(wall[i]);
+	}
+
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+}
+
+static void
+write_json(const char* vecmath, int iterations)
+{
+	printf("{\n");
+	printf("  \"vecmath\": \"%s\",\n", vecmath);
+	printf("  \"iterations\": %d,\n", iterations);
+	printf("  \"results\": [\n");
+	for (int i = 0; i < num_results; ++i) {
+		printf("    { \"name\": \"%s\", \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f }%s\n",
+			results[i].name, results[i].ns_per_op, results[i].allocs_per_op, i + 1 < num_results ? "," : "");
+	}
+	printf("  ],\n");
+	printf("  \"checks\": {\n");
+	printf("    \"matrix_max_difference\": %g,\n", matrix_max_difference);
+	printf("    \"piece_coords_match\": %s,\n", piece_coords_match ? "true" : "false");
+	printf("    \"batch_matches_single_game\": %s,\n", batch_matches ? "true" : "false");
+	printf("    \"rewind_matches_full_copies\": %s,\n", rewind_matches ? "true" : "false");
+	printf("    \"rewind_bytes_per_tick\": %.1f,\n", rewind_bytes_per_tick);
+	printf("    \"rewind_slowest_restore_ns\": %.0f,\n", rewind_slowest_restore_ns);
+	printf("    \"versus\": \"%s\",\n", versus_status);
+	printf("    \"versus_peers_match\": %s,\n", versus_matches ? "true" : "false");
+	printf("    \"versus_rollbacks\": %" SDL_PRIu64 ",\n", versus_rollbacks);
+	printf("    \"versus_resim_8_ticks_ns\": %.0f,\n", versus_resim_8_ns);
+	printf("    \"render\": \"%s\",\n", render_status);
+	printf("    \"resize_targets_created\": %u,\n", resize_targets.created);
+	printf("    \"resize_allocations_avoided\": %u,\n", resize_targets.kept + resize_targets.reused);
+	printf("    \"headless_crc32\": \"%08x\",\n", headless_crc);
+	printf("    \"msaa_samples\": %d,\n", msaa_samples);
+	printf("    \"msaa_direct_resolve_bytes_saved\": %" SDL_PRIu64 ",\n", msaa_bytes_saved);
+	printf("    \"msaa_direct_resolve_ns_saved\": %.0f\n", msaa_ns_saved);
+	printf("  }\n");
+	printf("}\n");
+}
+
+int main(int argc, char* argv[])
+{
+	/* Before SDL allocates anything, so every allocation goes through the counter */
+	SDL_GetOriginalMemoryFunctions(&real_malloc, &real_calloc, &real_realloc, &real_free);
+	SDL_SetMemoryFunctions(counting_malloc, counting_calloc, counting_realloc, real_free);
+
+	int iterations = 1000000;
+	bool json = false;
+	bool render = true;
+	for (int i = 1; i < argc; ++i) {
+		if (SDL_strcmp(argv[i], "--json") == 0) {
+			json = true;
+		}
+		else if (SDL_strcmp(argv[i], "--no-render") == 0) {
+			render = false;
+		}
+		else {
+			iterations = SDL_max(SDL_atoi(argv[i]), 1);
+		}
+	}
+
+#if defined(VECMATH_SSE2)
+	const char* vecmath = "SSE2";
+#elif defined(VECMATH_NEON)
+	const char* vecmath = "NEON";
+#else
+	const char* vecmath = "scalar";
+#endif
+	SDL_Log("vecmath: %s, %d iterations", vecmath, iterations);
+
+	bench_matrix(iterations);
+	bench_frame(SDL_max(iterations / 220, 1));
+	bench_piece_coords(iterations);
+	bench_try_move(iterations);
+	bench_hard_drop(iterations);
+	bench_glue(SDL_max(iterations / 10, 1));
+	bench_tick(iterations);
+	bench_movegen(SDL_max(iterations / 1000, 1));
+	bench_batch(16384, SDL_max(iterations / 1000, 1));
+	bench_rewind(SDL_max(iterations / 10, 20000));
+	bench_versus(SDL_max(iterations / 100, 600));
+	bench_frametimes();
+	if (render) {
+		bench_render(SDL_max(iterations / 1000, 10));
+	}
+
+	if (json) {
+		write_json(vecmath, iterations);
+	}
+	return piece_coords_match && batch_matches && rewind_matches && versus_matches ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+#include "framedump.h"
+
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+
+struct FrameDump
+{
+	char* path_pattern;
+	bool log_crcs;
+	bool failed; /* stop trying to write files after the first failure */
+	Uint64 frames;
+	Uint32 crc;
+};
+
+/*
+ * Finds the pattern's first %d, with any zero padding and width, so
+ * percent points at it and rest just past it. The pattern comes from the
+ * command line, so it is never handed to printf as a format. Returns
+ * false if it has no %d.
+ */
+static bool
+find_number(const char* pattern, const char** percent, const char** rest, bool* zeros, int* width)
+{
+	*percent = SDL_strchr(pattern, '%');
+	if (!*percent)
+	{
+		return false;
+	}
+	const char* spec = *percent + 1;
+	*zeros = *spec == '0';
+	*width = SDL_clamp(SDL_atoi(spec), 0, 20);
+	while (*spec >= '0' && *spec <= '9')
+	{
+		++spec;
+	}
+	*rest = spec + 1;
+	return *spec == 'd';
+}
+
+FrameDump*
+framedump_create(const char* path_pattern, bool log_crcs)
+{
+	const char* percent;
+	const char* rest;
+	bool zeros;
+	int width;
+	if (path_pattern && !find_number(path_pattern, &percent, &rest, &zeros, &width))
+	{
+		/* Every frame would overwrite the same file */
+		SDL_SetError("Frame dump pattern %s has no %%d for the frame number", path_pattern);
+		return NULL;
+	}
+
+	FrameDump* dump = SDL_calloc(1, sizeof(FrameDump));
+	if (!dump)
+	{
+		return NULL;
+	}
+	dump->log_crcs = log_crcs;
+	if (path_pattern)
+	{
+		dump->path_pattern = SDL_strdup(path_pattern);
+		if (!dump->path_pattern)
+		{
+			SDL_free(dump);
+			return NULL;
+		}
+	}
+	return dump;
+}
+
+void
+framedump_destroy(FrameDump* dump)
+{
+	if (!dump)
+	{
+		return;
+	}
+	SDL_Log("Frames: %" SDL_PRIu64 " downloaded, CRC-32 of all %08x", dump->frames, dump->crc);
+	SDL_free(dump->path_pattern);
+	SDL_free(dump);
+}
+
+Uint32
+framedump_crc(const FrameDump* dump)
+{
+	return dump->crc;
+}
+
+/* Fills in the pattern's %d, which framedump_create checked it has */
+static void
+frame_path(const char* pattern, int window_index, Uint64 frame, char* out, size_t size)
+{
+	/* The pattern up to its %d, the frame number, then the rest */
+	const char* percent;
+	const char* rest;
+	bool zeros;
+	int width;
+	find_number(pattern, &percent, &rest, &zeros, &width);
+	size_t prefix = percent - pattern;
+	char number[32];
+	SDL_snprintf(number, sizeof(number), zeros ? "%0*" SDL_PRIu64 : "%*" SDL_PRIu64, width, frame);
+
+	char window[16] = "";
+	if (window_index > 0)
+	{
+		SDL_snprintf(window, sizeof(window), "_w%d", window_index);
+	}
+	/* The extension is in the file name, not in a directory name before it */
+	const char* name = rest;
+	for (const char* c = rest; *c; ++c)
+	{
+		if (*c == '/' || *c == '\\')
+		{
+			name = c + 1;
+		}
+	}
+	const char* extension = SDL_strrchr(name, '.');
+	size_t before = extension ? (size_t)(extension - rest) : SDL_strlen(rest);
+	SDL_snprintf(out, size, "%.*s%s%.*s%s%s", (int)prefix, pattern, number, (int)before, rest, window, rest + before);
+}
+
+static bool
+write_frame(const char* path, const Uint8* pixels, Uint32 width, Uint32 height)
+{
+	SDL_IOStream* io = SDL_IOFromFile(path, "wb");
+	if (!io)
+	{
+		return false;
+	}
+
+	bool written = true;
+	size_t length = SDL_strlen(path);
+	if (length >= 4 && SDL_strcasecmp(path + length - 4, ".ppm") == 0)
+	{
+		/* PPM has no alpha; drop it a row at a time */
+		Uint8* row = SDL_malloc(width * 3);
+		written = row && SDL_IOprintf(io, "P6\n%u %u\n255\n", width, height) > 0;
+		for (Uint32 y = 0; written && y < height; ++y)
+		{
+			const Uint8* in = pixels + (size_t)y * width * 4;
+			for (Uint32 x = 0; x < width; ++x)
+			{
+				row[x * 3 + 0] = in[x * 4 + 0];
+				row[x * 3 + 1] = in[x * 4 + 1];
+				row[x * 3 + 2] = in[x * 4 + 2];
+			}
+			written = SDL_WriteIO(io, row, width * 3) == width * 3;
+		}
+		SDL_free(row);
+	}
+	else
+	{
+		size_t size = (size_t)width * height * 4;
+		written = SDL_WriteIO(io, pixels, size) == size;
+	}
+	return SDL_CloseIO(io) && written;
+}
+
+void
+framedump_frame(void* userdata, int window_index, Uint64 frame, const Uint8* pixels, Uint32 width, Uint32 height)
+{
+	FrameDump* dump = userdata;
+	Uint32 crc = SDL_crc32(0, pixels, (size_t)width * height * 4);
+
+	dump->crc = SDL_crc32(dump->crc, &crc, sizeof(crc));
+	dump->frames += 1;
+	if (dump->log_crcs)
+	{
+		SDL_Log("frame %" SDL_PRIu64 " window %d: %ux%u CRC-32 %08x", frame, window_index, width, height, crc);
+	}
+
+	if (dump->path_pattern && !dump->failed)
+	{
+		char path[1024];
+		frame_path(dump->path_pattern, window_index, frame, path, sizeof(path));
+		if (!write_frame(path, pixels, width, height))
+		{
+			SDL_Log("Failed to write frame %s: %s", path, SDL_GetError());
+			dump->failed = true;
+		}
+	}
+}
@@ -0,0 +1,32 @@
+/*
+ * Where headless frames go: image files for looking at, and a CRC-32 of
+ * every frame for comparing runs pixel for pixel without keeping images
+ * around, e.g. on CI machines against a known good value.
+ */
+#ifndef FRAMEDUMP_H
+#define FRAMEDUMP_H
+
+#include <SDL3/SDL_stdinc.h>
+
+typedef struct FrameDump FrameDump;
+
+/*
+ * path_pattern names the file of each frame, NULL for none: its %d (or
+ * %05d and so on) becomes the frame number, and windows after the first
+ * add _w<index> before the extension of the file name. Names ending in
+ * .ppm get binary PPM, anything else raw RGBA8. log_crcs logs the CRC of
+ * every frame. Returns NULL on failure, such as a pattern without %d, see
+ * SDL_GetError.
+ */
+FrameDump* framedump_create(const char* path_pattern, bool log_crcs);
+
+/* Logs how many frames there were and the CRC of all of them together */
+void framedump_destroy(FrameDump* dump);
+
+/* A RendererFrameFunc, with the FrameDump as userdata */
+void framedump_frame(void* userdata, int window_index, Uint64 frame, const Uint8* pixels, Uint32 width, Uint32 height);
+
+/* CRC-32 of every frame so far, in the order they came */
+Uint32 framedump_crc(const FrameDump* dump);
+
+#endif /* FRAMEDUMP_H */
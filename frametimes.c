@@ -0,0 +1,287 @@
+#include "frametimes.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_timer.h>
+
+/* Rows the frame loop can run ahead of the reporter, about a minute at 60 fps */
+#define FRAMETIMES_CAPACITY 4096
+
+/* Frames the percentiles are taken over */
+#define FRAMETIMES_WINDOW 512
+
+#define FRAMETIMES_REPORT_NS 1000000000
+#define FRAMETIMES_DRAIN_MS 250
+
+/* Counter ticks per stage; the frame total last */
+typedef struct FrameRow
+{
+	Uint64 ticks[FRAME_STAGE_COUNT + 1];
+	Uint64 input_latency_ns; /* 0 if the frame shows no new key press */
+} FrameRow;
+
+struct FrameTimes
+{
+	/* Frame loop only */
+	FrameRow current;
+	Uint64 frame_start;
+	Uint64 dropped;
+
+	/*
+	 * Single producer, single consumer: the frame loop fills rows[head] and
+	 * then moves head, the reporter reads up to head and then moves tail.
+	 */
+	FrameRow rows[FRAMETIMES_CAPACITY];
+	SDL_AtomicU32 head;
+	SDL_AtomicU32 tail;
+
+	/* Reporter thread only */
+	SDL_Thread* thread;
+	SDL_Semaphore* wake;
+	SDL_AtomicInt quit;
+	SDL_IOStream* csv;
+	bool show_percentiles;
+	double ns_per_tick;
+	Uint64 frames;
+	Uint64 next_report_ns;
+	Uint32 window[FRAMETIMES_WINDOW][FRAME_STAGE_COUNT + 1]; /* ns */
+	Uint32 window_count;
+	Uint32 latencies[FRAMETIMES_WINDOW]; /* ns, of the last frames showing a key press */
+	Uint32 latency_count;
+};
+
+static const char* stage_names[FRAME_STAGE_COUNT + 1] = {
+	"sim", "acquire", "textures", "record", "blit", "submit", "frame"
+};
+
+static int SDLCALL
+compare_u32(const void* a, const void* b)
+{
+	Uint32 x = *(const Uint32*)a;
+	Uint32 y = *(const Uint32*)b;
+	return (x > y) - (x < y);
+}
+
+static void
+log_percentiles(FrameTimes* times)
+{
+	Uint32 count = SDL_min(times->window_count, FRAMETIMES_WINDOW);
+	Uint32 values[FRAMETIMES_WINDOW];
+	char line[512];
+	int length = 0;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	length += SDL_snprintf(line + length, sizeof(line) - length, "frame times (us, p50/p95/p99 of %u):", count);
+	for (int stage = 0; stage <= FRAME_STAGE_COUNT; ++stage)
+	{
+		for (Uint32 i = 0; i < count; ++i)
+		{
+			values[i] = times->window[i][stage];
+		}
+		SDL_qsort(values, count, sizeof(Uint32), compare_u32);
+		length += SDL_snprintf(line + length, sizeof(line) - length, " %s %.0f/%.0f/%.0f", stage_names[stage],
+			values[count * 50 / 100] / 1e3, values[count * 95 / 100] / 1e3, values[count * 99 / 100] / 1e3);
+		length = SDL_min(length, (int)sizeof(line) - 1);
+	}
+	SDL_Log("%s", line);
+
+	count = SDL_min(times->latency_count, FRAMETIMES_WINDOW);
+	if (count > 0)
+	{
+		SDL_memcpy(values, times->latencies, count * sizeof(Uint32));
+		SDL_qsort(values, count, sizeof(Uint32), compare_u32);
+		SDL_Log("input latency (ms, key down to submit, p50/p95/p99 of %u): %.2f/%.2f/%.2f", count,
+			values[count * 50 / 100] / 1e6, values[count * 95 / 100] / 1e6, values[count * 99 / 100] / 1e6);
+	}
+}
+
+/* Takes everything the frame loop has pushed so far */
+static void
+drain(FrameTimes* times)
+{
+	Uint32 head = SDL_GetAtomicU32(&times->head);
+	Uint32 tail = SDL_GetAtomicU32(&times->tail);
+
+	for (; tail != head; ++tail)
+	{
+		const FrameRow* row = &times->rows[tail % FRAMETIMES_CAPACITY];
+		Uint32* ns = times->window[times->window_count % FRAMETIMES_WINDOW];
+		for (int stage = 0; stage <= FRAME_STAGE_COUNT; ++stage)
+		{
+			ns[stage] = (Uint32)SDL_min((double)row->ticks[stage] * times->ns_per_tick, (double)SDL_MAX_UINT32);
+		}
+		times->window_count += 1;
+
+		Uint32 latency = (Uint32)SDL_min(row->input_latency_ns, SDL_MAX_UINT32);
+		if (latency > 0)
+		{
+			times->latencies[times->latency_count % FRAMETIMES_WINDOW] = latency;
+			times->latency_count += 1;
+		}
+
+		if (times->csv)
+		{
+			SDL_IOprintf(times->csv, "%" SDL_PRIu64 ",%u,%u,%u,%u,%u,%u,%u,%u\n", times->frames,
+				ns[0], ns[1], ns[2], ns[3], ns[4], ns[5], ns[6], latency);
+		}
+		times->frames += 1;
+	}
+
+	SDL_SetAtomicU32(&times->tail, tail);
+}
+
+static int SDLCALL
+reporter_thread(void* data)
+{
+	FrameTimes* times = data;
+	bool quit = false;
+	while (!quit)
+	{
+		SDL_WaitSemaphoreTimeout(times->wake, FRAMETIMES_DRAIN_MS);
+		quit = SDL_GetAtomicInt(&times->quit) != 0;
+		drain(times);
+
+		Uint64 now = SDL_GetTicksNS();
+		if (times->show_percentiles && now >= times->next_report_ns)
+		{
+			log_percentiles(times);
+			times->next_report_ns = now + FRAMETIMES_REPORT_NS;
+		}
+	}
+	return 0;
+}
+
+FrameTimes*
+frametimes_create(const char* csv_path, bool show_percentiles)
+{
+	FrameTimes* times = SDL_calloc(1, sizeof(FrameTimes));
+	if (!times)
+	{
+		return NULL;
+	}
+
+	times->show_percentiles = show_percentiles;
+	times->ns_per_tick = 1e9 / (double)SDL_GetPerformanceFrequency();
+	times->next_report_ns = SDL_GetTicksNS() + FRAMETIMES_REPORT_NS;
+
+	if (csv_path)
+	{
+		times->csv = SDL_IOFromFile(csv_path, "w");
+		if (!times->csv)
+		{
+			SDL_free(times);
+			return NULL;
+		}
+		SDL_IOprintf(times->csv, "frame");
+		for (int stage = 0; stage <= FRAME_STAGE_COUNT; ++stage)
+		{
+			SDL_IOprintf(times->csv, ",%s_ns", stage_names[stage]);
+		}
+		SDL_IOprintf(times->csv, ",input_latency_ns\n");
+	}
+
+	times->wake = SDL_CreateSemaphore(0);
+	times->thread = times->wake ? SDL_CreateThread(reporter_thread, "frametimes", times) : NULL;
+	if (!times->thread)
+	{
+		SDL_DestroySemaphore(times->wake);
+		if (times->csv)
+		{
+			SDL_CloseIO(times->csv);
+		}
+		SDL_free(times);
+		return NULL;
+	}
+	return times;
+}
+
+void
+frametimes_destroy(FrameTimes* times)
+{
+	if (!times)
+	{
+		return;
+	}
+
+	SDL_SetAtomicInt(&times->quit, 1);
+	SDL_SignalSemaphore(times->wake);
+	SDL_WaitThread(times->thread, NULL);
+	SDL_DestroySemaphore(times->wake);
+
+	if (times->dropped > 0)
+	{
+		SDL_Log("frame times: %" SDL_PRIu64 " frames dropped, the reporter fell behind", times->dropped);
+	}
+	if (times->csv)
+	{
+		SDL_CloseIO(times->csv);
+	}
+	SDL_free(times);
+}
+
+Uint64
+frametimes_begin_frame(FrameTimes* times)
+{
+	if (!times)
+	{
+		return 0;
+	}
+	SDL_zero(times->current);
+	times->frame_start = SDL_GetPerformanceCounter();
+	return times->frame_start;
+}
+
+Uint64
+frametimes_now(FrameTimes* times)
+{
+	return times ? SDL_GetPerformanceCounter() : 0;
+}
+
+Uint64
+frametimes_lap(FrameTimes* times, FrameStage stage, Uint64 start)
+{
+	if (!times)
+	{
+		return 0;
+	}
+	Uint64 now = SDL_GetPerformanceCounter();
+	times->current.ticks[stage] += now - start;
+	return now;
+}
+
+void
+frametimes_end_frame(FrameTimes* times)
+{
+	if (!times)
+	{
+		return;
+	}
+	times->current.ticks[FRAME_STAGE_COUNT] = SDL_GetPerformanceCounter() - times->frame_start;
+
+	/* Never waits for the reporter; a full ring drops the frame */
+	Uint32 head = SDL_GetAtomicU32(&times->head);
+	if (head - SDL_GetAtomicU32(&times->tail) == FRAMETIMES_CAPACITY)
+	{
+		times->dropped += 1;
+		return;
+	}
+	times->rows[head % FRAMETIMES_CAPACITY] = times->current;
+	SDL_SetAtomicU32(&times->head, head + 1);
+}
+
+void
+frametimes_input_latency(FrameTimes* times, Uint64 ns)
+{
+	if (!times)
+	{
+		return;
+	}
+	times->current.input_latency_ns = SDL_max(times->current.input_latency_ns, SDL_max(ns, 1));
+}
@@ -0,0 +1,52 @@
+/*
+ * Per-frame CPU time of each stage of SDL_AppIterate. The frame loop only
+ * reads the performance counter and pushes one row per frame into a
+ * fixed-size lock-free ring; a reporter thread drains it into a CSV file
+ * and/or logs rolling percentiles once a second. Frames that are the first
+ * to show a key press also carry the latency from the key down event.
+ */
+#ifndef FRAMETIMES_H
+#define FRAMETIMES_H
+
+#include <SDL3/SDL_stdinc.h>
+
+typedef enum FrameStage
+{
+	FRAME_STAGE_SIM,      /* picking up the sim thread's latest snapshot */
+	FRAME_STAGE_ACQUIRE,  /* frames-in-flight wait, command buffer and swapchain texture */
+	FRAME_STAGE_TEXTURES, /* depth/MSAA target reallocation after a resize */
+	FRAME_STAGE_RECORD,   /* vertex upload and render pass */
+	FRAME_STAGE_BLIT,     /* MSAA resolve blit to the swapchain */
+	FRAME_STAGE_SUBMIT,
+	FRAME_STAGE_COUNT
+} FrameStage;
+
+typedef struct FrameTimes FrameTimes;
+
+/*
+ * csv_path may be NULL for no CSV. show_percentiles logs p50/p95/p99 of
+ * the last frames once a second. Returns NULL on failure.
+ */
+FrameTimes* frametimes_create(const char* csv_path, bool show_percentiles);
+
+/* Writes out the remaining rows and closes the CSV */
+void frametimes_destroy(FrameTimes* times);
+
+/*
+ * Frame loop side, one thread only. All of these accept NULL and then do
+ * nothing, so call sites need no checks. begin, now and lap return the
+ * counter value the next lap measures from; lap adds the time since start
+ * to the stage.
+ */
+Uint64 frametimes_begin_frame(FrameTimes* times);
+Uint64 frametimes_now(FrameTimes* times);
+Uint64 frametimes_lap(FrameTimes* times, FrameStage stage, Uint64 start);
+void frametimes_end_frame(FrameTimes* times);
+
+/*
+ * Adds a key press first shown by the current frame, ns after its key
+ * down event. A frame showing several keeps the oldest.
+ */
+void frametimes_input_latency(FrameTimes* times, Uint64 ns);
+
+#endif /* FRAMETIMES_H */
@@ -24,828 +24,382 @@
 #define SDL_MAIN_USE_CALLBACKS 1
 #include <SDL3/SDL_main.h>
 
-/* Regenerate the shaders with testgpu/build-shaders.sh */
-#include "testgpu/testgpu_spirv.h"
-#include "testgpu/testgpu_dxbc.h"
-#include "testgpu/testgpu_dxil.h"
-#include "testgpu/testgpu_metallib.h"
+#include "batch.h"
+#include "framedump.h"
+#include "frametimes.h"
+#include "mesh.h"
+#include "render.h"
+#include "replay.h"
+#include "rewind.h"
+#include "sim.h"
+#include "startup.h"
+#include "tetris.h"
+#include "versus.h"
 
-#define TESTGPU_SUPPORTED_FORMATS (SDL_GPU_SHADERFORMAT_SPIRV | SDL_GPU_SHADERFORMAT_DXBC | SDL_GPU_SHADERFORMAT_DXIL | SDL_GPU_SHADERFORMAT_METALLIB)
+/* Game time per --headless frame */
+#define HEADLESS_TICK_NS (SDL_NS_PER_SECOND / 60)
 
-#define CHECK_CREATE(var, thing) do { if (!(var)) { SDL_Log("Failed to create %s: %s\n", thing, SDL_GetError()); SDL_assert_always(0 && "CHECK_CREATE for " thing " var:" #var " failed"); } } while(0)
+/* Key down times kept until a frame shows the press, as many as the sim thread queues */
+#define KEY_TIMES 256
 
-typedef struct RenderState
-{
-	SDL_GPUBuffer* buf_vertex;
-	SDL_GPUGraphicsPipeline* pipeline;
-	SDL_GPUSampleCount sample_count;
-} RenderState;
+/* Versus key presses waiting for a tick; each tick takes one press per key, so a double tap moves twice */
+#define VERSUS_MAX_PRESSES 32
 
-typedef struct WindowState
-{
-	int angle_x, angle_y, angle_z;
-	SDL_GPUTexture* tex_depth, * tex_msaa, * tex_resolve;
-	Uint32 prev_drawablew, prev_drawableh;
-} WindowState;
+/* Arena for rewind history unless --rewind-memory says otherwise, some minutes of play */
+#define REWIND_DEFAULT_MEMORY_MB 8
 
-typedef struct Tetris
-{
-	Uint64 prev_ns;
-	Uint64 drop_timer;
-	Uint32 score;
-	Uint32 lines;
-	Uint8 board[220];
-	Uint8 rot;
-	Uint8 x;
-	Uint8 y;
-	Uint8 piece;
-	Uint8 input_rot;
-	Uint8 input_down;
-	Uint8 input_left;
-	Uint8 input_right;
-	Uint8 input_drop;
-} Tetris;
+/* Recorded ticks stepped back per tick while rewinding, so history plays backwards at this speed */
+#define REWIND_STEPS_PER_TICK 4
 
 typedef struct AppState
 {
-	Uint32 frames;
-	SDL_GPUDevice* gpu_device;
-	RenderState render_state;
+	Renderer* renderer;
+	FrameTimes* frame_times; /* --frame-stats / --frame-csv */
+	bool one_submit;         /* --one-submit, all windows in one command buffer */
 	SDLTest_CommonState* state;
-	WindowState* window_states;
-	Tetris* tetris;
+	Tetris* tetris;       /* starting state; once running, the game lives on the sim thread */
+	SimThread* sim;
+	bool input_overflow;
+	Uint64 key_times[KEY_TIMES]; /* ns, of key press keys_pushed % KEY_TIMES and older */
+	Uint32 keys_pushed;
+	Uint32 keys_shown;           /* by a submitted frame, their latency logged */
+	int startup_stage;    /* 0 until the first frame, 1 while only clearing, 2 once the game shows */
+
+	/* --headless: the game steps on the main thread, once per frame, instead of on the sim thread */
+	Uint64 headless_frames;
+	Uint64 headless_drawn;
+	Uint64 headless_start_ns;
+	FrameDump* frame_dump;  /* --dump-frames / --frame-crc */
+
+	/* --wall: many bot games step on the main thread, once per frame, all of them shown */
+	TetrisBatch* wall;
+	Tetris* wall_boards;
+
+	/* --versus: both games tick on the main thread, on the clock, rolled back as the peer's inputs come in */
+	NetSocket* net;
+	Versus* versus;
+	Uint32 versus_presses[VERSUS_MAX_PRESSES]; /* oldest first, one TETRIS_INPUT_* each */
+	Uint32 num_versus_presses;
+	Uint64 versus_clock_ns;
+	Uint64 versus_due_ns;   /* game time the ticks are behind */
+	Uint64 versus_log_ns;
+
+	/* Touched only by the sim thread once it runs */
+	ReplayWriter* recorder; /* --record, every tick goes in here */
+	Replay* replay;         /* --replay, ticks come from here instead of the keyboard */
+	ReplayCursor replay_cursor;
+	Uint64 replay_lag_ns;   /* real time the playback still has to catch up on */
+	Uint32 replay_inputs;   /* next tick, decoded but not due yet */
+	Uint64 replay_dt_ns;
+	bool replay_pending;
+	RewindBuffer* rewind;   /* every tick goes in here too, unless recording or replaying */
+	SDL_AtomicInt rewinding; /* set by the main thread while the rewind key is held */
+	Uint64 rewind_tick;     /* shown while rewound; the ticks after it go once play goes on */
+	bool rewound;
 } AppState;
 
-/*
- * Simulates desktop's glRotatef. The matrix is returned in column-major
- * order.
- */
-static void
-rotate_matrix(float angle, float x, float y, float z, float* r)
+static void advance(AppState* appstate, Tetris* tetris, Uint32 inputs, Uint64 dt_ns)
 {
-	float radians, c, s, c1, u[3], length;
-	int i, j;
-
-	radians = angle * SDL_PI_F / 180.0f;
-
-	c = SDL_cosf(radians);
-	s = SDL_sinf(radians);
-
-	c1 = 1.0f - SDL_cosf(radians);
-
-	length = (float)SDL_sqrt(x * x + y * y + z * z);
-
-	u[0] = x / length;
-	u[1] = y / length;
-	u[2] = z / length;
-
-	for (i = 0; i < 16; i++) {
-		r[i] = 0.0;
-	}
-
-	r[15] = 1.0;
-
-	for (i = 0; i < 3; i++) {
-		r[i * 4 + (i + 1) % 3] = u[(i + 2) % 3] * s;
-		r[i * 4 + (i + 2) % 3] = -u[(i + 1) % 3] * s;
+	if (appstate->recorder)
+	{
+		replay_record_tick(appstate->recorder, tetris, inputs, dt_ns);
 	}
-
-	for (i = 0; i < 3; i++) {
-		for (j = 0; j < 3; j++) {
-			r[i * 4 + j] += c1 * u[i] * u[j] + (i == j ? c : 0.0f);
-		}
+	tetris_tick(tetris, inputs, dt_ns);
+	if (appstate->rewind)
+	{
+		rewind_push(appstate->rewind, tetris);
 	}
 }
 
 /*
- * Simulates gluPerspectiveMatrix
+ * While the rewind key is held, steps the game back through its history
+ * instead of forward, dropping key presses. Returns false once it is let
+ * go, when play goes on from the state rewound to.
  */
-static void
-perspective_matrix(float fovy, float aspect, float znear, float zfar, float* r)
+static bool step_rewind(AppState* appstate, Tetris* tetris, Uint64 dt_ns)
 {
-	int i;
-	float f;
-
-	f = 1.0f / SDL_tanf(fovy * 0.5f);
-
-	for (i = 0; i < 16; i++) {
-		r[i] = 0.0;
+	Uint64 first, last;
+	if (!SDL_GetAtomicInt(&appstate->rewinding))
+	{
+		if (appstate->rewound)
+		{
+			rewind_truncate(appstate->rewind, appstate->rewind_tick);
+			appstate->rewound = false;
+		}
+		return false;
 	}
-
-	r[0] = f / aspect;
-	r[5] = f;
-	r[10] = (znear + zfar) / (znear - zfar);
-	r[11] = -1.0f;
-	r[14] = (2.0f * znear * zfar) / (znear - zfar);
-	r[15] = 0.0f;
+	if (!rewind_range(appstate->rewind, &first, &last))
+	{
+		return false;
+	}
+	if (!appstate->rewound)
+	{
+		appstate->rewind_tick = last;
+		appstate->rewound = true;
+	}
+	if (dt_ns > 0)
+	{
+		Uint64 back = SDL_min(appstate->rewind_tick - first, REWIND_STEPS_PER_TICK);
+		appstate->rewind_tick -= back;
+		rewind_restore(appstate->rewind, appstate->rewind_tick, tetris);
+	}
+	return true;
 }
 
-/*
- * Multiplies lhs by rhs and writes out to r. All matrices are 4x4 and column
- * major. In-place multiplication is supported.
- */
-static void
-multiply_matrix(float* lhs, float* rhs, float* r)
+/* Plays back the recorded ticks at the speed they were recorded */
+static void play_replay(AppState* appstate, Tetris* tetris, Uint64 dt_ns)
 {
-	int i, j, k;
-	float tmp[16];
-
-	for (i = 0; i < 4; i++) {
-		for (j = 0; j < 4; j++) {
-			tmp[j * 4 + i] = 0.0;
-
-			for (k = 0; k < 4; k++) {
-				tmp[j * 4 + i] += lhs[k * 4 + i] * rhs[j * 4 + k];
+	appstate->replay_lag_ns += dt_ns;
+	for (;;)
+	{
+		if (!appstate->replay_pending)
+		{
+			if (!replay_next(&appstate->replay_cursor, &appstate->replay_inputs, &appstate->replay_dt_ns))
+			{
+				appstate->replay_lag_ns = 0;
+				return;
 			}
+			appstate->replay_pending = true;
 		}
+		if (appstate->replay_dt_ns > appstate->replay_lag_ns)
+		{
+			return;
+		}
+		appstate->replay_lag_ns -= appstate->replay_dt_ns;
+		appstate->replay_pending = false;
+		advance(appstate, tetris, appstate->replay_inputs, appstate->replay_dt_ns);
 	}
+}
 
-	for (i = 0; i < 16; i++) {
-		r[i] = tmp[i];
+/* Runs on the sim thread */
+static void sim_step(void* userdata, Tetris* tetris, Uint32 inputs, Uint64 dt_ns)
+{
+	AppState* appstate = userdata;
+	if (appstate->rewind && step_rewind(appstate, tetris, dt_ns))
+	{
+		return;
+	}
+	if (appstate->replay)
+	{
+		play_replay(appstate, tetris, dt_ns);
+	}
+	else
+	{
+		advance(appstate, tetris, inputs, dt_ns);
 	}
 }
 
-typedef struct VertexData
-{
-	float x, y, z; /* 3D data. Vertex range -0.5..0.5 in all axes. Z -0.5 is near, 0.5 is far. */
-	float red, green, blue;  /* intensity 0 to 1 (alpha is always 1). */
-} VertexData;
-
-static const VertexData vertex_data[] = {
-	/* Front face. */
-	/* Bottom left */
-	{ -0.5,  0.5, -0.5, 1.0, 0.0, 0.0 }, /* red */
-	{  0.5, -0.5, -0.5, 0.0, 0.0, 1.0 }, /* blue */
-	{ -0.5, -0.5, -0.5, 0.0, 1.0, 0.0 }, /* green */
-
-	/* Top right */
-	{ -0.5, 0.5, -0.5, 1.0, 0.0, 0.0 }, /* red */
-	{ 0.5,  0.5, -0.5, 1.0, 1.0, 0.0 }, /* yellow */
-	{ 0.5, -0.5, -0.5, 0.0, 0.0, 1.0 }, /* blue */
-
-	/* Left face */
-	/* Bottom left */
-	{ -0.5,  0.5,  0.5, 1.0, 1.0, 1.0 }, /* white */
-	{ -0.5, -0.5, -0.5, 0.0, 1.0, 0.0 }, /* green */
-	{ -0.5, -0.5,  0.5, 0.0, 1.0, 1.0 }, /* cyan */
-
-	/* Top right */
-	{ -0.5,  0.5,  0.5, 1.0, 1.0, 1.0 }, /* white */
-	{ -0.5,  0.5, -0.5, 1.0, 0.0, 0.0 }, /* red */
-	{ -0.5, -0.5, -0.5, 0.0, 1.0, 0.0 }, /* green */
-
-	/* Top face */
-	/* Bottom left */
-	{ -0.5, 0.5,  0.5, 1.0, 1.0, 1.0 }, /* white */
-	{  0.5, 0.5, -0.5, 1.0, 1.0, 0.0 }, /* yellow */
-	{ -0.5, 0.5, -0.5, 1.0, 0.0, 0.0 }, /* red */
-
-	/* Top right */
-	{ -0.5, 0.5,  0.5, 1.0, 1.0, 1.0 }, /* white */
-	{  0.5, 0.5,  0.5, 0.0, 0.0, 0.0 }, /* black */
-	{  0.5, 0.5, -0.5, 1.0, 1.0, 0.0 }, /* yellow */
-
-	/* Right face */
-	/* Bottom left */
-	{ 0.5,  0.5, -0.5, 1.0, 1.0, 0.0 }, /* yellow */
-	{ 0.5, -0.5,  0.5, 1.0, 0.0, 1.0 }, /* magenta */
-	{ 0.5, -0.5, -0.5, 0.0, 0.0, 1.0 }, /* blue */
-
-	/* Top right */
-	{ 0.5,  0.5, -0.5, 1.0, 1.0, 0.0 }, /* yellow */
-	{ 0.5,  0.5,  0.5, 0.0, 0.0, 0.0 }, /* black */
-	{ 0.5, -0.5,  0.5, 1.0, 0.0, 1.0 }, /* magenta */
-
-	/* Back face */
-	/* Bottom left */
-	{  0.5,  0.5, 0.5, 0.0, 0.0, 0.0 }, /* black */
-	{ -0.5, -0.5, 0.5, 0.0, 1.0, 1.0 }, /* cyan */
-	{  0.5, -0.5, 0.5, 1.0, 0.0, 1.0 }, /* magenta */
-
-	/* Top right */
-	{  0.5,  0.5,  0.5, 0.0, 0.0, 0.0 }, /* black */
-	{ -0.5,  0.5,  0.5, 1.0, 1.0, 1.0 }, /* white */
-	{ -0.5, -0.5,  0.5, 0.0, 1.0, 1.0 }, /* cyan */
-
-	/* Bottom face */
-	/* Bottom left */
-	{ -0.5, -0.5, -0.5, 0.0, 1.0, 0.0 }, /* green */
-	{  0.5, -0.5,  0.5, 1.0, 0.0, 1.0 }, /* magenta */
-	{ -0.5, -0.5,  0.5, 0.0, 1.0, 1.0 }, /* cyan */
-
-	/* Top right */
-	{ -0.5, -0.5, -0.5, 0.0, 1.0, 0.0 }, /* green */
-	{  0.5, -0.5, -0.5, 0.0, 0.0, 1.0 }, /* blue */
-	{  0.5, -0.5,  0.5, 1.0, 0.0, 1.0 } /* magenta */
-};
-
-static SDL_GPUTexture*
-CreateDepthTexture(AppState* appstate, Uint32 drawablew, Uint32 drawableh)
+/* A key press on one tick in eight for each wall game, so the boards fill up and clear */
+static Uint32 wall_input(void* userdata, const TetrisBatch* batch, Uint32 game, Uint64 tick)
 {
-	SDL_GPUTextureCreateInfo createinfo;
-	SDL_GPUTexture* result;
-
-	SDL_GPUDevice* gpu_device = appstate->gpu_device;
-	SDLTest_CommonState* state = appstate->state;
-	RenderState* render_state = &appstate->render_state;
-
-	createinfo.type = SDL_GPU_TEXTURETYPE_2D;
-	createinfo.format = SDL_GPU_TEXTUREFORMAT_D16_UNORM;
-	createinfo.width = drawablew;
-	createinfo.height = drawableh;
-	createinfo.layer_count_or_depth = 1;
-	createinfo.num_levels = 1;
-	createinfo.sample_count = render_state->sample_count;
-	createinfo.usage = SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET;
-	createinfo.props = 0;
-
-	result = SDL_CreateGPUTexture(gpu_device, &createinfo);
-	CHECK_CREATE(result, "Depth Texture");
-
-	return result;
+	static const Uint32 keys[8] = {
+		TETRIS_INPUT_LEFT, TETRIS_INPUT_RIGHT, TETRIS_INPUT_ROTATE, TETRIS_INPUT_DOWN,
+		TETRIS_INPUT_DROP, TETRIS_INPUT_LEFT, TETRIS_INPUT_RIGHT, TETRIS_INPUT_ROTATE
+	};
+	Uint32 hash = (Uint32)(tick * 0x9E3779B1u) ^ (game * 0x85EBCA77u);
+	hash ^= hash >> 15;
+	hash *= 0xC2B2AE3Du;
+	hash ^= hash >> 13;
+	return (hash & 7) == 0 ? keys[(hash >> 3) & 7] : 0;
 }
 
-static SDL_GPUTexture*
-CreateMSAATexture(AppState* appstate, Uint32 drawablew, Uint32 drawableh)
+static void draw_wall(AppState* appstate)
 {
-	SDL_GPUTextureCreateInfo createinfo;
-	SDL_GPUTexture* result;
-
-	SDL_GPUDevice* gpu_device = appstate->gpu_device;
-	SDLTest_CommonState* state = appstate->state;
-	RenderState* render_state = &appstate->render_state;
-
-	if (render_state->sample_count == SDL_GPU_SAMPLECOUNT_1) {
-		return NULL;
+	Uint64 lap = frametimes_now(appstate->frame_times);
+	Uint32 num_boards = tetris_batch_num_games(appstate->wall);
+	tetris_batch_run(appstate->wall, 1, HEADLESS_TICK_NS, wall_input, NULL, NULL);
+	for (Uint32 game = 0; game < num_boards; ++game)
+	{
+		tetris_batch_get(appstate->wall, game, &appstate->wall_boards[game]);
 	}
+	frametimes_lap(appstate->frame_times, FRAME_STAGE_SIM, lap);
 
-	createinfo.type = SDL_GPU_TEXTURETYPE_2D;
-	createinfo.format = SDL_GetGPUSwapchainTextureFormat(gpu_device, state->windows[0]);
-	createinfo.width = drawablew;
-	createinfo.height = drawableh;
-	createinfo.layer_count_or_depth = 1;
-	createinfo.num_levels = 1;
-	createinfo.sample_count = render_state->sample_count;
-	createinfo.usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
-	createinfo.props = 0;
-
-	result = SDL_CreateGPUTexture(gpu_device, &createinfo);
-	CHECK_CREATE(result, "MSAA Texture");
-
-	return result;
+	for (int window_index = 0; window_index < appstate->state->num_windows; ++window_index)
+	{
+		renderer_draw_wall(appstate->renderer, window_index, appstate->wall_boards, num_boards);
+	}
 }
 
-static SDL_GPUTexture*
-CreateResolveTexture(AppState* appstate, Uint32 drawablew, Uint32 drawableh)
+static void log_versus(Versus* versus)
 {
-	SDL_GPUTextureCreateInfo createinfo;
-	SDL_GPUTexture* result;
-
-	SDL_GPUDevice* gpu_device = appstate->gpu_device;
-	SDLTest_CommonState* state = appstate->state;
-	RenderState* render_state = &appstate->render_state;
-
-	if (render_state->sample_count == SDL_GPU_SAMPLECOUNT_1) {
-		return NULL;
-	}
-
-	createinfo.type = SDL_GPU_TEXTURETYPE_2D;
-	createinfo.format = SDL_GetGPUSwapchainTextureFormat(gpu_device, state->windows[0]);
-	createinfo.width = drawablew;
-	createinfo.height = drawableh;
-	createinfo.layer_count_or_depth = 1;
-	createinfo.num_levels = 1;
-	createinfo.sample_count = SDL_GPU_SAMPLECOUNT_1;
-	createinfo.usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER;
-	createinfo.props = 0;
-
-	result = SDL_CreateGPUTexture(gpu_device, &createinfo);
-	CHECK_CREATE(result, "Resolve Texture");
-
-	return result;
+	VersusStats stats;
+	versus_get_stats(versus, &stats);
+	SDL_Log("Versus: tick %u (%u confirmed), %" SDL_PRIu64 " rollbacks of %.1f ticks avg (%u max), re-simulation %.1f us avg (%.1f max), %" SDL_PRIu64 " stalls, %" SDL_PRIu64 " desyncs",
+		stats.tick, stats.confirmed_tick, stats.rollbacks,
+		stats.rollbacks ? (double)stats.resim_ticks / (double)stats.rollbacks : 0.0, stats.max_rollback,
+		stats.rollbacks ? (double)stats.resim_ns / (double)stats.rollbacks / 1e3 : 0.0, (double)stats.max_resim_ns / 1e3,
+		stats.stalls, stats.desyncs);
 }
 
-static void get_piece_coords(Uint8 piece, int x, int y, Uint8 rot, int* xs_out, int* ys_out)
+static void log_rewind(RewindBuffer* rewind)
 {
-	//                  L          J          S          Z          T          O          I
-	const int xs[] = { -1,-1, 1,  -1, 1, 1,  -1, 0, 1,  -1, 0,-1,  -1, 0, 1,  -1,-1, 0,  -2,-1, 1 };
-	const int ys[] = { -1, 0, 0,   0, 0,-1,  -1,-1, 0,   0,-1,-1,   0,-1, 0,  -1, 0,-1,   0, 0, 0 };
-	int o = (piece - 1) * 3;
-	switch (rot)
-	{
-	case 0:
-		xs_out[0] = x + xs[o + 0]; xs_out[1] = x + xs[o + 1]; xs_out[2] = x + xs[o + 2];
-		ys_out[0] = y + ys[o + 0]; ys_out[1] = y + ys[o + 1]; ys_out[2] = y + ys[o + 2];
-		break;
-	case 1:
-		xs_out[0] = x + ys[o + 0]; xs_out[1] = x + ys[o + 1]; xs_out[2] = x + ys[o + 2];
-		ys_out[0] = y - xs[o + 0]; ys_out[1] = y - xs[o + 1]; ys_out[2] = y - xs[o + 2];
-		break;
-	case 2:
-		xs_out[0] = x - xs[o + 0]; xs_out[1] = x - xs[o + 1]; xs_out[2] = x - xs[o + 2];
-		ys_out[0] = y - ys[o + 0]; ys_out[1] = y - ys[o + 1]; ys_out[2] = y - ys[o + 2];
-		break;
-	case 3:
-		xs_out[0] = x - ys[o + 0]; xs_out[1] = x - ys[o + 1]; xs_out[2] = x - ys[o + 2];
-		ys_out[0] = y + xs[o + 0]; ys_out[1] = y + xs[o + 1]; ys_out[2] = y + xs[o + 2];
-		break;
-	default:
-		SDL_assert_always(!"rot < 4");
-	}
-
-	xs_out[3] = x;
-	ys_out[3] = y;
+	RewindStats stats;
+	rewind_get_stats(rewind, &stats);
+	SDL_Log("Rewind: %" SDL_PRIu64 " ticks kept in %u of %u KiB, %.1f bytes per tick, %u keyframes",
+		stats.num_ticks, stats.bytes_used / 1024, stats.capacity / 1024,
+		stats.num_ticks ? (double)stats.bytes_used / (double)stats.num_ticks : 0.0, stats.num_keyframes);
 }
 
-static int try_move(Tetris* tetris, int dx, int dy, int drot)
+/* The queued presses the next tick takes: the oldest of each key, so none is merged with another */
+static Uint32 next_versus_inputs(const AppState* appstate)
 {
-	//                   L  J  S  Z  T  O  I
-	const int rots[] = { 4, 4, 2, 2, 4, 1, 2 };
-	int xs[4] = { 0 };
-	int ys[4] = { 0 };
-	int x = tetris->x + dx;
-	int y = tetris->y + dy;
-	int rot = (tetris->rot + drot + 4) % rots[tetris->piece - 1];
-	get_piece_coords(tetris->piece, x, y, rot, xs, ys);
-	if (xs[0] < 0 || xs[0] >= 10 || ys[0] < 0 || ys[0] >= 22 || (tetris->board[xs[0] + ys[0] * 10] != 0) ||
-		xs[1] < 0 || xs[1] >= 10 || ys[1] < 0 || ys[1] >= 22 || (tetris->board[xs[1] + ys[1] * 10] != 0) ||
-		xs[2] < 0 || xs[2] >= 10 || ys[2] < 0 || ys[2] >= 22 || (tetris->board[xs[2] + ys[2] * 10] != 0) ||
-		xs[3] < 0 || xs[3] >= 10 || ys[3] < 0 || ys[3] >= 22 || (tetris->board[xs[3] + ys[3] * 10] != 0))
-	{
-		return 0;
-	}
-
-	tetris->x = x;
-	tetris->y = y;
-	tetris->rot = rot;
-	return 1;
+	Uint32 inputs = 0;
+	for (Uint32 i = 0; i < appstate->num_versus_presses; ++i)
+	{
+		inputs |= appstate->versus_presses[i];
+	}
+	return inputs;
 }
 
-void glue(Tetris* tetris)
+/* Takes the presses of next_versus_inputs off the queue */
+static void pop_versus_inputs(AppState* appstate, Uint32 inputs)
 {
-	int xs[4] = { 0 };
-	int ys[4] = { 0 };
-	get_piece_coords(tetris->piece, tetris->x, tetris->y, tetris->rot, xs, ys);
-
-	tetris->board[xs[0] + ys[0] * 10] = tetris->piece;
-	tetris->board[xs[1] + ys[1] * 10] = tetris->piece;
-	tetris->board[xs[2] + ys[2] * 10] = tetris->piece;
-	tetris->board[xs[3] + ys[3] * 10] = tetris->piece;
-
-	tetris->piece = (tetris->piece % 7) + 1;
-	tetris->x = 5;	
-	tetris->y = 20;
-	tetris->rot = 0;
-
-	int cleared = 0;
-	for (int y = 0; y < 22; ++y)
+	Uint32 kept = 0;
+	for (Uint32 i = 0; i < appstate->num_versus_presses; ++i)
 	{
-		int count = 0;
-		for (int x = 0; x < 10; ++x)
+		Uint32 press = appstate->versus_presses[i];
+		if (inputs & press)
 		{
-			int old = tetris->board[x + y * 10];
-			count += old != 0;
-			tetris->board[x + y * 10] = 0;
-			tetris->board[x + (y - cleared) * 10] = old;
+			inputs &= ~press;
 		}
+		else
+		{
+			appstate->versus_presses[kept++] = press;
+		}
+	}
+	appstate->num_versus_presses = kept;
+}
 
-		cleared += count == 10;
+/* Runs the ticks due by the clock, then draws both games side by side */
+static void draw_versus(AppState* appstate)
+{
+	Uint64 lap = frametimes_now(appstate->frame_times);
+	Uint64 now_ns = SDL_GetTicksNS();
+	/* After a hitch or a wait for the peer, catch up a few ticks at most */
+	appstate->versus_due_ns = SDL_min(appstate->versus_due_ns + now_ns - appstate->versus_clock_ns, 4 * VERSUS_TICK_NS);
+	appstate->versus_clock_ns = now_ns;
+	if (appstate->versus_due_ns < VERSUS_TICK_NS)
+	{
+		versus_poll(appstate->versus);
 	}
+	while (appstate->versus_due_ns >= VERSUS_TICK_NS)
+	{
+		Uint32 inputs = next_versus_inputs(appstate);
+		if (!versus_tick(appstate->versus, inputs))
+		{
+			appstate->versus_due_ns = 0;
+			break;
+		}
+		pop_versus_inputs(appstate, inputs);
+		appstate->versus_due_ns -= VERSUS_TICK_NS;
+	}
+	frametimes_lap(appstate->frame_times, FRAME_STAGE_SIM, lap);
 
-	tetris->score += (tetris->lines / 10 + 1) << cleared;
-	tetris->lines += cleared;
+	for (int window_index = 0; window_index < appstate->state->num_windows; ++window_index)
+	{
+		renderer_draw_wall(appstate->renderer, window_index, versus_boards(appstate->versus), 2);
+	}
 
-	if (!try_move(tetris, 0, 0, 0))
+	if (now_ns - appstate->versus_log_ns >= 5 * SDL_NS_PER_SECOND)
 	{
-		// Game over
-		tetris->piece = 0;
+		log_versus(appstate->versus);
+		appstate->versus_log_ns = now_ns;
 	}
 }
 
-static void Render(AppState* appstate, SDL_Window* window, const int windownum)
+SDL_AppResult SDL_AppIterate(void* appstate_ptr)
 {
-	WindowState* winstate = &appstate->window_states[windownum];
-	SDL_GPUTexture* swapchainTexture;
-	SDL_GPUColorTargetInfo color_target;
-	SDL_GPUDepthStencilTargetInfo depth_target;
-	float matrix_rotate[16], matrix_modelview[16], matrix_perspective[16];
-	SDL_GPUCommandBuffer* cmd;
-	SDL_GPURenderPass* pass;
-	SDL_GPUBufferBinding vertex_binding;
-	SDL_GPUBlitInfo blit_info;
-	int drawablew, drawableh;
-
-	SDL_GPUDevice* gpu_device = appstate->gpu_device;
-	SDLTest_CommonState* state = appstate->state;
-	RenderState* render_state = &appstate->render_state;
-
-	/* Acquire the swapchain texture */
-	cmd = SDL_AcquireGPUCommandBuffer(gpu_device);
-	if (!cmd) {
-		SDL_Log("Failed to acquire command buffer :%s", SDL_GetError());
-		SDL_assert_always(0);
-		return;
+	AppState* appstate = appstate_ptr;
+
+	/* Every window shows the same tick, however far the sim thread gets meanwhile */
+	Uint64 lap = frametimes_begin_frame(appstate->frame_times);
+	renderer_begin_frame(appstate->renderer);
+	lap = frametimes_now(appstate->frame_times);
+	const Tetris* tetris = NULL;
+	Uint32 keys_applied = appstate->keys_shown;
+	if (appstate->wall || appstate->versus)
+	{
+		/* Bots play or the games tick on the clock; key presses are not timed */
 	}
-	if (!SDL_AcquireGPUSwapchainTexture(cmd, state->windows[windownum], &swapchainTexture)) {
-		SDL_Log("Failed to acquire swapchain texture: %s", SDL_GetError());
-		SDL_assert_always(0);
-		return;
+	else if (appstate->headless_frames > 0)
+	{
+		/* A fixed tick per frame, so every headless run draws the same frames */
+		sim_step(appstate, appstate->tetris, 0, HEADLESS_TICK_NS);
+		tetris = appstate->tetris;
 	}
-
-	if (swapchainTexture == NULL) {
-		/* No swapchain was acquired, probably too many frames in flight */
-		SDL_SubmitGPUCommandBuffer(cmd);
-		return;
+	else
+	{
+		tetris = sim_acquire_snapshot(appstate->sim);
+		keys_applied = sim_snapshot_inputs(appstate->sim);
 	}
-
-	SDL_GetWindowSizeInPixels(window, &drawablew, &drawableh);
-
-	/*
-	* Do some rotation with Euler angles. It is not a fixed axis as
-	* quaterions would be, but the effect is cool.
-	*/
-	rotate_matrix((float)winstate->angle_x, 1.0f, 0.0f, 0.0f, matrix_modelview);
-	rotate_matrix((float)winstate->angle_y, 0.0f, 1.0f, 0.0f, matrix_rotate);
-
-	multiply_matrix(matrix_rotate, matrix_modelview, matrix_modelview);
-
-	rotate_matrix((float)winstate->angle_z, 0.0f, 1.0f, 0.0f, matrix_rotate);
-
-	multiply_matrix(matrix_rotate, matrix_modelview, matrix_modelview);
-
-	perspective_matrix(45.0f, (float)drawablew / drawableh, 0.01f, 100.0f, matrix_perspective);
-
-	winstate->angle_x += 3;
-	winstate->angle_y += 2;
-	winstate->angle_z += 1;
-
-	if (winstate->angle_x >= 360) winstate->angle_x -= 360;
-	if (winstate->angle_x < 0) winstate->angle_x += 360;
-	if (winstate->angle_y >= 360) winstate->angle_y -= 360;
-	if (winstate->angle_y < 0) winstate->angle_y += 360;
-	if (winstate->angle_z >= 360) winstate->angle_z -= 360;
-	if (winstate->angle_z < 0) winstate->angle_z += 360;
-
-	/* Resize the depth buffer if the window size changed */
-
-	if (winstate->prev_drawablew != drawablew || winstate->prev_drawableh != drawableh) {
-		SDL_ReleaseGPUTexture(gpu_device, winstate->tex_depth);
-		SDL_ReleaseGPUTexture(gpu_device, winstate->tex_msaa);
-		SDL_ReleaseGPUTexture(gpu_device, winstate->tex_resolve);
-		winstate->tex_depth = CreateDepthTexture(appstate, drawablew, drawableh);
-		winstate->tex_msaa = CreateMSAATexture(appstate, drawablew, drawableh);
-		winstate->tex_resolve = CreateResolveTexture(appstate, drawablew, drawableh);
+	if (tetris)
+	{
+		frametimes_lap(appstate->frame_times, FRAME_STAGE_SIM, lap);
 	}
-	winstate->prev_drawablew = drawablew;
-	winstate->prev_drawableh = drawableh;
-
-	/* Set up the pass */
 
-	SDL_zero(color_target);
-	color_target.clear_color.a = 1.0f;
-	if (winstate->tex_msaa) {
-		color_target.load_op = SDL_GPU_LOADOP_CLEAR;
-		color_target.store_op = SDL_GPU_STOREOP_RESOLVE;
-		color_target.texture = winstate->tex_msaa;
-		color_target.resolve_texture = winstate->tex_resolve;
-		color_target.cycle = true;
-		color_target.cycle_resolve_texture = true;
+	bool ready = appstate->startup_stage == 2 || renderer_is_ready(appstate->renderer);
+	if (appstate->versus)
+	{
+		draw_versus(appstate);
 	}
-	else {
-		color_target.load_op = SDL_GPU_LOADOP_CLEAR;
-		color_target.store_op = SDL_GPU_STOREOP_STORE;
-		color_target.texture = swapchainTexture;
+	else if (appstate->wall)
+	{
+		draw_wall(appstate);
 	}
-
-	SDL_zero(depth_target);
-	depth_target.clear_depth = 1.0f;
-	depth_target.load_op = SDL_GPU_LOADOP_CLEAR;
-	depth_target.store_op = SDL_GPU_STOREOP_DONT_CARE;
-	depth_target.stencil_load_op = SDL_GPU_LOADOP_DONT_CARE;
-	depth_target.stencil_store_op = SDL_GPU_STOREOP_DONT_CARE;
-	depth_target.texture = winstate->tex_depth;
-	depth_target.cycle = true;
-
-	/* Set up the bindings */
-
-	vertex_binding.buffer = render_state->buf_vertex;
-	vertex_binding.offset = 0;
-
-	/* Draw the cube(s)! */
-
-	pass = SDL_BeginGPURenderPass(cmd, &color_target, 1, &depth_target);
-	SDL_BindGPUGraphicsPipeline(pass, render_state->pipeline);
-	SDL_BindGPUVertexBuffers(pass, 0, &vertex_binding, 1);
-
-	matrix_modelview[14] = -22.0f;
-
-	Tetris* tetris = appstate->tetris;
-	int piece_xs[4] = { 0 };
-	int piece_ys[4] = { 0 };
-	get_piece_coords(tetris->piece, tetris->x, tetris->y, tetris->rot, piece_xs, piece_ys);
-
-	for (int i = 0; i < 220; ++i)
+	else if (appstate->one_submit)
+	{
+		renderer_draw_all(appstate->renderer, tetris);
+	}
+	else
 	{
-		Uint8 color = tetris->board[i];
-		int x = i % 10;
-		int y = i / 10;
-		color = (
-			(piece_xs[0] == x && piece_ys[0] == y) ||
-			(piece_xs[1] == x && piece_ys[1] == y) ||
-			(piece_xs[2] == x && piece_ys[2] == y) ||
-			(piece_xs[3] == x && piece_ys[3] == y)
-			) ? tetris->piece : color;
-		if (color == 0)
+		for (int window_index = 0; window_index < appstate->state->num_windows; ++window_index)
 		{
-			continue;
+			renderer_draw(appstate->renderer, window_index, tetris);
 		}
-		matrix_modelview[12] = (float)x - 4.5f;
-		matrix_modelview[13] = (float)y - 10.5f;
-
-		float matrix_final[16];
-		multiply_matrix(matrix_perspective, matrix_modelview, matrix_final);
-		SDL_PushGPUVertexUniformData(cmd, 0, matrix_final, sizeof(matrix_final));
-		SDL_DrawGPUPrimitives(pass, 36, 1, 0, 0);
 	}
 
-	SDL_EndGPURenderPass(pass);
-
-	/* Blit MSAA resolve target to swapchain, if needed */
-	if (render_state->sample_count > SDL_GPU_SAMPLECOUNT_1) {
-		SDL_zero(blit_info);
-		blit_info.source.texture = winstate->tex_resolve;
-		blit_info.source.w = drawablew;
-		blit_info.source.h = drawableh;
-
-		blit_info.destination.texture = swapchainTexture;
-		blit_info.destination.w = drawablew;
-		blit_info.destination.h = drawableh;
-
-		blit_info.load_op = SDL_GPU_LOADOP_DONT_CARE;
-		blit_info.filter = SDL_GPU_FILTER_LINEAR;
-
-		SDL_BlitGPUTexture(cmd, &blit_info);
+	/* Key down to the submit of the first frame showing the press */
+	Uint64 now_ns = SDL_GetTicksNS();
+	for (; appstate->keys_shown != keys_applied; ++appstate->keys_shown)
+	{
+		frametimes_input_latency(appstate->frame_times, now_ns - appstate->key_times[appstate->keys_shown % KEY_TIMES]);
 	}
+	frametimes_end_frame(appstate->frame_times);
 
-	/* Submit the command buffer! */
-	SDL_SubmitGPUCommandBuffer(cmd);
-
-	appstate->frames += 1;
-}
-
-static SDL_GPUShader*
-load_shader(AppState* appstate, bool is_vertex)
-{
-	SDL_GPUDevice* gpu_device = appstate->gpu_device;
-	SDLTest_CommonState* state = appstate->state;
-	RenderState* render_state = &appstate->render_state;
-
-	SDL_GPUShaderCreateInfo createinfo;
-	createinfo.num_samplers = 0;
-	createinfo.num_storage_buffers = 0;
-	createinfo.num_storage_textures = 0;
-	createinfo.num_uniform_buffers = is_vertex ? 1 : 0;
-	createinfo.props = 0;
-
-	SDL_GPUShaderFormat format = SDL_GetGPUShaderFormats(gpu_device);
-	if (format & SDL_GPU_SHADERFORMAT_DXBC) {
-		createinfo.format = SDL_GPU_SHADERFORMAT_DXBC;
-		createinfo.code = is_vertex ? D3D11_CubeVert : D3D11_CubeFrag;
-		createinfo.code_size = is_vertex ? SDL_arraysize(D3D11_CubeVert) : SDL_arraysize(D3D11_CubeFrag);
-		createinfo.entrypoint = is_vertex ? "VSMain" : "PSMain";
-	}
-	else if (format & SDL_GPU_SHADERFORMAT_DXIL) {
-		createinfo.format = SDL_GPU_SHADERFORMAT_DXIL;
-		createinfo.code = is_vertex ? D3D12_CubeVert : D3D12_CubeFrag;
-		createinfo.code_size = is_vertex ? SDL_arraysize(D3D12_CubeVert) : SDL_arraysize(D3D12_CubeFrag);
-		createinfo.entrypoint = is_vertex ? "VSMain" : "PSMain";
-	}
-	else if (format & SDL_GPU_SHADERFORMAT_METALLIB) {
-		createinfo.format = SDL_GPU_SHADERFORMAT_METALLIB;
-		createinfo.code = is_vertex ? cube_vert_metallib : cube_frag_metallib;
-		createinfo.code_size = is_vertex ? cube_vert_metallib_len : cube_frag_metallib_len;
-		createinfo.entrypoint = is_vertex ? "vs_main" : "fs_main";
-	}
-	else {
-		createinfo.format = SDL_GPU_SHADERFORMAT_SPIRV;
-		createinfo.code = is_vertex ? cube_vert_spv : cube_frag_spv;
-		createinfo.code_size = is_vertex ? cube_vert_spv_len : cube_frag_spv_len;
-		createinfo.entrypoint = "main";
-	}
-
-	createinfo.stage = is_vertex ? SDL_GPU_SHADERSTAGE_VERTEX : SDL_GPU_SHADERSTAGE_FRAGMENT;
-	return SDL_CreateGPUShader(gpu_device, &createinfo);
-}
-
-static SDL_AppResult
-init_render_state(AppState* appstate, int msaa)
-{
-	SDL_GPUCommandBuffer* cmd;
-	SDL_GPUTransferBuffer* buf_transfer;
-	void* map;
-	SDL_GPUTransferBufferLocation buf_location;
-	SDL_GPUBufferRegion dst_region;
-	SDL_GPUCopyPass* copy_pass;
-	SDL_GPUBufferCreateInfo buffer_desc;
-	SDL_GPUTransferBufferCreateInfo transfer_buffer_desc;
-	SDL_GPUGraphicsPipelineCreateInfo pipelinedesc;
-	SDL_GPUColorTargetDescription color_target_desc;
-	Uint32 drawablew, drawableh;
-	SDL_GPUVertexAttribute vertex_attributes[2];
-	SDL_GPUVertexBufferDescription vertex_buffer_desc;
-	SDL_GPUShader* vertex_shader;
-	SDL_GPUShader* fragment_shader;
-
-	appstate->gpu_device = SDL_CreateGPUDevice(
-		TESTGPU_SUPPORTED_FORMATS,
-		true,
-		appstate->state->gpudriver
-	);
-	CHECK_CREATE(appstate->gpu_device, "GPU device");
-
-	/* Claim the windows */
-	for (int i = 0; i < appstate->state->num_windows; ++i) {
-		SDL_ClaimWindowForGPUDevice(
-			appstate->gpu_device,
-			appstate->state->windows[i]
-		);
-	}
-
-	/* Create shaders */
-
-	vertex_shader = load_shader(appstate, true);
-	CHECK_CREATE(vertex_shader, "Vertex Shader");
-	fragment_shader = load_shader(appstate, false);
-	CHECK_CREATE(fragment_shader, "Fragment Shader");
-
-	/* Create buffers */
-
-	buffer_desc.usage = SDL_GPU_BUFFERUSAGE_VERTEX;
-	buffer_desc.size = sizeof(vertex_data);
-	buffer_desc.props = 0;
-	appstate->render_state.buf_vertex = SDL_CreateGPUBuffer(
-		appstate->gpu_device,
-		&buffer_desc
-	);
-	CHECK_CREATE(appstate->render_state.buf_vertex, "Static vertex buffer");
-
-#pragma warning(push)
-#pragma warning(disable: 4566)
-	SDL_SetGPUBufferName(appstate->gpu_device, appstate->render_state.buf_vertex, "космонавт");
-#pragma warning(pop)
-
-	transfer_buffer_desc.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
-	transfer_buffer_desc.size = sizeof(vertex_data);
-	transfer_buffer_desc.props = 0;
-	buf_transfer = SDL_CreateGPUTransferBuffer(
-		appstate->gpu_device,
-		&transfer_buffer_desc
-	);
-	CHECK_CREATE(buf_transfer, "Vertex transfer buffer");
-
-	/* We just need to upload the static data once. */
-	map = SDL_MapGPUTransferBuffer(appstate->gpu_device, buf_transfer, false);
-	SDL_memcpy(map, vertex_data, sizeof(vertex_data));
-	SDL_UnmapGPUTransferBuffer(appstate->gpu_device, buf_transfer);
-
-	cmd = SDL_AcquireGPUCommandBuffer(appstate->gpu_device);
-	copy_pass = SDL_BeginGPUCopyPass(cmd);
-	buf_location.transfer_buffer = buf_transfer;
-	buf_location.offset = 0;
-	dst_region.buffer = appstate->render_state.buf_vertex;
-	dst_region.offset = 0;
-	dst_region.size = sizeof(vertex_data);
-	SDL_UploadToGPUBuffer(copy_pass, &buf_location, &dst_region, false);
-	SDL_EndGPUCopyPass(copy_pass);
-	SDL_SubmitGPUCommandBuffer(cmd);
-
-	SDL_ReleaseGPUTransferBuffer(appstate->gpu_device, buf_transfer);
-
-	/* Determine which sample count to use */
-	appstate->render_state.sample_count = SDL_GPU_SAMPLECOUNT_1;
-	if (msaa && SDL_GPUTextureSupportsSampleCount(
-		appstate->gpu_device,
-		SDL_GetGPUSwapchainTextureFormat(appstate->gpu_device, appstate->state->windows[0]),
-		SDL_GPU_SAMPLECOUNT_4)) {
-		appstate->render_state.sample_count = SDL_GPU_SAMPLECOUNT_4;
-	}
-
-	/* Set up the graphics pipeline */
-
-	SDL_zero(pipelinedesc);
-	SDL_zero(color_target_desc);
-
-	color_target_desc.format = SDL_GetGPUSwapchainTextureFormat(appstate->gpu_device, appstate->state->windows[0]);
-
-	pipelinedesc.target_info.num_color_targets = 1;
-	pipelinedesc.target_info.color_target_descriptions = &color_target_desc;
-	pipelinedesc.target_info.depth_stencil_format = SDL_GPU_TEXTUREFORMAT_D16_UNORM;
-	pipelinedesc.target_info.has_depth_stencil_target = true;
-
-	pipelinedesc.depth_stencil_state.enable_depth_test = true;
-	pipelinedesc.depth_stencil_state.enable_depth_write = true;
-	pipelinedesc.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS_OR_EQUAL;
-
-	pipelinedesc.multisample_state.sample_count = appstate->render_state.sample_count;
-
-	pipelinedesc.primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST;
-
-	pipelinedesc.vertex_shader = vertex_shader;
-	pipelinedesc.fragment_shader = fragment_shader;
-
-	vertex_buffer_desc.slot = 0;
-	vertex_buffer_desc.input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
-	vertex_buffer_desc.instance_step_rate = 0;
-	vertex_buffer_desc.pitch = sizeof(VertexData);
-
-	vertex_attributes[0].buffer_slot = 0;
-	vertex_attributes[0].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3;
-	vertex_attributes[0].location = 0;
-	vertex_attributes[0].offset = 0;
-
-	vertex_attributes[1].buffer_slot = 0;
-	vertex_attributes[1].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3;
-	vertex_attributes[1].location = 1;
-	vertex_attributes[1].offset = sizeof(float) * 3;
-
-	pipelinedesc.vertex_input_state.num_vertex_buffers = 1;
-	pipelinedesc.vertex_input_state.vertex_buffer_descriptions = &vertex_buffer_desc;
-	pipelinedesc.vertex_input_state.num_vertex_attributes = 2;
-	pipelinedesc.vertex_input_state.vertex_attributes = (SDL_GPUVertexAttribute*)&vertex_attributes;
-
-	pipelinedesc.props = 0;
-
-	appstate->render_state.pipeline = SDL_CreateGPUGraphicsPipeline(appstate->gpu_device, &pipelinedesc);
-	CHECK_CREATE(appstate->render_state.pipeline, "Render Pipeline");
-
-	/* These are reference-counted; once the pipeline is created, you don't need to keep these. */
-	SDL_ReleaseGPUShader(appstate->gpu_device, vertex_shader);
-	SDL_ReleaseGPUShader(appstate->gpu_device, fragment_shader);
-
-	/* Set up per-window state */
-	appstate->window_states = (WindowState*)SDL_calloc(appstate->state->num_windows, sizeof(WindowState));
-	if (!appstate->window_states)
-	{
-		SDL_Log("Out of memory!\n");
-		return SDL_APP_FAILURE;
+	if (appstate->startup_stage == 0 && !ready)
+	{
+		startup_mark("first cleared frame submitted");
+		appstate->startup_stage = 1;
 	}
-
-	for (int i = 0; i < appstate->state->num_windows; ++i)
+	else if (appstate->startup_stage < 2 && ready)
 	{
-		WindowState* winstate = &appstate->window_states[i];
-
-		/* create a depth texture for the window */
-		SDL_GetWindowSizeInPixels(appstate->state->windows[i], (int*)&drawablew, (int*)&drawableh);
-		winstate->tex_depth = CreateDepthTexture(appstate, drawablew, drawableh);
-		winstate->tex_msaa = CreateMSAATexture(appstate, drawablew, drawableh);
-		winstate->tex_resolve = CreateResolveTexture(appstate, drawablew, drawableh);
-
-		/* make each window different */
-		winstate->angle_x = (i * 10) % 360;
-		winstate->angle_y = (i * 20) % 360;
-		winstate->angle_z = (i * 30) % 360;
+		startup_mark("first game frame submitted");
+		startup_log();
+		appstate->startup_stage = 2;
 	}
 
+	if (appstate->headless_frames > 0 && ++appstate->headless_drawn == appstate->headless_frames)
+	{
+		renderer_finish_frames(appstate->renderer);
+		double seconds = (SDL_GetTicksNS() - appstate->headless_start_ns) / 1e9;
+		SDL_Log("Headless: %" SDL_PRIu64 " frames in %.3f s, %.1f frames/s",
+			appstate->headless_drawn, seconds, appstate->headless_drawn / seconds);
+		return SDL_APP_SUCCESS;
+	}
 	return SDL_APP_CONTINUE;
 }
 
-SDL_AppResult SDL_AppIterate(void* appstate_ptr)
+static Uint32 key_to_input(SDL_Keycode key)
 {
-	AppState* appstate = appstate_ptr;
-
-	{
-		Tetris* tetris = appstate->tetris;
-		if (tetris->piece == 0)
-		{
-			SDL_memset(tetris, 0, sizeof(Tetris));
-			tetris->piece = 1;
-			tetris->x = 5;
-			tetris->y = 21;
-		}
-
-		Uint64 now = SDL_GetTicksNS();
-		Uint64 dt = now - tetris->prev_ns;
-		tetris->prev_ns = now;
-		if (tetris->drop_timer > dt)
-		{
-			tetris->drop_timer -= dt;
-		}
-		else
-		{
-			if (!try_move(tetris, 0, -1, 0))
-			{
-				glue(tetris);
-			}
-			tetris->drop_timer += 1000000000 >> (tetris->lines / 10);
-		}
-	}
-
-
-	for (int window_index = 0; window_index < appstate->state->num_windows; ++window_index)
+	switch (key)
 	{
-		Render(appstate, appstate->state->windows[window_index], window_index);
+	case SDLK_LEFT: return TETRIS_INPUT_LEFT;
+	case SDLK_RIGHT: return TETRIS_INPUT_RIGHT;
+	case SDLK_UP: return TETRIS_INPUT_ROTATE;
+	case SDLK_DOWN: return TETRIS_INPUT_DOWN;
+	case SDLK_SPACE: return TETRIS_INPUT_DROP;
+	default: return 0;
 	}
-	return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult SDL_AppEvent(void* appstate_ptr, SDL_Event* event)
@@ -854,45 +408,45 @@ SDL_AppResult SDL_AppEvent(void* appstate_ptr, SDL_Event* event)
 	int done = 0;
 	SDLTest_CommonEvent(appstate->state, event, &done);
 
-	if (event->type == SDL_EVENT_KEY_DOWN)
-	{
-		int rot = event->key.key == SDLK_UP;
-		int down = event->key.key == SDLK_DOWN;
-		int left = event->key.key == SDLK_LEFT;
-		int right = event->key.key == SDLK_RIGHT;
-		int drop = event->key.key == SDLK_SPACE;
-
-		Tetris* tetris = appstate->tetris;
-		
-		if (left)
-			try_move(tetris, -1, 0, 0);
-		if (right)
-			try_move(tetris, 1, 0, 0);
-		if (rot)
+	if (event->type == SDL_EVENT_KEY_DOWN && appstate->versus)
+	{
+		Uint32 inputs = key_to_input(event->key.key);
+		if (inputs && appstate->num_versus_presses < VERSUS_MAX_PRESSES)
 		{
-			int i_nudge = tetris->x == 0 && tetris->piece == 8;
-			int d = 1;
-			try_move(tetris, 0, 0, d) ||
-			try_move(tetris, -1, 0, d) ||
-			try_move(tetris, 1, 0, d) ||
-			(i_nudge && try_move(tetris, 2, 0, d)) ||
-			try_move(tetris, 0, -1, d) ||
-			try_move(tetris, 0, 1, d);
+			appstate->versus_presses[appstate->num_versus_presses++] = inputs;
 		}
-
-		if (drop || down)
+	}
+	else if (event->type == SDL_EVENT_MOUSE_WHEEL && appstate->wall)
+	{
+		renderer_scroll_wall(appstate->renderer, event->wheel.y > 0.0f ? -1 : 1);
+	}
+	else if (event->type == SDL_EVENT_KEY_DOWN && appstate->wall)
+	{
+		if (event->key.key == SDLK_PAGEUP || event->key.key == SDLK_PAGEDOWN)
 		{
-			while (drop && try_move(tetris, 0, -1, 0))
+			renderer_scroll_wall(appstate->renderer, event->key.key == SDLK_PAGEUP ? -4 : 4);
+		}
+	}
+	else if ((event->type == SDL_EVENT_KEY_DOWN || event->type == SDL_EVENT_KEY_UP) && event->key.key == SDLK_BACKSPACE)
+	{
+		/* The sim thread rewinds for as long as the key is held */
+		SDL_SetAtomicInt(&appstate->rewinding, event->type == SDL_EVENT_KEY_DOWN);
+	}
+	else if (event->type == SDL_EVENT_KEY_DOWN)
+	{
+		/* The sim thread applies key presses on its next tick, whatever the GPU is doing */
+		Uint32 inputs = key_to_input(event->key.key);
+		if (inputs && appstate->sim && !appstate->replay)
+		{
+			if (sim_push_input(appstate->sim, inputs))
 			{
-				// all the way down
+				appstate->key_times[appstate->keys_pushed++ % KEY_TIMES] = event->key.timestamp;
 			}
-
-			if (drop || (down && !try_move(tetris, 0, -1, 0)))
+			else if (!appstate->input_overflow)
 			{
-				glue(tetris);
+				SDL_Log("Input queue full, dropping key presses");
+				appstate->input_overflow = true;
 			}
-
-			tetris->drop_timer += 1000000000 >> (tetris->lines / 10);
 		}
 	}
 	return done ? SDL_APP_SUCCESS : SDL_APP_CONTINUE;
@@ -902,6 +456,7 @@ SDL_AppResult SDL_AppInit(void** appstate_out, int argc, char* argv[])
 {
 	AppState* appstate = SDL_calloc(1, sizeof(AppState));
 	*appstate_out = appstate;
+	startup_mark("SDL_AppInit");
 
 	/* Initialize test framework */
 	appstate->state = SDLTest_CommonCreateState(argv, SDL_INIT_VIDEO);
@@ -911,36 +466,194 @@ SDL_AppResult SDL_AppInit(void** appstate_out, int argc, char* argv[])
 	}
 
 	int msaa = 0;
+	bool msaa_blit = false;
+	const char* record_path = NULL;
+	const char* replay_path = NULL;
+	Uint64 seek_tick = 0;
+	bool fast = false;
+	const char* frame_csv_path = NULL;
+	bool frame_stats = false;
+	Uint32 tick_rate = SIM_DEFAULT_TICK_RATE;
+	bool mirror = false;
+	int render_threads = 0;
+	const char* mesh_path = NULL;
+	int mesh_lod = 0;
+	const char* save_mesh_path = NULL;
+	const char* dump_frames_path = NULL;
+	bool frame_crc = false;
+	const char* present_mode = NULL;
+	int frames_in_flight = 0;
+	Uint32 wall_games = 0;
+	Uint16 versus_port = 0;
+	const char* versus_peer = NULL;
+	Uint32 rewind_memory_mb = REWIND_DEFAULT_MEMORY_MB;
 	for (int i = 1; i < argc;) {
 		int consumed;
 
 		consumed = SDLTest_CommonArg(appstate->state, i);
 		if (consumed == 0) {
 			if (SDL_strcasecmp(argv[i], "--msaa") == 0) {
-				++msaa;
+				/* The sample count may follow, 4 if it does not */
+				int samples = i + 1 < argc ? SDL_atoi(argv[i + 1]) : 0;
+				bool given = samples == 2 || samples == 4 || samples == 8;
+				msaa = given ? samples : 4;
+				consumed = given ? 2 : 1;
+			}
+			else if (SDL_strcasecmp(argv[i], "--msaa-blit") == 0) {
+				msaa_blit = true;
+				consumed = 1;
+			}
+			else if (SDL_strcasecmp(argv[i], "--record") == 0 && i + 1 < argc) {
+				record_path = argv[i + 1];
+				consumed = 2;
+			}
+			else if (SDL_strcasecmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+				replay_path = argv[i + 1];
+				consumed = 2;
+			}
+			else if (SDL_strcasecmp(argv[i], "--seek") == 0 && i + 1 < argc) {
+				seek_tick = SDL_strtoull(argv[i + 1], NULL, 0);
+				consumed = 2;
+			}
+			else if (SDL_strcasecmp(argv[i], "--fast") == 0) {
+				fast = true;
+				consumed = 1;
+			}
+			else if (SDL_strcasecmp(argv[i], "--frame-stats") == 0) {
+				frame_stats = true;
 				consumed = 1;
 			}
+			else if (SDL_strcasecmp(argv[i], "--frame-csv") == 0 && i + 1 < argc) {
+				frame_csv_path = argv[i + 1];
+				consumed = 2;
+			}
+			else if (SDL_strcasecmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+				tick_rate = (Uint32)SDL_strtoul(argv[i + 1], NULL, 0);
+				consumed = 2;
+			}
+			else if (SDL_strcasecmp(argv[i], "--one-submit") == 0) {
+				appstate->one_submit = true;
+				consumed = 1;
+			}
+			else if (SDL_strcasecmp(argv[i], "--mirror") == 0) {
+				appstate->one_submit = true;
+				mirror = true;
+				consumed = 1;
+			}
+			else if (SDL_strcasecmp(argv[i], "--render-threads") == 0 && i + 1 < argc) {
+				appstate->one_submit = true;
+				render_threads = SDL_atoi(argv[i + 1]);
+				consumed = 2;
+			}
+			else if (SDL_strcasecmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+				mesh_path = argv[i + 1];
+				consumed = 2;
+			}
+			else if (SDL_strcasecmp(argv[i], "--mesh-lod") == 0 && i + 1 < argc) {
+				mesh_lod = SDL_atoi(argv[i + 1]);
+				consumed = 2;
+			}
+			else if (SDL_strcasecmp(argv[i], "--save-mesh") == 0 && i + 1 < argc) {
+				save_mesh_path = argv[i + 1];
+				consumed = 2;
+			}
+			else if (SDL_strcasecmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+				appstate->headless_frames = SDL_strtoull(argv[i + 1], NULL, 0);
+				consumed = appstate->headless_frames > 0 ? 2 : -1;
+			}
+			else if (SDL_strcasecmp(argv[i], "--dump-frames") == 0 && i + 1 < argc) {
+				dump_frames_path = argv[i + 1];
+				consumed = 2;
+			}
+			else if (SDL_strcasecmp(argv[i], "--frame-crc") == 0) {
+				frame_crc = true;
+				consumed = 1;
+			}
+			else if (SDL_strcasecmp(argv[i], "--present-mode") == 0 && i + 1 < argc) {
+				present_mode = argv[i + 1];
+				consumed = 2;
+			}
+			else if (SDL_strcasecmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+				frames_in_flight = SDL_atoi(argv[i + 1]);
+				consumed = frames_in_flight >= 1 && frames_in_flight <= 3 ? 2 : -1;
+			}
+			else if (SDL_strcasecmp(argv[i], "--wall") == 0 && i + 1 < argc) {
+				wall_games = (Uint32)SDL_strtoul(argv[i + 1], NULL, 0);
+				consumed = wall_games > 0 ? 2 : -1;
+			}
+			else if (SDL_strcasecmp(argv[i], "--versus") == 0 && i + 2 < argc) {
+				versus_port = (Uint16)SDL_strtoul(argv[i + 1], NULL, 0);
+				versus_peer = argv[i + 2];
+				consumed = SDL_strrchr(versus_peer, ':') ? 3 : -1;
+			}
+			else if (SDL_strcasecmp(argv[i], "--rewind-memory") == 0 && i + 1 < argc) {
+				rewind_memory_mb = (Uint32)SDL_strtoul(argv[i + 1], NULL, 0);
+				consumed = rewind_memory_mb <= 1024 ? 2 : -1;
+			}
 			else {
 				consumed = -1;
 			}
 		}
 		if (consumed < 0) {
-			static const char* options[] = { "[--msaa]", NULL };
+			static const char* options[] = { "[--msaa [2|4|8]] [--msaa-blit]", "[--record file]", "[--replay file [--seek tick | --fast]]", "[--frame-stats]", "[--frame-csv file]", "[--tick-rate hz]", "[--one-submit [--mirror] [--render-threads n]]", "[--mesh file] [--mesh-lod n]", "[--save-mesh file]", "[--headless frames [--dump-frames pattern] [--frame-crc]]", "[--present-mode vsync|mailbox|immediate]", "[--frames-in-flight 1-3]", "[--wall games]", "[--versus port host:port]", "[--rewind-memory MB]", NULL };
 			SDLTest_CommonLogUsage(appstate->state, argv[0], options);
 			return SDL_APP_FAILURE;
 		}
 		i += consumed;
 	}
 
+	SDL_GPUPresentMode gpu_present_mode = SDL_GPU_PRESENTMODE_VSYNC;
+	if (present_mode)
+	{
+		if (SDL_strcasecmp(present_mode, "mailbox") == 0)
+		{
+			gpu_present_mode = SDL_GPU_PRESENTMODE_MAILBOX;
+		}
+		else if (SDL_strcasecmp(present_mode, "immediate") == 0)
+		{
+			gpu_present_mode = SDL_GPU_PRESENTMODE_IMMEDIATE;
+		}
+		else if (SDL_strcasecmp(present_mode, "vsync") != 0)
+		{
+			SDL_Log("Unknown present mode %s, expected vsync, mailbox or immediate", present_mode);
+			return SDL_APP_FAILURE;
+		}
+	}
+
+	/* --save-mesh writes out the built-in mesh, a starting point for new ones, and quits */
+	if (save_mesh_path)
+	{
+		Mesh* mesh = mesh_create_builtin();
+		bool saved = mesh && mesh_save(mesh, save_mesh_path);
+		mesh_close(mesh);
+		if (!saved)
+		{
+			SDL_Log("Failed to save the mesh to %s: %s", save_mesh_path, SDL_GetError());
+			return SDL_APP_FAILURE;
+		}
+		return SDL_APP_SUCCESS;
+	}
+
 	appstate->state->skip_renderer = 1;
 	appstate->state->window_flags |= SDL_WINDOW_RESIZABLE;
 	appstate->state->window_w = 200 + 20;
 	appstate->state->window_h = 440 + 20;
+	if (wall_games > 0) {
+		appstate->state->window_w = 1280;
+		appstate->state->window_h = 720;
+	}
+	else if (versus_peer) {
+		appstate->state->window_w = 2 * (200 + 20);
+	}
+	if (appstate->headless_frames > 0) {
+		appstate->state->window_flags |= SDL_WINDOW_HIDDEN;
+	}
 
 	if (!SDLTest_CommonInit(appstate->state)) {
 		SDL_assert_always(!"SDLTest_CommonInit failed to init test framework");
 		return SDL_APP_FAILURE;
 	}
+	startup_mark("video and windows up");
 
 	appstate->tetris = SDL_calloc(1, sizeof(Tetris));
 	if (!appstate->tetris)
@@ -949,37 +662,201 @@ SDL_AppResult SDL_AppInit(void** appstate_out, int argc, char* argv[])
 		return SDL_APP_FAILURE;
 	}
 
-	return init_render_state(appstate, msaa);
-}
+	if (replay_path)
+	{
+		appstate->replay = replay_open(replay_path);
+		if (!appstate->replay)
+		{
+			SDL_Log("Failed to open replay %s: %s", replay_path, SDL_GetError());
+			return SDL_APP_FAILURE;
+		}
 
-static void shutdownGPU(AppState* appstate)
-{
-	if (appstate->window_states) {
-		int i;
-		for (i = 0; i < appstate->state->num_windows; i++) {
-			WindowState* winstate = &appstate->window_states[i];
-			SDL_ReleaseGPUTexture(appstate->gpu_device, winstate->tex_depth);
-			SDL_ReleaseGPUTexture(appstate->gpu_device, winstate->tex_msaa);
-			SDL_ReleaseGPUTexture(appstate->gpu_device, winstate->tex_resolve);
-			SDL_ReleaseWindowFromGPUDevice(appstate->gpu_device, appstate->state->windows[i]);
+		/* --fast re-simulates the whole game up front, checking every keyframe, and shows where it ended */
+		Uint64 start_ns = SDL_GetTicksNS();
+		Uint64 tick = fast ? replay_num_ticks(appstate->replay) : seek_tick;
+		bool ok = fast ? replay_simulate(appstate->replay, appstate->tetris) : true;
+		Uint64 elapsed_ns = SDL_GetTicksNS() - start_ns;
+		if (!ok || !replay_seek(appstate->replay, tick, appstate->tetris, &appstate->replay_cursor))
+		{
+			SDL_Log("Failed to play replay %s: %s", replay_path, SDL_GetError());
+			return SDL_APP_FAILURE;
+		}
+		if (fast)
+		{
+			SDL_Log("Replay %s: %" SDL_PRIu64 " ticks in %.3f ms, score %u, lines %u",
+				replay_path, tick, elapsed_ns / 1e6, appstate->tetris->score, appstate->tetris->lines);
 		}
-		SDL_free(appstate->window_states);
-		appstate->window_states = NULL;
 	}
 
-	SDL_ReleaseGPUBuffer(appstate->gpu_device, appstate->render_state.buf_vertex);
-	SDL_ReleaseGPUGraphicsPipeline(appstate->gpu_device, appstate->render_state.pipeline);
-	SDL_DestroyGPUDevice(appstate->gpu_device);
+	if (record_path)
+	{
+		appstate->recorder = replay_writer_open(record_path, REPLAY_DEFAULT_KEYFRAME_INTERVAL);
+		if (!appstate->recorder)
+		{
+			SDL_Log("Failed to create %s: %s", record_path, SDL_GetError());
+			return SDL_APP_FAILURE;
+		}
+	}
+
+	if (frame_stats || frame_csv_path)
+	{
+		appstate->frame_times = frametimes_create(frame_csv_path, frame_stats);
+		if (!appstate->frame_times)
+		{
+			SDL_Log("Failed to set up frame times: %s", SDL_GetError());
+			return SDL_APP_FAILURE;
+		}
+	}
+	startup_mark("game state, replay and frame times set up");
+
+	Mesh* mesh = NULL;
+	if (mesh_path)
+	{
+		mesh = mesh_open(mesh_path);
+		if (!mesh)
+		{
+			SDL_Log("Failed to open mesh %s: %s", mesh_path, SDL_GetError());
+			return SDL_APP_FAILURE;
+		}
+	}
+	if (appstate->headless_frames > 0)
+	{
+		appstate->renderer = renderer_create_headless(appstate->state->gpudriver, appstate->state->windows, appstate->state->num_windows, msaa, mesh, mesh_lod);
+	}
+	else
+	{
+		appstate->renderer = renderer_create(appstate->state->gpudriver, appstate->state->windows, appstate->state->num_windows, msaa, mesh, mesh_lod);
+	}
+	mesh_close(mesh);
+	if (!appstate->renderer)
+	{
+		return SDL_APP_FAILURE;
+	}
+	renderer_set_frame_times(appstate->renderer, appstate->frame_times);
+	renderer_set_mirrored(appstate->renderer, mirror);
+	if (msaa_blit)
+	{
+		renderer_set_msaa_blit(appstate->renderer, true);
+	}
+	renderer_set_frames_in_flight(appstate->renderer, frames_in_flight);
+	if (present_mode && !renderer_set_present_mode(appstate->renderer, gpu_present_mode))
+	{
+		SDL_Log("Keeping vsync: %s", SDL_GetError());
+	}
+	if (render_threads != 0 && !renderer_start_workers(appstate->renderer, render_threads))
+	{
+		SDL_Log("Failed to start render threads: %s", SDL_GetError());
+		return SDL_APP_FAILURE;
+	}
+
+	if (wall_games > 0)
+	{
+		appstate->wall = tetris_batch_create(wall_games, 0);
+		appstate->wall_boards = SDL_calloc(wall_games, sizeof(Tetris));
+		if (!appstate->wall || !appstate->wall_boards)
+		{
+			SDL_Log("Failed to set up a wall of %u games: %s", wall_games, SDL_GetError());
+			return SDL_APP_FAILURE;
+		}
+	}
 
-	SDL_zero(appstate->render_state);
-	appstate->gpu_device = NULL;
+	if (versus_peer)
+	{
+		/* host:port, IPv4 only */
+		char host[256];
+		const char* colon = SDL_strrchr(versus_peer, ':');
+		SDL_strlcpy(host, versus_peer, SDL_min(sizeof(host), (size_t)(colon - versus_peer) + 1));
+		NetAddress peer;
+		if (!net_resolve(host, (Uint16)SDL_strtoul(colon + 1, NULL, 0), &peer))
+		{
+			SDL_Log("Failed to find the versus peer %s: %s", versus_peer, SDL_GetError());
+			return SDL_APP_FAILURE;
+		}
+		appstate->net = net_open(versus_port);
+		appstate->versus = appstate->net ? versus_create(appstate->net, &peer) : NULL;
+		if (!appstate->versus)
+		{
+			SDL_Log("Failed to start versus on port %u: %s", (unsigned)versus_port, SDL_GetError());
+			return SDL_APP_FAILURE;
+		}
+		SDL_Log("Versus: waiting for %s on port %u", versus_peer, (unsigned)net_local_port(appstate->net));
+		appstate->versus_clock_ns = SDL_GetTicksNS();
+		appstate->versus_log_ns = appstate->versus_clock_ns;
+	}
+
+	if (appstate->headless_frames > 0)
+	{
+		/* Every frame shows the game; cleared ones would make runs differ */
+		if (!renderer_wait_ready(appstate->renderer))
+		{
+			return SDL_APP_FAILURE;
+		}
+		if (dump_frames_path || frame_crc)
+		{
+			appstate->frame_dump = framedump_create(dump_frames_path, frame_crc);
+			if (!appstate->frame_dump)
+			{
+				SDL_Log("Failed to set up frame dumps: %s", SDL_GetError());
+				return SDL_APP_FAILURE;
+			}
+			renderer_set_frame_callback(appstate->renderer, framedump_frame, appstate->frame_dump);
+		}
+		appstate->headless_start_ns = SDL_GetTicksNS();
+		return SDL_APP_CONTINUE;
+	}
+	if (appstate->wall || appstate->versus)
+	{
+		/* Those games step on the main thread, there is no game of keys to run */
+		return SDL_APP_CONTINUE;
+	}
+
+	/* Left out of recordings and replays, which must hold every tick as played */
+	if (rewind_memory_mb > 0 && !appstate->recorder && !appstate->replay)
+	{
+		appstate->rewind = rewind_create(rewind_memory_mb * 1024 * 1024, REWIND_DEFAULT_KEYFRAME_INTERVAL);
+		if (!appstate->rewind)
+		{
+			SDL_Log("Failed to set up rewind: %s", SDL_GetError());
+			return SDL_APP_FAILURE;
+		}
+	}
+
+	appstate->sim = sim_create(appstate->tetris, tick_rate, sim_step, appstate);
+	if (!appstate->sim)
+	{
+		SDL_Log("Failed to start the sim thread: %s", SDL_GetError());
+		return SDL_APP_FAILURE;
+	}
+	startup_mark("sim thread started");
+	return SDL_APP_CONTINUE;
 }
 
 void SDL_AppQuit(void* appstate_ptr)
 {
 	AppState* appstate = appstate_ptr;
-	shutdownGPU(appstate);
+	sim_destroy(appstate->sim);
+	if (appstate->rewind)
+	{
+		log_rewind(appstate->rewind);
+	}
+	rewind_destroy(appstate->rewind);
+	renderer_destroy(appstate->renderer);
+	framedump_destroy(appstate->frame_dump);
+	frametimes_destroy(appstate->frame_times);
+	if (appstate->recorder && !replay_writer_close(appstate->recorder))
+	{
+		SDL_Log("Failed to save recording: %s", SDL_GetError());
+	}
+	replay_close(appstate->replay);
 	SDLTest_CommonQuit(appstate->state);
+	if (appstate->versus)
+	{
+		log_versus(appstate->versus);
+	}
+	versus_destroy(appstate->versus);
+	net_close(appstate->net);
+	tetris_batch_destroy(appstate->wall);
+	SDL_free(appstate->wall_boards);
 	SDL_free(appstate->tetris);
 	SDL_free(appstate);
 }
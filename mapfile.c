@@ -0,0 +1,99 @@
+#include "mapfile.h"
+
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_iostream.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPFILE_MMAP 1
+#endif
+
+bool
+mapped_file_open(MappedFile* file, const char* path)
+{
+#if defined(_WIN32)
+	file->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file->file == INVALID_HANDLE_VALUE)
+	{
+		file->file = NULL;
+		SDL_SetError("Couldn't open %s", path);
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file->file, &size) || size.QuadPart == 0)
+	{
+		SDL_SetError("Couldn't get the size of %s", path);
+		return false;
+	}
+	file->mapping = CreateFileMappingA(file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	file->data = file->mapping ? MapViewOfFile(file->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if (!file->data)
+	{
+		SDL_SetError("Couldn't map %s", path);
+		return false;
+	}
+	file->size = (size_t)size.QuadPart;
+	return true;
+#elif defined(MAPFILE_MMAP)
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		SDL_SetError("Couldn't open %s", path);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		SDL_SetError("Couldn't get the size of %s", path);
+		return false;
+	}
+	void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		SDL_SetError("Couldn't map %s", path);
+		return false;
+	}
+	file->data = data;
+	file->size = (size_t)st.st_size;
+	return true;
+#else
+	file->loaded = SDL_LoadFile(path, &file->size);
+	file->data = file->loaded;
+	return file->loaded != NULL;
+#endif
+}
+
+void
+mapped_file_close(MappedFile* file)
+{
+#if defined(_WIN32)
+	if (file->data)
+	{
+		UnmapViewOfFile(file->data);
+	}
+	if (file->mapping)
+	{
+		CloseHandle(file->mapping);
+	}
+	if (file->file)
+	{
+		CloseHandle(file->file);
+	}
+#elif defined(MAPFILE_MMAP)
+	if (file->data)
+	{
+		munmap((void*)file->data, file->size);
+	}
+#else
+	SDL_free(file->loaded);
+#endif
+	SDL_zerop(file);
+}
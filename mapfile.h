@@ -0,0 +1,27 @@
+/*
+ * Read-only view of a whole file: memory mapped where the platform allows,
+ * read into memory otherwise. Used for replays and mesh assets, which are
+ * laid out to be read in place.
+ */
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <SDL3/SDL_stdinc.h>
+
+typedef struct MappedFile
+{
+	const Uint8* data;
+	size_t size;
+
+	/* Platform handles */
+	void* file;
+	void* mapping;
+	void* loaded;
+} MappedFile;
+
+/* Fills in file, which may be closed again after a failure. Returns false on failure, see SDL_GetError. */
+bool mapped_file_open(MappedFile* file, const char* path);
+
+void mapped_file_close(MappedFile* file);
+
+#endif /* MAPFILE_H */
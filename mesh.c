@@ -0,0 +1,529 @@
+#include "mesh.h"
+#include "mapfile.h"
+
+#include <SDL3/SDL_endian.h>
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_iostream.h>
+
+#define MESH_MAGIC 0x48534D54u /* "TMSH" */
+#define MESH_VERSION 1
+
+#define MESH_HEADER_SIZE 16
+#define MESH_LOD_SIZE 16
+
+/* Edges of the built-in bevelled cube are cut back this far from each face */
+#define MESH_BEVEL 0.08f
+
+struct Mesh
+{
+	MappedFile file;
+	Uint8* built; /* mesh_create_builtin's file image */
+	const Uint8* data;
+	size_t size;
+};
+
+static Uint16
+get_u16(const Uint8* in)
+{
+	Uint16 value;
+	SDL_memcpy(&value, in, 2);
+	return SDL_Swap16LE(value);
+}
+
+static Uint32
+get_u32(const Uint8* in)
+{
+	Uint32 value;
+	SDL_memcpy(&value, in, 4);
+	return SDL_Swap32LE(value);
+}
+
+static float
+get_float(const Uint8* in)
+{
+	float value;
+	SDL_memcpy(&value, in, 4);
+	return SDL_SwapFloatLE(value);
+}
+
+static void
+put_u16(Uint8* out, Uint16 value)
+{
+	value = SDL_Swap16LE(value);
+	SDL_memcpy(out, &value, 2);
+}
+
+static void
+put_u32(Uint8* out, Uint32 value)
+{
+	value = SDL_Swap32LE(value);
+	SDL_memcpy(out, &value, 4);
+}
+
+/* Rounds to nearest; too small becomes 0, too large infinity */
+static Uint16
+float_to_half(float value)
+{
+	Uint32 bits;
+	SDL_memcpy(&bits, &value, 4);
+	Uint32 sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+	Uint32 mantissa = bits & 0x7FFFFF;
+	if (exponent <= 0)
+	{
+		return (Uint16)sign;
+	}
+	if (exponent >= 31)
+	{
+		return (Uint16)(sign | 0x7C00);
+	}
+	/* A carry out of the mantissa correctly bumps the exponent */
+	return (Uint16)((sign | ((Uint32)exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+}
+
+static float
+half_to_float(Uint16 half)
+{
+	Uint32 sign = (Uint32)(half & 0x8000) << 16;
+	Uint32 exponent = (half >> 10) & 0x1F;
+	Uint32 mantissa = half & 0x3FF;
+	Uint32 bits;
+	if (exponent == 0)
+	{
+		/* Zero or subnormal */
+		float value = (float)mantissa / (1 << 24);
+		return sign ? -value : value;
+	}
+	if (exponent == 31)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+	float value;
+	SDL_memcpy(&value, &bits, 4);
+	return value;
+}
+
+Uint32
+mesh_format_size(MeshFormat format)
+{
+	switch (format)
+	{
+	case MESH_FORMAT_FLOAT3: return 12;
+	case MESH_FORMAT_HALF4: return 8;
+	case MESH_FORMAT_BYTE4_NORM: return 4;
+	case MESH_FORMAT_UBYTE4_NORM: return 4;
+	default: return 0;
+	}
+}
+
+SDL_GPUVertexElementFormat
+mesh_format_to_gpu(MeshFormat format)
+{
+	switch (format)
+	{
+	case MESH_FORMAT_FLOAT3: return SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3;
+	case MESH_FORMAT_HALF4: return SDL_GPU_VERTEXELEMENTFORMAT_HALF4;
+	case MESH_FORMAT_BYTE4_NORM: return SDL_GPU_VERTEXELEMENTFORMAT_BYTE4_NORM;
+	case MESH_FORMAT_UBYTE4_NORM: return SDL_GPU_VERTEXELEMENTFORMAT_UBYTE4_NORM;
+	default: return SDL_GPU_VERTEXELEMENTFORMAT_INVALID;
+	}
+}
+
+void
+mesh_encode(MeshFormat format, const float value[3], Uint8* out)
+{
+	switch (format)
+	{
+	case MESH_FORMAT_FLOAT3:
+		SDL_memcpy(out, value, 12);
+		break;
+	case MESH_FORMAT_HALF4:
+	{
+		Uint16 halves[4] = { float_to_half(value[0]), float_to_half(value[1]), float_to_half(value[2]), 0x3C00 };
+		SDL_memcpy(out, halves, 8);
+		break;
+	}
+	case MESH_FORMAT_BYTE4_NORM:
+		for (int i = 0; i < 3; ++i)
+		{
+			float v = SDL_clamp(value[i], -1.0f, 1.0f) * 127.0f;
+			out[i] = (Uint8)(Sint8)(v < 0.0f ? v - 0.5f : v + 0.5f);
+		}
+		out[3] = 127;
+		break;
+	case MESH_FORMAT_UBYTE4_NORM:
+		for (int i = 0; i < 3; ++i)
+		{
+			out[i] = (Uint8)(SDL_clamp(value[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+		out[3] = 255;
+		break;
+	}
+}
+
+/* Reads one attribute as stored in a file, little endian */
+static void
+decode(MeshFormat format, float scale, const Uint8* in, float out[3])
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		switch (format)
+		{
+		case MESH_FORMAT_FLOAT3: out[i] = get_float(in + i * 4); break;
+		case MESH_FORMAT_HALF4: out[i] = half_to_float(get_u16(in + i * 2)); break;
+		case MESH_FORMAT_BYTE4_NORM: out[i] = SDL_max((Sint8)in[i] / 127.0f, -1.0f) * scale; break;
+		case MESH_FORMAT_UBYTE4_NORM: out[i] = in[i] / 255.0f; break;
+		}
+	}
+}
+
+/* Checks everything the accessors rely on, so they need no checks of their own */
+static bool
+validate(const Uint8* data, size_t size)
+{
+	if (size < MESH_HEADER_SIZE || get_u32(data) != MESH_MAGIC)
+	{
+		return SDL_SetError("Not a mesh file");
+	}
+	if (get_u32(data + 4) != MESH_VERSION)
+	{
+		return SDL_SetError("Mesh file version %u is not supported", get_u32(data + 4));
+	}
+
+	MeshFormat position_format = (MeshFormat)data[8];
+	MeshFormat color_format = (MeshFormat)data[9];
+	int num_lods = data[10];
+	if (position_format < MESH_FORMAT_FLOAT3 || position_format > MESH_FORMAT_BYTE4_NORM ||
+		(color_format != MESH_FORMAT_FLOAT3 && color_format != MESH_FORMAT_HALF4 && color_format != MESH_FORMAT_UBYTE4_NORM))
+	{
+		return SDL_SetError("Mesh file has unknown vertex formats %d, %d", position_format, color_format);
+	}
+	if (num_lods < 1 || num_lods > MESH_MAX_LODS || size < MESH_HEADER_SIZE + (size_t)num_lods * MESH_LOD_SIZE)
+	{
+		return SDL_SetError("Mesh file has a broken LOD table");
+	}
+
+	for (int lod = 0; lod < num_lods; ++lod)
+	{
+		const Uint8* entry = data + MESH_HEADER_SIZE + lod * MESH_LOD_SIZE;
+		Uint32 num_vertices = get_u16(entry);
+		Uint32 num_indices = get_u16(entry + 2);
+		Uint32 offsets[3] = { get_u32(entry + 4), get_u32(entry + 8), get_u32(entry + 12) };
+		Uint32 sizes[3] = {
+			num_vertices * mesh_format_size(position_format),
+			num_vertices * mesh_format_size(color_format),
+			num_indices * 2
+		};
+		if (num_vertices == 0 || num_vertices > MESH_MAX_VERTICES || num_indices == 0 ||
+			num_indices > MESH_MAX_INDICES || num_indices % 3 != 0)
+		{
+			return SDL_SetError("Mesh LOD %d has %u vertices and %u indices, at most %d and %d in triangles",
+				lod, num_vertices, num_indices, MESH_MAX_VERTICES, MESH_MAX_INDICES);
+		}
+		for (int i = 0; i < 3; ++i)
+		{
+			if (offsets[i] % 4 != 0 || offsets[i] > size || sizes[i] > size - offsets[i])
+			{
+				return SDL_SetError("Mesh LOD %d points outside the file", lod);
+			}
+		}
+		for (Uint32 i = 0; i < num_indices; ++i)
+		{
+			if (get_u16(data + offsets[2] + i * 2) >= num_vertices)
+			{
+				return SDL_SetError("Mesh LOD %d has an index out of range", lod);
+			}
+		}
+	}
+	return true;
+}
+
+Mesh*
+mesh_open(const char* path)
+{
+	Mesh* mesh = SDL_calloc(1, sizeof(Mesh));
+	if (!mesh)
+	{
+		return NULL;
+	}
+	if (!mapped_file_open(&mesh->file, path))
+	{
+		mesh_close(mesh);
+		return NULL;
+	}
+	mesh->data = mesh->file.data;
+	mesh->size = mesh->file.size;
+	if (!validate(mesh->data, mesh->size))
+	{
+		SDL_SetError("%s: %s", path, SDL_GetError());
+		mesh_close(mesh);
+		return NULL;
+	}
+	return mesh;
+}
+
+void
+mesh_close(Mesh* mesh)
+{
+	if (!mesh)
+	{
+		return;
+	}
+	mapped_file_close(&mesh->file);
+	SDL_free(mesh->built);
+	SDL_free(mesh);
+}
+
+bool
+mesh_save(const Mesh* mesh, const char* path)
+{
+	SDL_IOStream* io = SDL_IOFromFile(path, "wb");
+	if (!io)
+	{
+		return false;
+	}
+	bool written = SDL_WriteIO(io, mesh->data, mesh->size) == mesh->size;
+	return SDL_CloseIO(io) && written;
+}
+
+MeshFormat
+mesh_position_format(const Mesh* mesh)
+{
+	return (MeshFormat)mesh->data[8];
+}
+
+MeshFormat
+mesh_color_format(const Mesh* mesh)
+{
+	return (MeshFormat)mesh->data[9];
+}
+
+int
+mesh_num_lods(const Mesh* mesh)
+{
+	return mesh->data[10];
+}
+
+void
+mesh_get_lod(const Mesh* mesh, int lod, MeshLod* out)
+{
+	MeshFormat position_format = mesh_position_format(mesh);
+	MeshFormat color_format = mesh_color_format(mesh);
+	float scale = get_float(mesh->data + 12);
+	Uint32 position_size = mesh_format_size(position_format);
+	Uint32 color_size = mesh_format_size(color_format);
+
+	lod = SDL_clamp(lod, 0, mesh_num_lods(mesh) - 1);
+	const Uint8* entry = mesh->data + MESH_HEADER_SIZE + lod * MESH_LOD_SIZE;
+	out->num_vertices = get_u16(entry);
+	out->num_indices = get_u16(entry + 2);
+	const Uint8* positions = mesh->data + get_u32(entry + 4);
+	const Uint8* colors = mesh->data + get_u32(entry + 8);
+	const Uint8* indices = mesh->data + get_u32(entry + 12);
+	for (Uint32 i = 0; i < out->num_vertices; ++i)
+	{
+		decode(position_format, scale, positions + i * position_size, out->positions[i]);
+		decode(color_format, 1.0f, colors + i * color_size, out->colors[i]);
+	}
+	for (Uint32 i = 0; i < out->num_indices; ++i)
+	{
+		out->indices[i] = get_u16(indices + i * 2);
+	}
+}
+
+/*
+ * Built-in meshes. Both are shaded lighter towards the top right, 0.5 to
+ * 1.0 by which side of the centre a vertex is on.
+ */
+
+/* Plain cube corners, indexed by bit 0 = +x, bit 1 = +y, bit 2 = +z */
+static const Uint16 cube_indices[36] = {
+	2, 1, 0,  2, 3, 1, /* Front face */
+	6, 0, 4,  6, 2, 0, /* Left face */
+	6, 3, 2,  6, 7, 3, /* Top face */
+	3, 5, 1,  3, 7, 5, /* Right face */
+	7, 4, 5,  7, 6, 4, /* Back face */
+	0, 5, 4,  0, 1, 5  /* Bottom face */
+};
+
+/*
+ * Bevelled cube vertex on the face across axis, for the corner on the
+ * sides given by signs (bit n set for +n). Each face has 4 vertices, k
+ * numbering them by the signs of the two other axes.
+ */
+static Uint16
+bevel_vertex(int axis, int signs)
+{
+	int u = axis == 0 ? 1 : 0;
+	int v = axis == 2 ? 1 : 2;
+	int face = axis * 2 + ((signs >> axis) & 1);
+	int k = ((signs >> u) & 1) | (((signs >> v) & 1) << 1);
+	return (Uint16)(face * 4 + k);
+}
+
+typedef struct BuiltinLod
+{
+	Uint32 num_vertices;
+	Uint32 num_indices;
+	float positions[MESH_MAX_VERTICES][3];
+	Uint16 indices[MESH_MAX_INDICES];
+} BuiltinLod;
+
+static void
+build_bevelled_cube(BuiltinLod* lod)
+{
+	float inner = 0.5f - MESH_BEVEL;
+	lod->num_vertices = 24;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (int signs = 0; signs < 8; ++signs)
+		{
+			float* position = lod->positions[bevel_vertex(axis, signs)];
+			for (int i = 0; i < 3; ++i)
+			{
+				float extent = i == axis ? 0.5f : inner;
+				position[i] = (signs >> i) & 1 ? extent : -extent;
+			}
+		}
+	}
+
+	Uint16* out = lod->indices;
+	/* Faces */
+	for (int face = 0; face < 6; ++face)
+	{
+		Uint16 base = (Uint16)(face * 4);
+		Uint16 quad[6] = { base, base + 1, base + 3, base, base + 3, base + 2 };
+		SDL_memcpy(out, quad, sizeof(quad));
+		out += 6;
+	}
+	/* Edges, where two faces meet along the third axis */
+	for (int a1 = 0; a1 < 3; ++a1)
+	{
+		for (int a2 = a1 + 1; a2 < 3; ++a2)
+		{
+			int w = 3 - a1 - a2;
+			for (int sides = 0; sides < 4; ++sides)
+			{
+				int signs = ((sides & 1) << a1) | ((sides >> 1) << a2);
+				Uint16 p0 = bevel_vertex(a1, signs), p1 = bevel_vertex(a2, signs);
+				Uint16 q0 = bevel_vertex(a1, signs | (1 << w)), q1 = bevel_vertex(a2, signs | (1 << w));
+				Uint16 quad[6] = { p0, q0, q1, p0, q1, p1 };
+				SDL_memcpy(out, quad, sizeof(quad));
+				out += 6;
+			}
+		}
+	}
+	/* Corners */
+	for (int signs = 0; signs < 8; ++signs)
+	{
+		*out++ = bevel_vertex(0, signs);
+		*out++ = bevel_vertex(1, signs);
+		*out++ = bevel_vertex(2, signs);
+	}
+	lod->num_indices = (Uint32)(out - lod->indices);
+
+	/* Wind every triangle like the plain cube's, facing away from the centre */
+	for (Uint32 i = 0; i < lod->num_indices; i += 3)
+	{
+		const float* p0 = lod->positions[lod->indices[i]];
+		const float* p1 = lod->positions[lod->indices[i + 1]];
+		const float* p2 = lod->positions[lod->indices[i + 2]];
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		if (normal[0] * (p0[0] + p1[0] + p2[0]) + normal[1] * (p0[1] + p1[1] + p2[1]) + normal[2] * (p0[2] + p1[2] + p2[2]) < 0.0f)
+		{
+			Uint16 swap = lod->indices[i + 1];
+			lod->indices[i + 1] = lod->indices[i + 2];
+			lod->indices[i + 2] = swap;
+		}
+	}
+}
+
+static void
+build_plain_cube(BuiltinLod* lod)
+{
+	lod->num_vertices = 8;
+	for (int i = 0; i < 8; ++i)
+	{
+		lod->positions[i][0] = i & 1 ? 0.5f : -0.5f;
+		lod->positions[i][1] = i & 2 ? 0.5f : -0.5f;
+		lod->positions[i][2] = i & 4 ? 0.5f : -0.5f;
+	}
+	lod->num_indices = SDL_arraysize(cube_indices);
+	SDL_memcpy(lod->indices, cube_indices, sizeof(cube_indices));
+}
+
+Mesh*
+mesh_create_builtin(void)
+{
+	static const MeshFormat position_format = MESH_FORMAT_HALF4;
+	static const MeshFormat color_format = MESH_FORMAT_UBYTE4_NORM;
+
+	BuiltinLod lods[2];
+	build_bevelled_cube(&lods[0]);
+	build_plain_cube(&lods[1]);
+
+	/* Lay the file out, each array 4-byte aligned */
+	Uint32 offsets[2][3];
+	Uint32 size = MESH_HEADER_SIZE + SDL_arraysize(lods) * MESH_LOD_SIZE;
+	for (int lod = 0; lod < (int)SDL_arraysize(lods); ++lod)
+	{
+		offsets[lod][0] = size;
+		size += lods[lod].num_vertices * mesh_format_size(position_format);
+		offsets[lod][1] = size;
+		size += lods[lod].num_vertices * mesh_format_size(color_format);
+		offsets[lod][2] = size;
+		size += (lods[lod].num_indices * 2 + 3) & ~3u;
+	}
+
+	Mesh* mesh = SDL_calloc(1, sizeof(Mesh));
+	Uint8* data = SDL_calloc(1, size);
+	if (!mesh || !data)
+	{
+		SDL_free(mesh);
+		SDL_free(data);
+		return NULL;
+	}
+
+	put_u32(data, MESH_MAGIC);
+	put_u32(data + 4, MESH_VERSION);
+	data[8] = (Uint8)position_format;
+	data[9] = (Uint8)color_format;
+	data[10] = (Uint8)SDL_arraysize(lods);
+	float scale = SDL_SwapFloatLE(1.0f);
+	SDL_memcpy(data + 12, &scale, 4);
+
+	for (int lod = 0; lod < (int)SDL_arraysize(lods); ++lod)
+	{
+		Uint8* entry = data + MESH_HEADER_SIZE + lod * MESH_LOD_SIZE;
+		put_u16(entry, (Uint16)lods[lod].num_vertices);
+		put_u16(entry + 2, (Uint16)lods[lod].num_indices);
+		put_u32(entry + 4, offsets[lod][0]);
+		put_u32(entry + 8, offsets[lod][1]);
+		put_u32(entry + 12, offsets[lod][2]);
+
+		for (Uint32 i = 0; i < lods[lod].num_vertices; ++i)
+		{
+			const float* position = lods[lod].positions[i];
+			float shade = 0.5f + (position[0] > 0.0f ? 0.25f : 0.0f) + (position[1] > 0.0f ? 0.25f : 0.0f);
+			float color[3] = { shade, shade, shade };
+			/* mesh_encode writes host byte order, little endian wherever SDL_gpu runs */
+			mesh_encode(position_format, position, data + offsets[lod][0] + i * mesh_format_size(position_format));
+			mesh_encode(color_format, color, data + offsets[lod][1] + i * mesh_format_size(color_format));
+		}
+		for (Uint32 i = 0; i < lods[lod].num_indices; ++i)
+		{
+			put_u16(data + offsets[lod][2] + i * 2, lods[lod].indices[i]);
+		}
+	}
+
+	mesh->built = data;
+	mesh->data = data;
+	mesh->size = size;
+	return mesh;
+}
@@ -0,0 +1,77 @@
+/*
+ * The cube drawn for each board cell, as an indexed triangle list in a
+ * small binary file that is memory mapped and read in place, so art can
+ * swap it without a rebuild. The header names the vertex formats, and the
+ * renderer lays out its GPU vertex buffers and pipeline the same way, so
+ * half positions and 8-bit colors halve the vertex bandwidth.
+ *
+ * File layout, little endian:
+ *   header: "TMSH", version (u32), position format, color format,
+ *           LOD count, 0 (u8 each), position scale (f32)
+ *   LODs:   vertex count, index count (u16 each), then the file offsets of
+ *           the positions, colors and indices (u32 each), most detailed first
+ *   data:   the arrays, each starting 4-byte aligned
+ *
+ * Positions are relative to the cell centre, within -0.5..0.5; BYTE4_NORM
+ * ones are multiplied by the position scale. Colors are multiplied with the
+ * piece color.
+ */
+#ifndef MESH_H
+#define MESH_H
+
+#include <SDL3/SDL_gpu.h>
+
+#define MESH_MAX_LODS 4
+#define MESH_MAX_VERTICES 32
+#define MESH_MAX_INDICES 192
+
+typedef enum MeshFormat
+{
+	MESH_FORMAT_FLOAT3 = 1,      /* 12 bytes */
+	MESH_FORMAT_HALF4 = 2,       /* 8 bytes, w is 1 */
+	MESH_FORMAT_BYTE4_NORM = 3,  /* 4 bytes, -1..1, positions only */
+	MESH_FORMAT_UBYTE4_NORM = 4  /* 4 bytes, 0..1, colors only */
+} MeshFormat;
+
+typedef struct Mesh Mesh;
+
+/* One level of detail, decoded */
+typedef struct MeshLod
+{
+	Uint32 num_vertices;
+	Uint32 num_indices;
+	float positions[MESH_MAX_VERTICES][3];
+	float colors[MESH_MAX_VERTICES][3];
+	Uint16 indices[MESH_MAX_INDICES];
+} MeshLod;
+
+/* Maps and checks a mesh file. Returns NULL on failure, see SDL_GetError. */
+Mesh* mesh_open(const char* path);
+
+/*
+ * The mesh used without a file: a bevelled cube, then the plain 8-vertex
+ * cube as the second LOD, with half positions and 8-bit colors.
+ */
+Mesh* mesh_create_builtin(void);
+
+void mesh_close(Mesh* mesh);
+
+/* Writes the mesh as a file mesh_open can read */
+bool mesh_save(const Mesh* mesh, const char* path);
+
+MeshFormat mesh_position_format(const Mesh* mesh);
+MeshFormat mesh_color_format(const Mesh* mesh);
+int mesh_num_lods(const Mesh* mesh);
+
+/* Decodes one level of detail, clamped to the ones there are */
+void mesh_get_lod(const Mesh* mesh, int lod, MeshLod* out);
+
+/* Bytes one attribute of the format takes */
+Uint32 mesh_format_size(MeshFormat format);
+
+SDL_GPUVertexElementFormat mesh_format_to_gpu(MeshFormat format);
+
+/* Writes value, clamped to the format's range, as one attribute */
+void mesh_encode(MeshFormat format, const float value[3], Uint8* out);
+
+#endif /* MESH_H */
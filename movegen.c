@@ -0,0 +1,238 @@
+#include "movegen.h"
+
+#include <string.h>
+
+/* Piece positions (x, y, rot) are numbered (rot * 22 + y) * 10 + x */
+#define MOVEGEN_STATES TETRIS_MAX_PLACEMENTS
+#define MOVEGEN_NONE 0xFFFF
+
+typedef struct MoveSearch
+{
+	uint64_t visited[(MOVEGEN_STATES + 63) / 64];
+	uint64_t placed[(MOVEGEN_STATES + 63) / 64];
+	uint16_t queue[MOVEGEN_STATES];
+	uint16_t parent[MOVEGEN_STATES];
+	uint8_t parent_key[MOVEGEN_STATES];
+	uint16_t landing[MOVEGEN_STATES]; /* where a drop from here locks, MOVEGEN_NONE if not known yet */
+
+	/* Lock positions in order of discovery, and the first position that drops onto them */
+	int num_placements;
+	uint16_t placements[MOVEGEN_STATES];
+	uint16_t drop_from[MOVEGEN_STATES];
+} MoveSearch;
+
+static const uint8_t movegen_keys[4] = {
+	TETRIS_INPUT_LEFT, TETRIS_INPUT_RIGHT, TETRIS_INPUT_ROTATE, TETRIS_INPUT_DOWN
+};
+
+static int
+state_index(const Tetris* tetris)
+{
+	return (tetris->rot * 22 + tetris->y) * 10 + tetris->x;
+}
+
+static void
+set_state(Tetris* tetris, int state)
+{
+	tetris->x = (uint8_t)(state % 10);
+	tetris->y = (uint8_t)(state / 10 % 22);
+	tetris->rot = (uint8_t)(state / 220);
+}
+
+static int
+test_bit(const uint64_t* bits, int i)
+{
+	return (bits[i >> 6] >> (i & 63)) & 1;
+}
+
+static void
+set_bit(uint64_t* bits, int i)
+{
+	bits[i >> 6] |= (uint64_t)1 << (i & 63);
+}
+
+/*
+ * Follows try_move(0, -1, 0) down from state and remembers the landing for
+ * every position passed, so each position is only tested once per search.
+ */
+static int
+find_landing(MoveSearch* search, Tetris* scratch, int state)
+{
+	uint16_t chain[22];
+	int length = 0;
+	int landing = state;
+
+	set_state(scratch, state);
+	for (;;)
+	{
+		if (search->landing[landing] != MOVEGEN_NONE)
+		{
+			landing = search->landing[landing];
+			break;
+		}
+		chain[length++] = (uint16_t)landing;
+		if (!try_move(scratch, 0, -1, 0))
+		{
+			break;
+		}
+		landing = state_index(scratch);
+	}
+
+	for (int i = 0; i < length; ++i)
+	{
+		search->landing[chain[i]] = (uint16_t)landing;
+	}
+	return landing;
+}
+
+/* Breadth first search over (x, y, rot) from the current piece position */
+static void
+search_placements(const Tetris* tetris, MoveSearch* search)
+{
+	Tetris scratch = *tetris;
+	int head = 0;
+	int tail = 0;
+
+	memset(search->visited, 0, sizeof(search->visited));
+	memset(search->placed, 0, sizeof(search->placed));
+	memset(search->landing, 0xFF, sizeof(search->landing));
+	search->num_placements = 0;
+
+	if (tetris->piece == 0)
+	{
+		return;
+	}
+
+	int start = state_index(tetris);
+	set_bit(search->visited, start);
+	search->parent[start] = MOVEGEN_NONE;
+	search->queue[tail++] = (uint16_t)start;
+
+	while (head < tail)
+	{
+		int state = search->queue[head++];
+
+		int landing = find_landing(search, &scratch, state);
+		if (!test_bit(search->placed, landing))
+		{
+			set_bit(search->placed, landing);
+			search->placements[search->num_placements] = (uint16_t)landing;
+			search->drop_from[search->num_placements] = (uint16_t)state;
+			search->num_placements += 1;
+		}
+
+		for (int i = 0; i < 4; ++i)
+		{
+			int moved;
+			set_state(&scratch, state);
+			switch (movegen_keys[i])
+			{
+			case TETRIS_INPUT_LEFT: moved = try_move(&scratch, -1, 0, 0); break;
+			case TETRIS_INPUT_RIGHT: moved = try_move(&scratch, 1, 0, 0); break;
+			case TETRIS_INPUT_ROTATE: moved = try_rotate(&scratch); break;
+			default: moved = try_move(&scratch, 0, -1, 0); break;
+			}
+
+			int next = state_index(&scratch);
+			if (moved && !test_bit(search->visited, next))
+			{
+				set_bit(search->visited, next);
+				search->parent[next] = (uint16_t)state;
+				search->parent_key[next] = movegen_keys[i];
+				search->queue[tail++] = (uint16_t)next;
+			}
+		}
+	}
+}
+
+/*
+ * Writes the shortest key sequence to placement i, reversed, by walking
+ * back to the start. Returns its length, 0 if it is longer than
+ * TETRIS_MAX_KEYS, which leaves the placement out.
+ */
+static int
+trace_keys(const MoveSearch* search, int i, uint8_t keys[TETRIS_MAX_KEYS])
+{
+	int num_keys = 0;
+	keys[num_keys++] = TETRIS_INPUT_DROP;
+	for (int state = search->drop_from[i]; search->parent[state] != MOVEGEN_NONE; state = search->parent[state])
+	{
+		if (num_keys == TETRIS_MAX_KEYS)
+		{
+			return 0;
+		}
+		keys[num_keys++] = search->parent_key[state];
+	}
+	return num_keys;
+}
+
+int
+tetris_generate_placements(const Tetris* tetris, TetrisPlacement* out, int max_out)
+{
+	MoveSearch search;
+	search_placements(tetris, &search);
+
+	int count = 0;
+	for (int i = 0; i < search.num_placements; ++i)
+	{
+		uint8_t keys[TETRIS_MAX_KEYS];
+		int num_keys = trace_keys(&search, i, keys);
+		if (num_keys == 0)
+		{
+			continue;
+		}
+
+		if (count < max_out)
+		{
+			TetrisPlacement* placement = &out[count];
+			Tetris position;
+			set_state(&position, search.placements[i]);
+			placement->x = position.x;
+			placement->y = position.y;
+			placement->rot = position.rot;
+			placement->num_keys = (uint8_t)num_keys;
+			for (int k = 0; k < num_keys; ++k)
+			{
+				placement->keys[k] = keys[num_keys - 1 - k];
+			}
+		}
+		count += 1;
+	}
+	return count;
+}
+
+uint64_t
+tetris_perft(const Tetris* tetris, int depth)
+{
+	if (depth == 0)
+	{
+		return 1;
+	}
+
+	MoveSearch search;
+	search_placements(tetris, &search);
+
+	uint64_t nodes = 0;
+	for (int i = 0; i < search.num_placements; ++i)
+	{
+		/* The same placements tetris_generate_placements gives */
+		uint8_t keys[TETRIS_MAX_KEYS];
+		if (trace_keys(&search, i, keys) == 0)
+		{
+			continue;
+		}
+		if (depth == 1)
+		{
+			nodes += 1;
+			continue;
+		}
+		Tetris child = *tetris;
+		set_state(&child, search.placements[i]);
+		glue(&child);
+		if (child.piece != 0)
+		{
+			nodes += tetris_perft(&child, depth - 1);
+		}
+	}
+	return nodes;
+}
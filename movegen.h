@@ -0,0 +1,49 @@
+/*
+ * Finds every place the current piece can lock, using the same moves as
+ * tetris_tick: left, right, rotate with its wall kicks, down and drop.
+ * Gravity is ignored, as if keys were always pressed faster than it.
+ */
+#ifndef MOVEGEN_H
+#define MOVEGEN_H
+
+#include "tetris.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Upper bound for the number of placements: every (x, y, rot) */
+#define TETRIS_MAX_PLACEMENTS (10 * 22 * 4)
+
+/* Placements that need longer key sequences than this are left out */
+#define TETRIS_MAX_KEYS 64
+
+typedef struct TetrisPlacement
+{
+	uint8_t x, y, rot; /* where the piece locks */
+	uint8_t num_keys;
+	/* TETRIS_INPUT_* presses from the current position, ending in TETRIS_INPUT_DROP */
+	uint8_t keys[TETRIS_MAX_KEYS];
+} TetrisPlacement;
+
+/*
+ * Writes up to max_out placements to out, each with its shortest key
+ * sequence, and returns how many there are in total, which may be more
+ * than max_out. Placements needing more than TETRIS_MAX_KEYS keys are
+ * left out of both. Returns 0 once the game is over.
+ */
+int tetris_generate_placements(const Tetris* tetris, TetrisPlacement* out, int max_out);
+
+/*
+ * Counts the sequences of depth placements of the pieces to come, like
+ * perft for chess move generators, over the placements
+ * tetris_generate_placements gives. A game over ends a sequence early and
+ * only counts at the last depth.
+ */
+uint64_t tetris_perft(const Tetris* tetris, int depth);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOVEGEN_H */
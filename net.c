@@ -0,0 +1,204 @@
+#include "net.h"
+
+#include <SDL3/SDL_error.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET NetHandle;
+#define NET_INVALID INVALID_SOCKET
+#define net_close_handle closesocket
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int NetHandle;
+#define NET_INVALID (-1)
+#define net_close_handle close
+#endif
+
+struct NetSocket
+{
+	NetHandle handle;
+};
+
+#if defined(_WIN32)
+/* One WSAStartup per open socket, balanced by net_close */
+static bool
+net_startup(void)
+{
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		SDL_SetError("WSAStartup failed");
+		return false;
+	}
+	return true;
+}
+#endif
+
+static void
+to_sockaddr(const NetAddress* address, struct sockaddr_in* out)
+{
+	SDL_zerop(out);
+	out->sin_family = AF_INET;
+	out->sin_addr.s_addr = htonl(address->host);
+	out->sin_port = htons(address->port);
+}
+
+bool
+net_resolve(const char* host, Uint16 port, NetAddress* address)
+{
+#if defined(_WIN32)
+	if (!net_startup())
+	{
+		return false;
+	}
+#endif
+	struct addrinfo hints;
+	struct addrinfo* found = NULL;
+	SDL_zero(hints);
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	int error = getaddrinfo(host, NULL, &hints, &found);
+	if (error == 0 && found)
+	{
+		const struct sockaddr_in* in = (const struct sockaddr_in*)found->ai_addr;
+		address->host = ntohl(in->sin_addr.s_addr);
+		address->port = port;
+		freeaddrinfo(found);
+	}
+	else
+	{
+		SDL_SetError("Couldn't resolve %s", host);
+	}
+#if defined(_WIN32)
+	WSACleanup();
+#endif
+	return error == 0;
+}
+
+/* Binds the socket and makes it non-blocking */
+static bool
+setup_socket(NetHandle handle, Uint16 port)
+{
+	NetAddress any = { 0, port };
+	struct sockaddr_in address;
+	to_sockaddr(&any, &address);
+	if (bind(handle, (const struct sockaddr*)&address, sizeof(address)) != 0)
+	{
+		SDL_SetError("Couldn't bind UDP port %u", (unsigned)port);
+		return false;
+	}
+
+#if defined(_WIN32)
+	u_long nonblocking = 1;
+	bool ok = ioctlsocket(handle, FIONBIO, &nonblocking) == 0;
+#else
+	int flags = fcntl(handle, F_GETFL, 0);
+	bool ok = flags >= 0 && fcntl(handle, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+	if (!ok)
+	{
+		SDL_SetError("Couldn't make the UDP socket non-blocking");
+	}
+	return ok;
+}
+
+NetSocket*
+net_open(Uint16 port)
+{
+#if defined(_WIN32)
+	if (!net_startup())
+	{
+		return NULL;
+	}
+#endif
+	NetHandle handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	NetSocket* sock = NULL;
+	if (handle == NET_INVALID)
+	{
+		SDL_SetError("Couldn't create a UDP socket");
+	}
+	else if (setup_socket(handle, port))
+	{
+		sock = SDL_malloc(sizeof(NetSocket));
+	}
+
+	if (!sock)
+	{
+		if (handle != NET_INVALID)
+		{
+			net_close_handle(handle);
+		}
+#if defined(_WIN32)
+		WSACleanup();
+#endif
+		return NULL;
+	}
+	sock->handle = handle;
+	return sock;
+}
+
+void
+net_close(NetSocket* sock)
+{
+	if (!sock)
+	{
+		return;
+	}
+	net_close_handle(sock->handle);
+	SDL_free(sock);
+#if defined(_WIN32)
+	WSACleanup();
+#endif
+}
+
+Uint16
+net_local_port(NetSocket* sock)
+{
+	struct sockaddr_in address;
+	socklen_t length = sizeof(address);
+	if (getsockname(sock->handle, (struct sockaddr*)&address, &length) != 0)
+	{
+		return 0;
+	}
+	return ntohs(address.sin_port);
+}
+
+bool
+net_send(NetSocket* sock, const NetAddress* to, const void* data, int size)
+{
+	struct sockaddr_in address;
+	to_sockaddr(to, &address);
+	return sendto(sock->handle, (const char*)data, size, 0, (const struct sockaddr*)&address, sizeof(address)) == size;
+}
+
+int
+net_receive(NetSocket* sock, void* buffer, int size, NetAddress* from)
+{
+	struct sockaddr_in address;
+	socklen_t length = sizeof(address);
+	for (;;)
+	{
+		int received = (int)recvfrom(sock->handle, (char*)buffer, size, 0, (struct sockaddr*)&address, &length);
+		if (received >= 0)
+		{
+			from->host = ntohl(address.sin_addr.s_addr);
+			from->port = ntohs(address.sin_port);
+			return received;
+		}
+#if defined(_WIN32)
+		/* A port unreachable reply to an earlier send, from a peer not up yet */
+		if (WSAGetLastError() == WSAECONNRESET)
+		{
+			continue;
+		}
+#endif
+		return -1;
+	}
+}
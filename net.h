@@ -0,0 +1,38 @@
+/*
+ * Non-blocking IPv4 UDP sockets, the little of them versus play needs.
+ * SDL has no networking of its own, so this wraps Winsock and BSD sockets.
+ */
+#ifndef NET_H
+#define NET_H
+
+#include <SDL3/SDL_stdinc.h>
+
+/* Largest datagram net_receive takes */
+#define NET_MAX_PACKET 512
+
+typedef struct NetSocket NetSocket;
+
+/* IPv4 address and port, in host byte order */
+typedef struct NetAddress
+{
+	Uint32 host;
+	Uint16 port;
+} NetAddress;
+
+/* Looks up a host name or dotted address. Returns false on failure, see SDL_GetError. */
+bool net_resolve(const char* host, Uint16 port, NetAddress* address);
+
+/* Binds a socket to port on every interface, 0 for any free one. Returns NULL on failure, see SDL_GetError. */
+NetSocket* net_open(Uint16 port);
+void net_close(NetSocket* socket);
+
+/* The port the socket is bound to */
+Uint16 net_local_port(NetSocket* socket);
+
+/* Sends one datagram. Returns false if it could not be queued. */
+bool net_send(NetSocket* socket, const NetAddress* to, const void* data, int size);
+
+/* Takes the next waiting datagram without blocking. Returns its size, or -1 if none is waiting. */
+int net_receive(NetSocket* socket, void* buffer, int size, NetAddress* from);
+
+#endif /* NET_H */
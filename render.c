@@ -0,0 +1,2065 @@
+#include <SDL3/SDL_assert.h>
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_video.h>
+
+#include "frametimes.h"
+#include "mesh.h"
+#include "render.h"
+#include "startup.h"
+#include "targetpool.h"
+#include "upload.h"
+#include "vecmath.h"
+
+/* Regenerate the shaders with testgpu/build-shaders.sh */
+#include "testgpu/testgpu_spirv.h"
+#include "testgpu/testgpu_dxbc.h"
+#include "testgpu/testgpu_dxil.h"
+#include "testgpu/testgpu_metallib.h"
+
+#define TESTGPU_SUPPORTED_FORMATS (SDL_GPU_SHADERFORMAT_SPIRV | SDL_GPU_SHADERFORMAT_DXBC | SDL_GPU_SHADERFORMAT_DXIL | SDL_GPU_SHADERFORMAT_METALLIB)
+
+/* Upload arena blocks; every frame in flight needs one, a resize or lock frame a second */
+#define UPLOAD_BLOCK_SIZE (64 * 1024)
+#define UPLOAD_BLOCKS 8
+
+/* Frames a window has to keep its size before its targets shrink to fit it */
+#define TARGET_SETTLE_FRAMES 30
+
+/* Headless color targets, laid out as the frames handed to the frame callback */
+#define HEADLESS_FORMAT SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM
+
+/* Headless frames being downloaded per window; the oldest is waited for when all are in flight */
+#define FRAME_DOWNLOADS 3
+
+#define CHECK_CREATE(var, thing) do { if (!(var)) { SDL_Log("Failed to create %s: %s\n", thing, SDL_GetError()); SDL_assert_always(0 && "CHECK_CREATE for " thing " var:" #var " failed"); } } while(0)
+
+typedef struct RenderState
+{
+	SDL_GPUBuffer* buf_vertex; /* cube vertices of the active piece, rewritten each frame, one slice per window */
+	SDL_GPUBuffer* buf_stack; /* cube vertices of the locked cells, one mesh per board cell, rewritten only where rows change */
+	SDL_GPUBuffer* buf_index; /* static, mesh indices for every cell slot */
+	SDL_GPUBuffer* buf_indirect; /* one indexed draw per run of locked cells in buf_stack, rewritten with it */
+	UploadArena* uploads; /* every upload after creation goes through here */
+	TargetPool* targets; /* depth, MSAA and resolve textures of every window */
+	SDL_GPUGraphicsPipeline* pipeline;
+	SDL_GPUSampleCount sample_count;
+	bool msaa_blit; /* resolve into tex_resolve and blit that to the swapchain, instead of resolving into it */
+} RenderState;
+
+/* One headless frame on its way back from the GPU */
+typedef struct FrameDownload
+{
+	SDL_GPUTransferBuffer* buffer;
+	Uint32 size; /* of buffer */
+	SDL_GPUFence* fence; /* NULL when not in flight */
+	Uint64 frame;
+	Uint32 width, height;
+} FrameDownload;
+
+typedef struct WindowState
+{
+	int angle_x, angle_y, angle_z;
+	SDL_GPUTexture* tex_depth, * tex_msaa, * tex_resolve; /* tex_resolve only with msaa_blit */
+	SDL_GPUTexture* tex_color; /* headless, drawn into instead of a swapchain texture */
+	Uint32 prev_drawablew, prev_drawableh;
+	Uint32 settled_frames; /* since the last size change, up to TARGET_SETTLE_FRAMES */
+	SDL_GPUTexture* swapchain; /* renderer_draw_all, NULL if not acquired this frame */
+
+	/* Headless frames with the game on them, and the ones being downloaded */
+	Uint64 frames;
+	FrameDownload downloads[FRAME_DOWNLOADS];
+	int next_download;
+} WindowState;
+
+/* Cell slots in the index buffer, enough for the whole board */
+#define MAX_BOARD_CELLS 220
+
+/* Runs of locked cells, at most every other cell */
+#define MAX_STACK_DRAWS ((MAX_BOARD_CELLS + 1) / 2)
+
+/* Cubes of the active piece and of its ghost, the landing preview */
+#define PIECE_CELLS 8
+
+/* piece_colors entry of the ghost */
+#define GHOST_COLOR 8
+
+/* Most frames renderer_set_frames_in_flight lets the GPU queue up */
+#define MAX_FRAMES_IN_FLIGHT 3
+
+/* Width over height of a wall board, as of the default window */
+#define WALL_BOARD_ASPECT (220.0f / 460.0f)
+
+/* Pixel height wall boards keep; when too many for the window, it scrolls */
+#define WALL_MIN_BOARD_HEIGHT 64
+
+/* Wall upload bytes per frame; the boards over it catch up next frame */
+#define WALL_UPLOAD_BUDGET (3 * UPLOAD_BLOCK_SIZE)
+
+/* BYTE4_NORM positions are stored divided by this, so the board fits in -1..1 */
+#define BYTE_POSITION_RANGE 16.0f
+
+/* A board's locked cells as its stack vertices have them, and how many rows from the bottom hold any */
+typedef struct BoardStack
+{
+	Uint8 board[MAX_BOARD_CELLS];
+	Uint32 rows;
+	Uint32 draws; /* indirect commands */
+	bool valid;
+} BoardStack;
+
+/* A board of the wall, as its buffers have it */
+typedef struct WallBoard
+{
+	BoardStack stack;
+	Uint8 piece, rot, x, y; /* where the piece vertices put it */
+	Uint32 num_cells;       /* of the piece and its ghost */
+	bool piece_valid;
+} WallBoard;
+
+/*
+ * renderer_draw_wall: every board has MAX_BOARD_CELLS cell slots of stack
+ * vertices, MAX_STACK_DRAWS commands and PIECE_CELLS piece slots of its
+ * own, made on the first call and again when there are more boards.
+ */
+typedef struct Wall
+{
+	SDL_GPUBuffer* buf_stacks;
+	SDL_GPUBuffer* buf_draws;
+	SDL_GPUBuffer* buf_pieces;
+	WallBoard* boards;
+	Uint32 max_boards;
+	Uint32 next_update; /* board the uploads start from, so all get a turn when over budget */
+	int first_row;      /* of the boards on screen, when not all fit */
+} Wall;
+
+/* Where the boards on screen go: one per viewport, row by row */
+typedef struct WallLayout
+{
+	Uint32 columns;
+	Uint32 first, end;     /* the boards on screen */
+	float x, y;            /* top left of the first one */
+	float board_w, board_h;
+} WallLayout;
+
+/* One cube to draw, worked out once per frame for every window */
+typedef struct BoardCell
+{
+	vec4 offset;
+	Uint8 piece;
+} BoardCell;
+
+/* One window's active piece vertices for renderer_draw_all to write */
+typedef struct VertexJob
+{
+	vec4 corners[MESH_MAX_VERTICES];
+	Uint8* out;
+} VertexJob;
+
+struct Renderer
+{
+	Uint32 frames;
+	SDL_GPUDevice* gpu_device;
+	RenderState render_state;
+	SDL_Window** windows;
+	int num_windows;
+	WindowState* window_states;
+	FrameTimes* frame_times;
+	bool mirrored;
+	Uint32 skipped_frames; /* no swapchain texture to draw into */
+
+	/* One fence per frame begun, oldest first, with renderer_set_frames_in_flight */
+	int frames_in_flight; /* 0 for no limit of our own */
+	SDL_GPUFence* frame_fences[MAX_FRAMES_IN_FLIGHT];
+	int num_frame_fences;
+
+	/* Headless renderers draw into textures of their own and can hand every frame back */
+	bool headless;
+	SDL_GPUTextureFormat target_format; /* of the swapchains or headless targets */
+	RendererFrameFunc frame_func;
+	void* frame_userdata;
+
+	/*
+	 * The cube drawn for every cell and how its vertices are laid out: the
+	 * position, then the color, in the mesh file's formats.
+	 */
+	MeshLod mesh;
+	MeshFormat position_format, color_format;
+	Uint32 vertex_size; /* bytes */
+	Uint32 cell_size; /* bytes of one cell's vertices */
+	float position_range; /* positions are written divided by this */
+
+	/* Shaders, pipeline and buffers are set up on the loader thread; frames are only cleared until then */
+	SDL_Thread* loader;
+	SDL_AtomicInt loaded; /* 1 when done, -1 on failure */
+	bool ready;
+
+	/* The locked cells in buf_stack and buf_indirect */
+	BoardStack stack;
+	bool direct_stack; /* draw every slot up to stack.rows instead, empty ones included */
+
+	Wall wall;
+
+	/* Current frame, read by the workers between start and done */
+	BoardCell cells[PIECE_CELLS];
+	Uint32 num_cells;
+	VertexJob* jobs; /* one per window */
+	int num_jobs;
+	SDL_AtomicInt next_job;
+
+	int num_workers;
+	SDL_Thread** workers;
+	SDL_Semaphore* start;
+	SDL_Semaphore* done;
+	SDL_AtomicInt quit;
+};
+
+static const float piece_colors[9][3] = {
+	{ 1.0, 1.0,  1.0 }, /* none */
+	{ 1.0, 0.5,  0.0 }, /* L orange */
+	{ 0.0, 0.3,  1.0 }, /* J blue */
+	{ 0.0, 0.85, 0.2 }, /* S green */
+	{ 1.0, 0.1,  0.1 }, /* Z red */
+	{ 0.7, 0.2,  1.0 }, /* T purple */
+	{ 1.0, 0.9,  0.0 }, /* O yellow */
+	{ 0.0, 0.9,  1.0 }, /* I cyan */
+	{ 0.3, 0.3,  0.3 }  /* ghost and garbage grey */
+};
+
+static void
+FitDepthTexture(Renderer* renderer, SDL_GPUTexture** texture, Uint32 drawablew, Uint32 drawableh, bool shrink)
+{
+	SDL_GPUTextureCreateInfo createinfo;
+	bool result;
+
+	RenderState* render_state = &renderer->render_state;
+
+	createinfo.type = SDL_GPU_TEXTURETYPE_2D;
+	createinfo.format = SDL_GPU_TEXTUREFORMAT_D16_UNORM;
+	createinfo.width = drawablew;
+	createinfo.height = drawableh;
+	createinfo.layer_count_or_depth = 1;
+	createinfo.num_levels = 1;
+	createinfo.sample_count = render_state->sample_count;
+	createinfo.usage = SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET;
+	createinfo.props = 0;
+
+	result = target_pool_fit(render_state->targets, texture, &createinfo, shrink);
+	CHECK_CREATE(result, "Depth Texture");
+}
+
+static void
+FitMSAATexture(Renderer* renderer, SDL_GPUTexture** texture, Uint32 drawablew, Uint32 drawableh, bool shrink)
+{
+	SDL_GPUTextureCreateInfo createinfo;
+	bool result;
+
+	RenderState* render_state = &renderer->render_state;
+
+	if (render_state->sample_count == SDL_GPU_SAMPLECOUNT_1) {
+		return;
+	}
+
+	createinfo.type = SDL_GPU_TEXTURETYPE_2D;
+	createinfo.format = renderer->target_format;
+	createinfo.width = drawablew;
+	createinfo.height = drawableh;
+	createinfo.layer_count_or_depth = 1;
+	createinfo.num_levels = 1;
+	createinfo.sample_count = render_state->sample_count;
+	createinfo.usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
+	createinfo.props = 0;
+
+	/* Resolving needs the same size on both ends, and a swapchain texture is always the window's */
+	if (renderer->headless || render_state->msaa_blit) {
+		result = target_pool_fit(render_state->targets, texture, &createinfo, shrink);
+	}
+	else {
+		result = target_pool_fit_exact(render_state->targets, texture, &createinfo);
+	}
+	CHECK_CREATE(result, "MSAA Texture");
+}
+
+static void
+FitResolveTexture(Renderer* renderer, SDL_GPUTexture** texture, Uint32 drawablew, Uint32 drawableh, bool shrink)
+{
+	SDL_GPUTextureCreateInfo createinfo;
+	bool result;
+
+	RenderState* render_state = &renderer->render_state;
+
+	if (render_state->sample_count == SDL_GPU_SAMPLECOUNT_1 || !render_state->msaa_blit) {
+		return;
+	}
+
+	createinfo.type = SDL_GPU_TEXTURETYPE_2D;
+	createinfo.format = renderer->target_format;
+	createinfo.width = drawablew;
+	createinfo.height = drawableh;
+	createinfo.layer_count_or_depth = 1;
+	createinfo.num_levels = 1;
+	createinfo.sample_count = SDL_GPU_SAMPLECOUNT_1;
+	createinfo.usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER;
+	createinfo.props = 0;
+
+	result = target_pool_fit(render_state->targets, texture, &createinfo, shrink);
+	CHECK_CREATE(result, "Resolve Texture");
+}
+
+static void
+FitColorTexture(Renderer* renderer, SDL_GPUTexture** texture, Uint32 drawablew, Uint32 drawableh, bool shrink)
+{
+	SDL_GPUTextureCreateInfo createinfo;
+	bool result;
+
+	RenderState* render_state = &renderer->render_state;
+
+	if (!renderer->headless) {
+		return;
+	}
+
+	createinfo.type = SDL_GPU_TEXTURETYPE_2D;
+	createinfo.format = HEADLESS_FORMAT;
+	createinfo.width = drawablew;
+	createinfo.height = drawableh;
+	createinfo.layer_count_or_depth = 1;
+	createinfo.num_levels = 1;
+	createinfo.sample_count = SDL_GPU_SAMPLECOUNT_1;
+	createinfo.usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
+	createinfo.props = 0;
+
+	result = target_pool_fit(render_state->targets, texture, &createinfo, shrink);
+	CHECK_CREATE(result, "Headless Color Texture");
+}
+
+/*
+ * Lists the active piece's cells and those of its ghost, where a hard
+ * drop would land, with their offsets from the board centre. Ghost cells
+ * the piece itself is in are left out. Returns the number of cells.
+ */
+static Uint32
+list_piece_cells(const Tetris* tetris, BoardCell* out)
+{
+	if (tetris->piece == 0)
+	{
+		return 0;
+	}
+
+	const PieceShape* shape = &piece_shapes[tetris->piece][tetris->rot];
+	int drop = tetris_drop_distance(tetris);
+	Uint32 num_cells = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		out[num_cells].offset = vec4_set((float)(tetris->x + shape->xs[i]) - 4.5f, (float)(tetris->y + shape->ys[i]) - 10.5f, 0.0f, 0.0f);
+		out[num_cells].piece = tetris->piece;
+		++num_cells;
+	}
+	for (int i = 0; i < 4 && drop > 0; ++i)
+	{
+		bool covered = false;
+		for (int j = 0; j < 4; ++j)
+		{
+			covered |= shape->xs[j] == shape->xs[i] && shape->ys[j] == shape->ys[i] - drop;
+		}
+		if (!covered)
+		{
+			out[num_cells].offset = vec4_set((float)(tetris->x + shape->xs[i]) - 4.5f, (float)(tetris->y + shape->ys[i] - drop) - 10.5f, 0.0f, 0.0f);
+			out[num_cells].piece = GHOST_COLOR;
+			++num_cells;
+		}
+	}
+	return num_cells;
+}
+
+/* Writes one mesh per cell: the already rotated mesh vertices moved to the cell, in the mesh's formats */
+static void
+write_cell_vertices(const Renderer* renderer, const BoardCell* cells, Uint32 num_cells, const vec4* corners, Uint8* out)
+{
+	const MeshLod* mesh = &renderer->mesh;
+	Uint32 position_size = mesh_format_size(renderer->position_format);
+	float scale = 1.0f / renderer->position_range;
+
+	for (Uint32 c = 0; c < num_cells; ++c)
+	{
+		const float* color = piece_colors[cells[c].piece];
+		for (Uint32 i = 0; i < mesh->num_vertices; ++i)
+		{
+			vec4 position = vec4_add(corners[i], cells[c].offset);
+			float xyz[3] = { position.f[0] * scale, position.f[1] * scale, position.f[2] * scale };
+			float rgb[3] = { color[0] * mesh->colors[i][0], color[1] * mesh->colors[i][1], color[2] * mesh->colors[i][2] };
+			mesh_encode(renderer->position_format, xyz, out);
+			mesh_encode(renderer->color_format, rgb, out + position_size);
+			out += renderer->vertex_size;
+		}
+	}
+}
+
+/*
+ * Brings a board's stack vertices, the cell slots from slot *
+ * MAX_BOARD_CELLS on in buf_stack, up to date with its locked cells. The
+ * stack only changes when a piece locks or lines clear, so most frames
+ * just compare the board and upload nothing; otherwise the rows from the
+ * lowest to the highest changed one are rewritten in a single upload.
+ * Empty cells get degenerate cubes, and only rows up to the top of the
+ * stack are drawn, by the board's commands in buf_indirect. cycle_draws
+ * may be set when that holds no other board's. Returns the bytes uploaded.
+ */
+static Uint32
+update_stack(Renderer* renderer, BoardStack* stack, const Tetris* tetris, SDL_GPUBuffer* buf_stack,
+	SDL_GPUBuffer* buf_indirect, Uint32 slot, bool cycle_draws)
+{
+	RenderState* render_state = &renderer->render_state;
+	SDL_GPUTransferBufferLocation location;
+	int first = 22, last = -1;
+
+	if (stack->valid && SDL_memcmp(stack->board, tetris->board, MAX_BOARD_CELLS) == 0)
+	{
+		return 0;
+	}
+	for (int y = 0; y < 22; ++y)
+	{
+		if (!stack->valid || SDL_memcmp(&stack->board[y * 10], &tetris->board[y * 10], 10) != 0)
+		{
+			first = SDL_min(first, y);
+			last = y;
+		}
+	}
+
+	/* Locked cubes stand still, so their corners are not rotated */
+	vec4 corners[MESH_MAX_VERTICES];
+	for (Uint32 i = 0; i < renderer->mesh.num_vertices; ++i)
+	{
+		const float* position = renderer->mesh.positions[i];
+		corners[i] = vec4_set(position[0], position[1], position[2], 0.0f);
+	}
+
+	Uint32 row_size = 10 * renderer->cell_size;
+	Uint32 size = (last - first + 1) * row_size;
+	Uint8* vertices = upload_arena_alloc(render_state->uploads, size, 16, &location);
+	if (!vertices)
+	{
+		SDL_Log("Failed to upload the stack: %s", SDL_GetError());
+		return 0;
+	}
+
+	for (int y = first; y <= last; ++y)
+	{
+		for (int x = 0; x < 10; ++x)
+		{
+			Uint8* out = vertices + ((y - first) * 10 + x) * renderer->cell_size;
+			BoardCell cell;
+			cell.piece = tetris->board[x + y * 10];
+			cell.offset = vec4_set((float)x - 4.5f, (float)y - 10.5f, 0.0f, 0.0f);
+			if (cell.piece != 0)
+			{
+				write_cell_vertices(renderer, &cell, 1, corners, out);
+			}
+			else
+			{
+				SDL_memset(out, 0, renderer->cell_size);
+			}
+		}
+		SDL_memcpy(&stack->board[y * 10], &tetris->board[y * 10], 10);
+	}
+
+	stack->rows = 0;
+	for (int y = 0; y < 22; ++y)
+	{
+		if (tetris->rows[y] != 0)
+		{
+			stack->rows = y + 1;
+		}
+	}
+
+	/* Not cycled, the other rows stay */
+	if (!upload_arena_copy(render_state->uploads, &location, buf_stack,
+		slot * MAX_BOARD_CELLS * renderer->cell_size + first * row_size, size, false))
+	{
+		/* Compared as changed next time, so every row is uploaded again */
+		SDL_Log("Failed to upload the stack: %s", SDL_GetError());
+		stack->valid = false;
+		stack->draws = 0;
+		return size;
+	}
+
+	/* One draw per run of locked cells, so the GPU skips the empty slots; runs go on across rows */
+	SDL_GPUIndexedIndirectDrawCommand* draws = upload_arena_alloc(render_state->uploads,
+		MAX_STACK_DRAWS * sizeof(SDL_GPUIndexedIndirectDrawCommand), 16, &location);
+	stack->draws = 0;
+	if (!draws)
+	{
+		/* Compared as changed next time, so the draws are redone */
+		SDL_Log("Failed to upload the stack draws: %s", SDL_GetError());
+		stack->valid = false;
+		return size;
+	}
+	stack->valid = true;
+	Uint32 num_slots = stack->rows * 10;
+	for (Uint32 cell = 0; cell < num_slots;)
+	{
+		if (tetris->board[cell] == 0)
+		{
+			++cell;
+			continue;
+		}
+		Uint32 first_cell = cell;
+		while (cell < num_slots && tetris->board[cell] != 0)
+		{
+			++cell;
+		}
+		SDL_GPUIndexedIndirectDrawCommand* draw = &draws[stack->draws++];
+		draw->num_indices = (cell - first_cell) * renderer->mesh.num_indices;
+		draw->num_instances = 1;
+		draw->first_index = first_cell * renderer->mesh.num_indices;
+		draw->vertex_offset = 0;
+		draw->first_instance = 0;
+	}
+	Uint32 draws_size = stack->draws * sizeof(SDL_GPUIndexedIndirectDrawCommand);
+	if (draws_size > 0 && !upload_arena_copy(render_state->uploads, &location, buf_indirect,
+		slot * MAX_STACK_DRAWS * sizeof(SDL_GPUIndexedIndirectDrawCommand), draws_size, cycle_draws))
+	{
+		SDL_Log("Failed to upload the stack draws: %s", SDL_GetError());
+		stack->valid = false;
+		stack->draws = 0;
+	}
+	return size + draws_size;
+}
+
+/*
+ * Returns this frame's cube rotation for the window and spins it a bit
+ * further for the next one.
+ */
+static void
+spin_window(WindowState* winstate, mat4* matrix_modelview)
+{
+	mat4 matrix_rotate;
+
+	/*
+	* Do some rotation with Euler angles. It is not a fixed axis as
+	* quaterions would be, but the effect is cool.
+	*/
+	mat4_rotate((float)winstate->angle_x, 1.0f, 0.0f, 0.0f, matrix_modelview);
+	mat4_rotate((float)winstate->angle_y, 0.0f, 1.0f, 0.0f, &matrix_rotate);
+
+	mat4_mul(&matrix_rotate, matrix_modelview, matrix_modelview);
+
+	mat4_rotate((float)winstate->angle_z, 0.0f, 1.0f, 0.0f, &matrix_rotate);
+
+	mat4_mul(&matrix_rotate, matrix_modelview, matrix_modelview);
+
+	winstate->angle_x += 3;
+	winstate->angle_y += 2;
+	winstate->angle_z += 1;
+
+	if (winstate->angle_x >= 360) winstate->angle_x -= 360;
+	if (winstate->angle_x < 0) winstate->angle_x += 360;
+	if (winstate->angle_y >= 360) winstate->angle_y -= 360;
+	if (winstate->angle_y < 0) winstate->angle_y += 360;
+	if (winstate->angle_z >= 360) winstate->angle_z -= 360;
+	if (winstate->angle_z < 0) winstate->angle_z += 360;
+}
+
+/*
+* The cubes spin around their own centres, so rotate the mesh vertices
+* once and bake the cell offsets into the vertices. A single transform
+* then places the whole board in front of the camera.
+*/
+static void
+rotate_corners(const Renderer* renderer, const mat4* matrix_modelview, vec4* corners)
+{
+	for (Uint32 i = 0; i < renderer->mesh.num_vertices; ++i)
+	{
+		const float* position = renderer->mesh.positions[i];
+		corners[i] = mat4_mul_vec4(matrix_modelview, vec4_set(position[0], position[1], position[2], 0.0f));
+	}
+}
+
+/*
+ * Fit the window's targets to its size. While it is being resized they
+ * only grow, a size class at a time; once the size has held for
+ * TARGET_SETTLE_FRAMES they shrink to the smallest class that fits.
+ */
+static void
+resize_window_targets(Renderer* renderer, WindowState* winstate, Uint32 drawablew, Uint32 drawableh)
+{
+	bool shrink;
+
+	if (winstate->prev_drawablew != drawablew || winstate->prev_drawableh != drawableh) {
+		winstate->settled_frames = 0;
+		shrink = false;
+	}
+	else if (winstate->settled_frames < TARGET_SETTLE_FRAMES && ++winstate->settled_frames == TARGET_SETTLE_FRAMES) {
+		shrink = true;
+	}
+	else {
+		return;
+	}
+	FitDepthTexture(renderer, &winstate->tex_depth, drawablew, drawableh, shrink);
+	FitMSAATexture(renderer, &winstate->tex_msaa, drawablew, drawableh, shrink);
+	FitResolveTexture(renderer, &winstate->tex_resolve, drawablew, drawableh, shrink);
+	FitColorTexture(renderer, &winstate->tex_color, drawablew, drawableh, shrink);
+	winstate->prev_drawablew = drawablew;
+	winstate->prev_drawableh = drawableh;
+}
+
+/*
+ * Begins the window's render pass, clearing its targets, with the viewport
+ * and scissor set to the whole window.
+ */
+static SDL_GPURenderPass*
+begin_window_pass(Renderer* renderer, SDL_GPUCommandBuffer* cmd, WindowState* winstate, SDL_GPUTexture* swapchainTexture)
+{
+	SDL_GPUColorTargetInfo color_target;
+	SDL_GPUDepthStencilTargetInfo depth_target;
+	SDL_GPURenderPass* pass;
+	SDL_GPUViewport viewport;
+	SDL_Rect scissor;
+
+	RenderState* render_state = &renderer->render_state;
+
+	SDL_zero(color_target);
+	color_target.clear_color.a = 1.0f;
+	if (winstate->tex_msaa) {
+		color_target.load_op = SDL_GPU_LOADOP_CLEAR;
+		color_target.store_op = SDL_GPU_STOREOP_RESOLVE;
+		color_target.texture = winstate->tex_msaa;
+		color_target.resolve_texture = render_state->msaa_blit ? winstate->tex_resolve : swapchainTexture;
+		color_target.cycle = true;
+		color_target.cycle_resolve_texture = render_state->msaa_blit || renderer->headless;
+	}
+	else {
+		color_target.load_op = SDL_GPU_LOADOP_CLEAR;
+		color_target.store_op = SDL_GPU_STOREOP_STORE;
+		color_target.texture = swapchainTexture;
+		color_target.cycle = renderer->headless; /* a swapchain texture is new every frame anyway */
+	}
+
+	SDL_zero(depth_target);
+	depth_target.clear_depth = 1.0f;
+	depth_target.load_op = SDL_GPU_LOADOP_CLEAR;
+	depth_target.store_op = SDL_GPU_STOREOP_DONT_CARE;
+	depth_target.stencil_load_op = SDL_GPU_LOADOP_DONT_CARE;
+	depth_target.stencil_store_op = SDL_GPU_STOREOP_DONT_CARE;
+	depth_target.texture = winstate->tex_depth;
+	depth_target.cycle = true;
+
+	pass = SDL_BeginGPURenderPass(cmd, &color_target, 1, &depth_target);
+
+	/* The pooled targets may be larger than the window */
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.w = (float)winstate->prev_drawablew;
+	viewport.h = (float)winstate->prev_drawableh;
+	viewport.min_depth = 0.0f;
+	viewport.max_depth = 1.0f;
+	SDL_SetGPUViewport(pass, &viewport);
+	scissor.x = 0;
+	scissor.y = 0;
+	scissor.w = (int)winstate->prev_drawablew;
+	scissor.h = (int)winstate->prev_drawableh;
+	SDL_SetGPUScissor(pass, &scissor);
+	return pass;
+}
+
+/* View-projection placing a whole board in a viewport of the given aspect ratio */
+static void
+board_matrix(const Renderer* renderer, float aspect, mat4* matrix_final)
+{
+	mat4 matrix_perspective;
+
+	mat4_perspective(45.0f, aspect, 0.01f, 100.0f, &matrix_perspective);
+	mat4_translate(&matrix_perspective, 0.0f, 0.0f, -22.0f, matrix_final);
+
+	/* Scale positions written divided by position_range back up */
+	for (int i = 0; i < 12; ++i)
+	{
+		matrix_final->col[i / 4].f[i % 4] *= renderer->position_range;
+	}
+}
+
+/* Blits the MSAA resolve target to the swapchain, if it was not resolved into directly */
+static void
+blit_window(Renderer* renderer, SDL_GPUCommandBuffer* cmd, WindowState* winstate, SDL_GPUTexture* swapchainTexture)
+{
+	SDL_GPUBlitInfo blit_info;
+
+	RenderState* render_state = &renderer->render_state;
+	if (render_state->sample_count == SDL_GPU_SAMPLECOUNT_1 || !render_state->msaa_blit) {
+		return;
+	}
+
+	SDL_zero(blit_info);
+	blit_info.source.texture = winstate->tex_resolve;
+	blit_info.source.w = winstate->prev_drawablew;
+	blit_info.source.h = winstate->prev_drawableh;
+
+	blit_info.destination.texture = swapchainTexture;
+	blit_info.destination.w = winstate->prev_drawablew;
+	blit_info.destination.h = winstate->prev_drawableh;
+
+	blit_info.load_op = SDL_GPU_LOADOP_DONT_CARE;
+	blit_info.filter = SDL_GPU_FILTER_LINEAR;
+
+	SDL_BlitGPUTexture(cmd, &blit_info);
+}
+
+/*
+ * Records the window's render pass, drawing the locked stack and the
+ * num_cells active piece cubes starting at vertex_offset bytes into
+ * buf_vertex, and the MSAA blit. Returns the lap counter.
+ */
+static Uint64
+record_window(Renderer* renderer, SDL_GPUCommandBuffer* cmd, WindowState* winstate, SDL_GPUTexture* swapchainTexture,
+	Uint32 vertex_offset, Uint32 num_cells, Uint64 lap)
+{
+	mat4 matrix_final;
+	SDL_GPURenderPass* pass;
+	SDL_GPUBufferBinding vertex_binding, stack_binding, index_binding;
+
+	RenderState* render_state = &renderer->render_state;
+
+	/* View-projection for the whole board, computed once per frame */
+	board_matrix(renderer, (float)winstate->prev_drawablew / winstate->prev_drawableh, &matrix_final);
+
+	/* Set up the bindings */
+
+	vertex_binding.buffer = render_state->buf_vertex;
+	vertex_binding.offset = vertex_offset;
+	stack_binding.buffer = render_state->buf_stack;
+	stack_binding.offset = 0;
+	index_binding.buffer = render_state->buf_index;
+	index_binding.offset = 0;
+
+	/* Draw the cube(s)! */
+
+	pass = begin_window_pass(renderer, cmd, winstate, swapchainTexture);
+
+	if (renderer->stack.rows > 0 || num_cells > 0)
+	{
+		SDL_BindGPUGraphicsPipeline(pass, render_state->pipeline);
+		SDL_BindGPUIndexBuffer(pass, &index_binding, SDL_GPU_INDEXELEMENTSIZE_16BIT);
+		SDL_PushGPUVertexUniformData(cmd, 0, &matrix_final, sizeof(matrix_final));
+		if (renderer->stack.rows > 0)
+		{
+			SDL_BindGPUVertexBuffers(pass, 0, &stack_binding, 1);
+			if (renderer->direct_stack)
+			{
+				SDL_DrawGPUIndexedPrimitives(pass, renderer->stack.rows * 10 * renderer->mesh.num_indices, 1, 0, 0, 0);
+			}
+			else if (renderer->stack.draws > 0)
+			{
+				SDL_DrawGPUIndexedPrimitivesIndirect(pass, render_state->buf_indirect, 0, renderer->stack.draws);
+			}
+		}
+		if (num_cells > 0)
+		{
+			SDL_BindGPUVertexBuffers(pass, 0, &vertex_binding, 1);
+			SDL_DrawGPUIndexedPrimitives(pass, num_cells * renderer->mesh.num_indices, 1, 0, 0, 0);
+		}
+	}
+
+	SDL_EndGPURenderPass(pass);
+	lap = frametimes_lap(renderer->frame_times, FRAME_STAGE_RECORD, lap);
+
+	blit_window(renderer, cmd, winstate, swapchainTexture);
+	return frametimes_lap(renderer->frame_times, FRAME_STAGE_BLIT, lap);
+}
+
+/* Clears the swapchain texture, all there is to show while the pipeline is loading */
+static void
+record_clear(SDL_GPUCommandBuffer* cmd, SDL_GPUTexture* swapchainTexture)
+{
+	SDL_GPUColorTargetInfo color_target;
+
+	SDL_zero(color_target);
+	color_target.clear_color.a = 1.0f;
+	color_target.load_op = SDL_GPU_LOADOP_CLEAR;
+	color_target.store_op = SDL_GPU_STOREOP_STORE;
+	color_target.texture = swapchainTexture;
+	SDL_EndGPURenderPass(SDL_BeginGPURenderPass(cmd, &color_target, 1, NULL));
+}
+
+/* Joins the loader thread once it is done, or right away if wait is set */
+static bool
+finish_loading(Renderer* renderer, bool wait)
+{
+	if (renderer->loader && (wait || SDL_GetAtomicInt(&renderer->loaded) != 0)) {
+		SDL_WaitThread(renderer->loader, NULL);
+		renderer->loader = NULL;
+		renderer->ready = SDL_GetAtomicInt(&renderer->loaded) > 0;
+		if (!renderer->ready) {
+			SDL_Log("Failed to set up the render pipeline, only clearing the windows");
+		}
+	}
+	return renderer->ready;
+}
+
+/* Waits for the oldest frame renderer_begin_frame fenced */
+static void
+retire_frame(Renderer* renderer)
+{
+	SDL_WaitForGPUFences(renderer->gpu_device, true, &renderer->frame_fences[0], 1);
+	SDL_ReleaseGPUFence(renderer->gpu_device, renderer->frame_fences[0]);
+	renderer->num_frame_fences -= 1;
+	SDL_memmove(&renderer->frame_fences[0], &renderer->frame_fences[1], renderer->num_frame_fences * sizeof(SDL_GPUFence*));
+}
+
+/* The window's swapchain texture, or when headless its own color target, which is never missing */
+static bool
+acquire_target(Renderer* renderer, SDL_GPUCommandBuffer* cmd, int window_index, SDL_GPUTexture** texture)
+{
+	if (renderer->headless) {
+		*texture = renderer->window_states[window_index].tex_color;
+		return true;
+	}
+	return SDL_AcquireGPUSwapchainTexture(cmd, renderer->windows[window_index], texture);
+}
+
+/*
+ * Fits the window's targets to its size. That may replace a headless
+ * window's color texture, so its target is taken again.
+ */
+static void
+fit_window_targets(Renderer* renderer, int window_index, SDL_GPUTexture** target)
+{
+	WindowState* winstate = &renderer->window_states[window_index];
+	int drawablew, drawableh;
+
+	SDL_GetWindowSizeInPixels(renderer->windows[window_index], &drawablew, &drawableh);
+	resize_window_targets(renderer, winstate, drawablew, drawableh);
+	if (renderer->headless) {
+		*target = winstate->tex_color;
+	}
+}
+
+/* Waits for a frame download and hands the pixels to the frame callback */
+static void
+deliver_download(Renderer* renderer, int window_index, FrameDownload* download)
+{
+	SDL_GPUDevice* gpu_device = renderer->gpu_device;
+
+	SDL_WaitForGPUFences(gpu_device, true, &download->fence, 1);
+	SDL_ReleaseGPUFence(gpu_device, download->fence);
+	download->fence = NULL;
+
+	const Uint8* pixels = SDL_MapGPUTransferBuffer(gpu_device, download->buffer, false);
+	if (!pixels) {
+		SDL_Log("Failed to map frame download: %s", SDL_GetError());
+		return;
+	}
+	renderer->frame_func(renderer->frame_userdata, window_index, download->frame, pixels, download->width, download->height);
+	SDL_UnmapGPUTransferBuffer(gpu_device, download->buffer);
+}
+
+/*
+ * Copies the headless frame just drawn for the window back to the CPU. It
+ * goes in a command buffer of its own, submitted after the frame's, so the
+ * fence covers the download only; the pixels reach the frame callback once
+ * FRAME_DOWNLOADS later frames need the slot, or in renderer_finish_frames.
+ */
+static void
+download_frame(Renderer* renderer, int window_index)
+{
+	SDL_GPUDevice* gpu_device = renderer->gpu_device;
+	WindowState* winstate = &renderer->window_states[window_index];
+	Uint64 frame = winstate->frames++;
+
+	if (!renderer->frame_func) {
+		return;
+	}
+
+	FrameDownload* download = &winstate->downloads[winstate->next_download];
+	if (download->fence) {
+		deliver_download(renderer, window_index, download);
+	}
+
+	Uint32 size = winstate->prev_drawablew * winstate->prev_drawableh * 4;
+	if (download->size < size) {
+		SDL_GPUTransferBufferCreateInfo createinfo;
+		SDL_zero(createinfo);
+		createinfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD;
+		createinfo.size = size;
+		SDL_ReleaseGPUTransferBuffer(gpu_device, download->buffer);
+		download->buffer = SDL_CreateGPUTransferBuffer(gpu_device, &createinfo);
+		download->size = download->buffer ? size : 0;
+		if (!download->buffer) {
+			SDL_Log("Failed to create frame download buffer: %s", SDL_GetError());
+			return;
+		}
+	}
+
+	SDL_GPUCommandBuffer* cmd = SDL_AcquireGPUCommandBuffer(gpu_device);
+	if (!cmd) {
+		SDL_Log("Failed to acquire command buffer :%s", SDL_GetError());
+		return;
+	}
+
+	SDL_GPUTextureRegion source;
+	SDL_GPUTextureTransferInfo destination;
+	SDL_zero(source);
+	source.texture = winstate->tex_color;
+	source.w = winstate->prev_drawablew;
+	source.h = winstate->prev_drawableh;
+	source.d = 1;
+	SDL_zero(destination);
+	destination.transfer_buffer = download->buffer;
+	destination.pixels_per_row = winstate->prev_drawablew;
+	destination.rows_per_layer = winstate->prev_drawableh;
+
+	SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(cmd);
+	SDL_DownloadFromGPUTexture(copy_pass, &source, &destination);
+	SDL_EndGPUCopyPass(copy_pass);
+
+	download->fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd);
+	download->frame = frame;
+	download->width = winstate->prev_drawablew;
+	download->height = winstate->prev_drawableh;
+	if (download->fence) {
+		winstate->next_download = (winstate->next_download + 1) % FRAME_DOWNLOADS;
+	}
+}
+
+void
+renderer_draw(Renderer* renderer, int windownum, const Tetris* tetris)
+{
+	WindowState* winstate = &renderer->window_states[windownum];
+	SDL_GPUTexture* swapchainTexture;
+	mat4 matrix_modelview;
+	SDL_GPUCommandBuffer* cmd;
+
+	SDL_GPUDevice* gpu_device = renderer->gpu_device;
+	RenderState* render_state = &renderer->render_state;
+	Uint64 lap = frametimes_now(renderer->frame_times);
+
+	/* Acquire the swapchain texture */
+	cmd = SDL_AcquireGPUCommandBuffer(gpu_device);
+	if (!cmd) {
+		SDL_Log("Failed to acquire command buffer :%s", SDL_GetError());
+		SDL_assert_always(0);
+		return;
+	}
+	if (!acquire_target(renderer, cmd, windownum, &swapchainTexture)) {
+		SDL_Log("Failed to acquire swapchain texture: %s", SDL_GetError());
+		SDL_assert_always(0);
+		return;
+	}
+
+	lap = frametimes_lap(renderer->frame_times, FRAME_STAGE_ACQUIRE, lap);
+
+	if (swapchainTexture == NULL) {
+		/* No swapchain was acquired, probably too many frames in flight */
+		renderer->skipped_frames += 1;
+		SDL_SubmitGPUCommandBuffer(cmd);
+		frametimes_lap(renderer->frame_times, FRAME_STAGE_SUBMIT, lap);
+		return;
+	}
+
+	if (!renderer->ready && !finish_loading(renderer, false)) {
+		record_clear(cmd, swapchainTexture);
+		SDL_SubmitGPUCommandBuffer(cmd);
+		frametimes_lap(renderer->frame_times, FRAME_STAGE_SUBMIT, lap);
+		return;
+	}
+
+	fit_window_targets(renderer, windownum, &swapchainTexture);
+	lap = frametimes_lap(renderer->frame_times, FRAME_STAGE_TEXTURES, lap);
+
+	vec4 corners[MESH_MAX_VERTICES];
+	spin_window(winstate, &matrix_modelview);
+	rotate_corners(renderer, &matrix_modelview, corners);
+
+	update_stack(renderer, &renderer->stack, tetris, render_state->buf_stack, render_state->buf_indirect, 0, true);
+
+	SDL_GPUTransferBufferLocation location;
+	Uint32 num_cells = list_piece_cells(tetris, renderer->cells);
+	Uint8* vertices = num_cells > 0 ? upload_arena_alloc(render_state->uploads, num_cells * renderer->cell_size, 16, &location) : NULL;
+	if (vertices)
+	{
+		write_cell_vertices(renderer, renderer->cells, num_cells, corners, vertices);
+	}
+	if (!vertices || !upload_arena_copy(render_state->uploads, &location, render_state->buf_vertex, 0, num_cells * renderer->cell_size, true))
+	{
+		num_cells = 0;
+	}
+	upload_arena_flush(render_state->uploads, cmd);
+
+	lap = record_window(renderer, cmd, winstate, swapchainTexture, 0, num_cells, lap);
+
+	/* Submit the command buffer! */
+	upload_arena_submit(render_state->uploads, cmd);
+	if (renderer->headless) {
+		download_frame(renderer, windownum);
+	}
+	frametimes_lap(renderer->frame_times, FRAME_STAGE_SUBMIT, lap);
+
+	renderer->frames += 1;
+}
+
+/* Writes the vertices of whichever windows are left; the calling thread and every worker take part */
+static void
+run_vertex_jobs(Renderer* renderer)
+{
+	for (;;)
+	{
+		int job = SDL_AddAtomicInt(&renderer->next_job, 1);
+		if (job >= renderer->num_jobs)
+		{
+			return;
+		}
+		const VertexJob* vertex_job = &renderer->jobs[job];
+		write_cell_vertices(renderer, renderer->cells, renderer->num_cells, vertex_job->corners, vertex_job->out);
+	}
+}
+
+static int SDLCALL
+worker_thread(void* data)
+{
+	Renderer* renderer = data;
+	for (;;)
+	{
+		SDL_WaitSemaphore(renderer->start);
+		if (SDL_GetAtomicInt(&renderer->quit))
+		{
+			return 0;
+		}
+		run_vertex_jobs(renderer);
+		SDL_SignalSemaphore(renderer->done);
+	}
+}
+
+void
+renderer_draw_all(Renderer* renderer, const Tetris* tetris)
+{
+	SDL_GPUCommandBuffer* cmd;
+	mat4 matrix_modelview;
+
+	SDL_GPUDevice* gpu_device = renderer->gpu_device;
+	RenderState* render_state = &renderer->render_state;
+	Uint64 lap = frametimes_now(renderer->frame_times);
+
+	/* One command buffer for every window, acquiring all swapchain textures up front */
+	cmd = SDL_AcquireGPUCommandBuffer(gpu_device);
+	if (!cmd) {
+		SDL_Log("Failed to acquire command buffer :%s", SDL_GetError());
+		SDL_assert_always(0);
+		return;
+	}
+	int num_visible = 0;
+	for (int i = 0; i < renderer->num_windows; ++i)
+	{
+		WindowState* winstate = &renderer->window_states[i];
+		if (!acquire_target(renderer, cmd, i, &winstate->swapchain)) {
+			SDL_Log("Failed to acquire swapchain texture: %s", SDL_GetError());
+			SDL_assert_always(0);
+			return;
+		}
+		num_visible += winstate->swapchain != NULL;
+	}
+
+	lap = frametimes_lap(renderer->frame_times, FRAME_STAGE_ACQUIRE, lap);
+
+	if (num_visible == 0) {
+		/* No swapchain was acquired, probably too many frames in flight */
+		renderer->skipped_frames += 1;
+		SDL_SubmitGPUCommandBuffer(cmd);
+		frametimes_lap(renderer->frame_times, FRAME_STAGE_SUBMIT, lap);
+		return;
+	}
+
+	if (!renderer->ready && !finish_loading(renderer, false)) {
+		for (int i = 0; i < renderer->num_windows; ++i) {
+			if (renderer->window_states[i].swapchain) {
+				record_clear(cmd, renderer->window_states[i].swapchain);
+			}
+		}
+		SDL_SubmitGPUCommandBuffer(cmd);
+		frametimes_lap(renderer->frame_times, FRAME_STAGE_SUBMIT, lap);
+		return;
+	}
+
+	for (int i = 0; i < renderer->num_windows; ++i)
+	{
+		WindowState* winstate = &renderer->window_states[i];
+		if (winstate->swapchain)
+		{
+			fit_window_targets(renderer, i, &winstate->swapchain);
+		}
+	}
+	lap = frametimes_lap(renderer->frame_times, FRAME_STAGE_TEXTURES, lap);
+
+	/*
+	 * The stack is shared by every window. The active piece is the same in
+	 * all of them too, so list its cells once; each spinning window still
+	 * needs its own vertices, mirrored windows all share those of the first.
+	 */
+	update_stack(renderer, &renderer->stack, tetris, render_state->buf_stack, render_state->buf_indirect, 0, true);
+	renderer->num_cells = list_piece_cells(tetris, renderer->cells);
+	renderer->num_jobs = 0;
+
+	SDL_GPUTransferBufferLocation location;
+	Uint32 slice_size = PIECE_CELLS * renderer->cell_size;
+	Uint8* vertices = NULL;
+	if (renderer->num_cells > 0)
+	{
+		vertices = upload_arena_alloc(render_state->uploads, (renderer->mirrored ? 1 : renderer->num_windows) * slice_size, 16, &location);
+	}
+	if (!vertices)
+	{
+		renderer->num_cells = 0;
+	}
+
+	for (int i = 0; i < renderer->num_windows; ++i)
+	{
+		WindowState* winstate = &renderer->window_states[i];
+		if (renderer->mirrored ? i > 0 : !winstate->swapchain)
+		{
+			continue;
+		}
+		spin_window(winstate, &matrix_modelview);
+		if (vertices)
+		{
+			VertexJob* job = &renderer->jobs[renderer->num_jobs++];
+			rotate_corners(renderer, &matrix_modelview, job->corners);
+			job->out = vertices + i * slice_size;
+		}
+	}
+
+	SDL_SetAtomicInt(&renderer->next_job, 0);
+	int num_helpers = renderer->num_jobs > 1 ? SDL_min(renderer->num_workers, renderer->num_jobs - 1) : 0;
+	for (int i = 0; i < num_helpers; ++i)
+	{
+		SDL_SignalSemaphore(renderer->start);
+	}
+	run_vertex_jobs(renderer);
+	for (int i = 0; i < num_helpers; ++i)
+	{
+		SDL_WaitSemaphore(renderer->done);
+	}
+
+	if (renderer->num_jobs > 0)
+	{
+		/* Everything up to the last window written, in one upload */
+		Uint32 last = (Uint32)(renderer->jobs[renderer->num_jobs - 1].out - vertices);
+		if (!upload_arena_copy(render_state->uploads, &location, render_state->buf_vertex, 0,
+			last + renderer->num_cells * renderer->cell_size, true))
+		{
+			renderer->num_cells = 0;
+		}
+	}
+	upload_arena_flush(render_state->uploads, cmd);
+
+	for (int i = 0; i < renderer->num_windows; ++i)
+	{
+		WindowState* winstate = &renderer->window_states[i];
+		if (winstate->swapchain)
+		{
+			Uint32 slice = renderer->mirrored ? 0 : i;
+			lap = record_window(renderer, cmd, winstate, winstate->swapchain,
+				slice * slice_size, renderer->num_cells, lap);
+		}
+	}
+
+	/* Submit the command buffer! */
+	upload_arena_submit(render_state->uploads, cmd);
+	for (int i = 0; i < renderer->num_windows && renderer->headless; ++i)
+	{
+		download_frame(renderer, i);
+	}
+	frametimes_lap(renderer->frame_times, FRAME_STAGE_SUBMIT, lap);
+
+	renderer->frames += 1;
+}
+
+/* Makes room for num_boards boards on the wall, dropping what the old buffers held */
+static bool
+reserve_wall(Renderer* renderer, Uint32 num_boards)
+{
+	SDL_GPUBufferCreateInfo buffer_desc;
+
+	Wall* wall = &renderer->wall;
+	if (num_boards <= wall->max_boards)
+	{
+		return true;
+	}
+
+	SDL_ReleaseGPUBuffer(renderer->gpu_device, wall->buf_stacks);
+	SDL_ReleaseGPUBuffer(renderer->gpu_device, wall->buf_draws);
+	SDL_ReleaseGPUBuffer(renderer->gpu_device, wall->buf_pieces);
+	SDL_free(wall->boards);
+	SDL_zerop(wall);
+
+	buffer_desc.usage = SDL_GPU_BUFFERUSAGE_VERTEX;
+	buffer_desc.size = num_boards * MAX_BOARD_CELLS * renderer->cell_size;
+	buffer_desc.props = 0;
+	wall->buf_stacks = SDL_CreateGPUBuffer(renderer->gpu_device, &buffer_desc);
+	Uint32 total = buffer_desc.size;
+
+	buffer_desc.size = num_boards * PIECE_CELLS * renderer->cell_size;
+	wall->buf_pieces = SDL_CreateGPUBuffer(renderer->gpu_device, &buffer_desc);
+	total += buffer_desc.size;
+
+	buffer_desc.usage = SDL_GPU_BUFFERUSAGE_INDIRECT;
+	buffer_desc.size = num_boards * MAX_STACK_DRAWS * sizeof(SDL_GPUIndexedIndirectDrawCommand);
+	wall->buf_draws = SDL_CreateGPUBuffer(renderer->gpu_device, &buffer_desc);
+	total += buffer_desc.size;
+
+	wall->boards = SDL_calloc(num_boards, sizeof(WallBoard));
+	if (!wall->buf_stacks || !wall->buf_pieces || !wall->buf_draws || !wall->boards)
+	{
+		SDL_Log("Failed to set up a wall of %u boards: %s", num_boards, SDL_GetError());
+		SDL_ReleaseGPUBuffer(renderer->gpu_device, wall->buf_stacks);
+		SDL_ReleaseGPUBuffer(renderer->gpu_device, wall->buf_draws);
+		SDL_ReleaseGPUBuffer(renderer->gpu_device, wall->buf_pieces);
+		SDL_free(wall->boards);
+		SDL_zerop(wall);
+		return false;
+	}
+	wall->max_boards = num_boards;
+	SDL_Log("Wall: %u boards, %u KiB of vertex and draw buffers", num_boards, total / 1024);
+	return true;
+}
+
+/*
+ * Lays the boards out in a grid filling the window as far as it can. If
+ * that makes them smaller than WALL_MIN_BOARD_HEIGHT, they keep that size
+ * and only the rows from the wall's first_row on are on screen.
+ */
+static void
+layout_wall(Renderer* renderer, const WindowState* winstate, Uint32 num_boards, WallLayout* layout)
+{
+	float width = (float)winstate->prev_drawablew;
+	float height = (float)winstate->prev_drawableh;
+
+	layout->columns = 1;
+	layout->board_h = 0.0f;
+	for (Uint32 columns = 1; columns <= num_boards; ++columns)
+	{
+		Uint32 rows = (num_boards + columns - 1) / columns;
+		float board_h = SDL_min(height / rows, width / columns / WALL_BOARD_ASPECT);
+		if (board_h > layout->board_h)
+		{
+			layout->columns = columns;
+			layout->board_h = board_h;
+		}
+	}
+
+	Uint32 rows = (num_boards + layout->columns - 1) / layout->columns;
+	Uint32 first_row = 0;
+	if (layout->board_h < WALL_MIN_BOARD_HEIGHT)
+	{
+		layout->board_h = SDL_min((float)WALL_MIN_BOARD_HEIGHT, height);
+		layout->columns = SDL_max((Uint32)(width / (layout->board_h * WALL_BOARD_ASPECT)), 1);
+		rows = (num_boards + layout->columns - 1) / layout->columns;
+		Uint32 visible_rows = SDL_max((Uint32)(height / layout->board_h), 1);
+		renderer->wall.first_row = SDL_clamp(renderer->wall.first_row, 0, (int)(rows - SDL_min(visible_rows, rows)));
+		first_row = (Uint32)renderer->wall.first_row;
+		rows = SDL_min(visible_rows, rows - first_row);
+	}
+	layout->board_w = layout->board_h * WALL_BOARD_ASPECT;
+
+	/* Centred, floored to whole pixels so neighbouring scissors meet */
+	layout->board_w = SDL_max(SDL_floorf(layout->board_w), 1.0f);
+	layout->board_h = SDL_max(SDL_floorf(layout->board_h), 1.0f);
+	layout->x = SDL_floorf((width - layout->columns * layout->board_w) / 2.0f);
+	layout->y = SDL_floorf((height - rows * layout->board_h) / 2.0f);
+	layout->first = first_row * layout->columns;
+	layout->end = SDL_min(layout->first + rows * layout->columns, num_boards);
+}
+
+/*
+ * Uploads what changed on the boards on screen, up to WALL_UPLOAD_BUDGET
+ * bytes; the rest wait for the next frame, which starts where this one
+ * stopped. Boards off screen are not even looked at until they scroll in.
+ */
+static void
+update_wall(Renderer* renderer, const Tetris* boards, const WallLayout* layout)
+{
+	RenderState* render_state = &renderer->render_state;
+	Wall* wall = &renderer->wall;
+	Uint32 count = layout->end - layout->first;
+	Uint32 start = wall->next_update >= layout->first && wall->next_update < layout->end ? wall->next_update - layout->first : 0;
+	Uint32 uploaded = 0;
+
+	/* Wall pieces do not spin, so every board shares the plain corners */
+	vec4 corners[MESH_MAX_VERTICES];
+	for (Uint32 i = 0; i < renderer->mesh.num_vertices; ++i)
+	{
+		const float* position = renderer->mesh.positions[i];
+		corners[i] = vec4_set(position[0], position[1], position[2], 0.0f);
+	}
+
+	for (Uint32 n = 0; n < count; ++n)
+	{
+		Uint32 index = layout->first + (start + n) % count;
+		if (uploaded >= WALL_UPLOAD_BUDGET)
+		{
+			wall->next_update = index;
+			return;
+		}
+
+		WallBoard* board = &wall->boards[index];
+		const Tetris* tetris = &boards[index];
+		Uint32 stack_bytes = update_stack(renderer, &board->stack, tetris, wall->buf_stacks, wall->buf_draws, index, false);
+		uploaded += stack_bytes;
+
+		/* The ghost moves with the stack too */
+		if (board->piece_valid && stack_bytes == 0 && board->piece == tetris->piece && board->rot == tetris->rot &&
+			board->x == tetris->x && board->y == tetris->y)
+		{
+			continue;
+		}
+		BoardCell cells[PIECE_CELLS];
+		Uint32 num_cells = list_piece_cells(tetris, cells);
+		SDL_GPUTransferBufferLocation location;
+		Uint32 size = num_cells * renderer->cell_size;
+		Uint8* vertices = size > 0 ? upload_arena_alloc(render_state->uploads, size, 16, &location) : NULL;
+		if (vertices)
+		{
+			write_cell_vertices(renderer, cells, num_cells, corners, vertices);
+		}
+		if (size > 0 && (!vertices || !upload_arena_copy(render_state->uploads, &location, wall->buf_pieces,
+			index * PIECE_CELLS * renderer->cell_size, size, false)))
+		{
+			board->piece_valid = false;
+			continue;
+		}
+		board->piece = tetris->piece;
+		board->rot = tetris->rot;
+		board->x = tetris->x;
+		board->y = tetris->y;
+		board->num_cells = num_cells;
+		board->piece_valid = true;
+		uploaded += size;
+	}
+	wall->next_update = layout->first;
+}
+
+/*
+ * Records one render pass for every board on screen, each in a viewport
+ * of its own. They all share the view-projection, pushed once. Returns
+ * the lap counter.
+ */
+static Uint64
+record_wall(Renderer* renderer, SDL_GPUCommandBuffer* cmd, WindowState* winstate, SDL_GPUTexture* swapchainTexture,
+	const WallLayout* layout, Uint64 lap)
+{
+	mat4 matrix_final;
+	SDL_GPUBufferBinding vertex_binding, index_binding;
+	SDL_GPUViewport viewport;
+	SDL_Rect scissor;
+
+	RenderState* render_state = &renderer->render_state;
+	Wall* wall = &renderer->wall;
+	Uint32 draw_size = sizeof(SDL_GPUIndexedIndirectDrawCommand);
+
+	board_matrix(renderer, layout->board_w / layout->board_h, &matrix_final);
+	index_binding.buffer = render_state->buf_index;
+	index_binding.offset = 0;
+
+	SDL_GPURenderPass* pass = begin_window_pass(renderer, cmd, winstate, swapchainTexture);
+	SDL_BindGPUGraphicsPipeline(pass, render_state->pipeline);
+	SDL_BindGPUIndexBuffer(pass, &index_binding, SDL_GPU_INDEXELEMENTSIZE_16BIT);
+	SDL_PushGPUVertexUniformData(cmd, 0, &matrix_final, sizeof(matrix_final));
+
+	viewport.w = layout->board_w;
+	viewport.h = layout->board_h;
+	viewport.min_depth = 0.0f;
+	viewport.max_depth = 1.0f;
+	scissor.w = (int)layout->board_w;
+	scissor.h = (int)layout->board_h;
+	for (Uint32 index = layout->first; index < layout->end; ++index)
+	{
+		const WallBoard* board = &wall->boards[index];
+		bool stack = board->stack.rows > 0 && (renderer->direct_stack || board->stack.draws > 0);
+		if (!stack && board->num_cells == 0)
+		{
+			continue;
+		}
+
+		Uint32 slot = index - layout->first;
+		viewport.x = layout->x + (slot % layout->columns) * layout->board_w;
+		viewport.y = layout->y + (slot / layout->columns) * layout->board_h;
+		SDL_SetGPUViewport(pass, &viewport);
+		scissor.x = (int)viewport.x;
+		scissor.y = (int)viewport.y;
+		SDL_SetGPUScissor(pass, &scissor);
+
+		if (stack)
+		{
+			vertex_binding.buffer = wall->buf_stacks;
+			vertex_binding.offset = index * MAX_BOARD_CELLS * renderer->cell_size;
+			SDL_BindGPUVertexBuffers(pass, 0, &vertex_binding, 1);
+			if (renderer->direct_stack)
+			{
+				SDL_DrawGPUIndexedPrimitives(pass, board->stack.rows * 10 * renderer->mesh.num_indices, 1, 0, 0, 0);
+			}
+			else
+			{
+				SDL_DrawGPUIndexedPrimitivesIndirect(pass, wall->buf_draws, index * MAX_STACK_DRAWS * draw_size, board->stack.draws);
+			}
+		}
+		if (board->num_cells > 0)
+		{
+			vertex_binding.buffer = wall->buf_pieces;
+			vertex_binding.offset = index * PIECE_CELLS * renderer->cell_size;
+			SDL_BindGPUVertexBuffers(pass, 0, &vertex_binding, 1);
+			SDL_DrawGPUIndexedPrimitives(pass, board->num_cells * renderer->mesh.num_indices, 1, 0, 0, 0);
+		}
+	}
+
+	SDL_EndGPURenderPass(pass);
+	lap = frametimes_lap(renderer->frame_times, FRAME_STAGE_RECORD, lap);
+
+	blit_window(renderer, cmd, winstate, swapchainTexture);
+	return frametimes_lap(renderer->frame_times, FRAME_STAGE_BLIT, lap);
+}
+
+void
+renderer_draw_wall(Renderer* renderer, int windownum, const Tetris* boards, Uint32 num_boards)
+{
+	WindowState* winstate = &renderer->window_states[windownum];
+	SDL_GPUTexture* swapchainTexture;
+	SDL_GPUCommandBuffer* cmd;
+
+	RenderState* render_state = &renderer->render_state;
+	Uint64 lap = frametimes_now(renderer->frame_times);
+
+	cmd = SDL_AcquireGPUCommandBuffer(renderer->gpu_device);
+	if (!cmd)
+	{
+		SDL_Log("Failed to acquire command buffer :%s", SDL_GetError());
+		SDL_assert_always(0);
+		return;
+	}
+	if (!acquire_target(renderer, cmd, windownum, &swapchainTexture))
+	{
+		SDL_Log("Failed to acquire swapchain texture: %s", SDL_GetError());
+		SDL_assert_always(0);
+		return;
+	}
+
+	lap = frametimes_lap(renderer->frame_times, FRAME_STAGE_ACQUIRE, lap);
+
+	if (swapchainTexture == NULL)
+	{
+		/* No swapchain was acquired, probably too many frames in flight */
+		renderer->skipped_frames += 1;
+		SDL_SubmitGPUCommandBuffer(cmd);
+		frametimes_lap(renderer->frame_times, FRAME_STAGE_SUBMIT, lap);
+		return;
+	}
+
+	if ((!renderer->ready && !finish_loading(renderer, false)) || num_boards == 0 || !reserve_wall(renderer, num_boards))
+	{
+		record_clear(cmd, swapchainTexture);
+		SDL_SubmitGPUCommandBuffer(cmd);
+		frametimes_lap(renderer->frame_times, FRAME_STAGE_SUBMIT, lap);
+		return;
+	}
+
+	fit_window_targets(renderer, windownum, &swapchainTexture);
+	lap = frametimes_lap(renderer->frame_times, FRAME_STAGE_TEXTURES, lap);
+
+	WallLayout layout;
+	layout_wall(renderer, winstate, num_boards, &layout);
+	update_wall(renderer, boards, &layout);
+	upload_arena_flush(render_state->uploads, cmd);
+
+	lap = record_wall(renderer, cmd, winstate, swapchainTexture, &layout, lap);
+
+	upload_arena_submit(render_state->uploads, cmd);
+	if (renderer->headless)
+	{
+		download_frame(renderer, windownum);
+	}
+	frametimes_lap(renderer->frame_times, FRAME_STAGE_SUBMIT, lap);
+
+	renderer->frames += 1;
+}
+
+void
+renderer_scroll_wall(Renderer* renderer, int rows)
+{
+	renderer->wall.first_row += rows;
+}
+
+static SDL_GPUShader*
+load_shader(Renderer* renderer, bool is_vertex)
+{
+	SDL_GPUDevice* gpu_device = renderer->gpu_device;
+	RenderState* render_state = &renderer->render_state;
+
+	SDL_GPUShaderCreateInfo createinfo;
+	createinfo.num_samplers = 0;
+	createinfo.num_storage_buffers = 0;
+	createinfo.num_storage_textures = 0;
+	createinfo.num_uniform_buffers = is_vertex ? 1 : 0;
+	createinfo.props = 0;
+
+	SDL_GPUShaderFormat format = SDL_GetGPUShaderFormats(gpu_device);
+	if (format & SDL_GPU_SHADERFORMAT_DXBC) {
+		createinfo.format = SDL_GPU_SHADERFORMAT_DXBC;
+		createinfo.code = is_vertex ? D3D11_CubeVert : D3D11_CubeFrag;
+		createinfo.code_size = is_vertex ? SDL_arraysize(D3D11_CubeVert) : SDL_arraysize(D3D11_CubeFrag);
+		createinfo.entrypoint = is_vertex ? "VSMain" : "PSMain";
+	}
+	else if (format & SDL_GPU_SHADERFORMAT_DXIL) {
+		createinfo.format = SDL_GPU_SHADERFORMAT_DXIL;
+		createinfo.code = is_vertex ? D3D12_CubeVert : D3D12_CubeFrag;
+		createinfo.code_size = is_vertex ? SDL_arraysize(D3D12_CubeVert) : SDL_arraysize(D3D12_CubeFrag);
+		createinfo.entrypoint = is_vertex ? "VSMain" : "PSMain";
+	}
+	else if (format & SDL_GPU_SHADERFORMAT_METALLIB) {
+		createinfo.format = SDL_GPU_SHADERFORMAT_METALLIB;
+		createinfo.code = is_vertex ? cube_vert_metallib : cube_frag_metallib;
+		createinfo.code_size = is_vertex ? cube_vert_metallib_len : cube_frag_metallib_len;
+		createinfo.entrypoint = is_vertex ? "vs_main" : "fs_main";
+	}
+	else {
+		createinfo.format = SDL_GPU_SHADERFORMAT_SPIRV;
+		createinfo.code = is_vertex ? cube_vert_spv : cube_frag_spv;
+		createinfo.code_size = is_vertex ? cube_vert_spv_len : cube_frag_spv_len;
+		createinfo.entrypoint = "main";
+	}
+
+	createinfo.stage = is_vertex ? SDL_GPU_SHADERSTAGE_VERTEX : SDL_GPU_SHADERSTAGE_FRAGMENT;
+	return SDL_CreateGPUShader(gpu_device, &createinfo);
+}
+
+/*
+ * Everything the first game frame needs that can be done off the main
+ * thread: the shaders, buffers and pipeline, and the upload of the static
+ * index data. Sets loaded to 1 when done, -1 if anything failed.
+ */
+static int SDLCALL
+load_thread(void* data)
+{
+	SDL_GPUCommandBuffer* cmd;
+	Uint16* map;
+	SDL_GPUTransferBufferLocation buf_location;
+	SDL_GPUBufferCreateInfo buffer_desc;
+	SDL_GPUGraphicsPipelineCreateInfo pipelinedesc;
+	SDL_GPUColorTargetDescription color_target_desc;
+	SDL_GPUVertexAttribute vertex_attributes[2];
+	SDL_GPUVertexBufferDescription vertex_buffer_desc;
+	SDL_GPUShader* vertex_shader;
+	SDL_GPUShader* fragment_shader;
+
+	Renderer* renderer = data;
+	Uint32 num_vertices = renderer->mesh.num_vertices;
+	Uint32 num_indices = renderer->mesh.num_indices;
+	Uint32 index_size = MAX_BOARD_CELLS * num_indices * sizeof(Uint16);
+
+	/* Create shaders */
+
+	vertex_shader = load_shader(renderer, true);
+	CHECK_CREATE(vertex_shader, "Vertex Shader");
+	fragment_shader = load_shader(renderer, false);
+	CHECK_CREATE(fragment_shader, "Fragment Shader");
+	startup_mark("shaders loaded");
+
+	/* Create buffers */
+
+	buffer_desc.usage = SDL_GPU_BUFFERUSAGE_VERTEX;
+	buffer_desc.size = renderer->num_windows * PIECE_CELLS * renderer->cell_size;
+	buffer_desc.props = 0;
+	renderer->render_state.buf_vertex = SDL_CreateGPUBuffer(
+		renderer->gpu_device,
+		&buffer_desc
+	);
+	CHECK_CREATE(renderer->render_state.buf_vertex, "Piece vertex buffer");
+
+	buffer_desc.usage = SDL_GPU_BUFFERUSAGE_VERTEX;
+	buffer_desc.size = MAX_BOARD_CELLS * renderer->cell_size;
+	buffer_desc.props = 0;
+	renderer->render_state.buf_stack = SDL_CreateGPUBuffer(
+		renderer->gpu_device,
+		&buffer_desc
+	);
+	CHECK_CREATE(renderer->render_state.buf_stack, "Stack vertex buffer");
+
+#pragma warning(push)
+#pragma warning(disable: 4566)
+	SDL_SetGPUBufferName(renderer->gpu_device, renderer->render_state.buf_vertex, "космонавт");
+#pragma warning(pop)
+
+	buffer_desc.usage = SDL_GPU_BUFFERUSAGE_INDEX;
+	buffer_desc.size = index_size;
+	buffer_desc.props = 0;
+	renderer->render_state.buf_index = SDL_CreateGPUBuffer(
+		renderer->gpu_device,
+		&buffer_desc
+	);
+	CHECK_CREATE(renderer->render_state.buf_index, "Static index buffer");
+
+	buffer_desc.usage = SDL_GPU_BUFFERUSAGE_INDIRECT;
+	buffer_desc.size = MAX_STACK_DRAWS * sizeof(SDL_GPUIndexedIndirectDrawCommand);
+	buffer_desc.props = 0;
+	renderer->render_state.buf_indirect = SDL_CreateGPUBuffer(
+		renderer->gpu_device,
+		&buffer_desc
+	);
+	CHECK_CREATE(renderer->render_state.buf_indirect, "Stack indirect draw buffer");
+
+	/* Sized for the largest single upload: the whole stack, the indices or every window's piece */
+	Uint32 block_size = SDL_max(MAX_BOARD_CELLS * renderer->cell_size, index_size);
+	block_size = SDL_max(block_size, renderer->num_windows * PIECE_CELLS * renderer->cell_size);
+	renderer->render_state.uploads = upload_arena_create(renderer->gpu_device, SDL_max(UPLOAD_BLOCK_SIZE, block_size), UPLOAD_BLOCKS);
+	CHECK_CREATE(renderer->render_state.uploads, "Upload arena");
+
+	/* We just need to upload the static data once. Cell i uses the mesh's vertices from i * num_vertices on. */
+	map = upload_arena_alloc(renderer->render_state.uploads, index_size, 16, &buf_location);
+	CHECK_CREATE(map, "Index upload");
+	for (Uint32 i = 0; map && i < MAX_BOARD_CELLS; ++i)
+	{
+		for (Uint32 j = 0; j < num_indices; ++j)
+		{
+			map[i * num_indices + j] = (Uint16)(i * num_vertices + renderer->mesh.indices[j]);
+		}
+	}
+
+	cmd = SDL_AcquireGPUCommandBuffer(renderer->gpu_device);
+	if (!upload_arena_copy(renderer->render_state.uploads, &buf_location, renderer->render_state.buf_index, 0, index_size, false)) {
+		SDL_Log("Failed to upload the indices: %s", SDL_GetError());
+	}
+	upload_arena_flush(renderer->render_state.uploads, cmd);
+	upload_arena_submit(renderer->render_state.uploads, cmd);
+	startup_mark("initial upload submitted");
+
+	/* Set up the graphics pipeline */
+
+	SDL_zero(pipelinedesc);
+	SDL_zero(color_target_desc);
+
+	color_target_desc.format = renderer->target_format;
+
+	pipelinedesc.target_info.num_color_targets = 1;
+	pipelinedesc.target_info.color_target_descriptions = &color_target_desc;
+	pipelinedesc.target_info.depth_stencil_format = SDL_GPU_TEXTUREFORMAT_D16_UNORM;
+	pipelinedesc.target_info.has_depth_stencil_target = true;
+
+	pipelinedesc.depth_stencil_state.enable_depth_test = true;
+	pipelinedesc.depth_stencil_state.enable_depth_write = true;
+	pipelinedesc.depth_stencil_state.compare_op = SDL_GPU_COMPAREOP_LESS_OR_EQUAL;
+
+	pipelinedesc.multisample_state.sample_count = renderer->render_state.sample_count;
+
+	pipelinedesc.primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST;
+
+	pipelinedesc.vertex_shader = vertex_shader;
+	pipelinedesc.fragment_shader = fragment_shader;
+
+	vertex_buffer_desc.slot = 0;
+	vertex_buffer_desc.input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
+	vertex_buffer_desc.instance_step_rate = 0;
+	vertex_buffer_desc.pitch = renderer->vertex_size;
+
+	/* Laid out as the mesh file says; the shaders read any of these formats as float3 */
+	vertex_attributes[0].buffer_slot = 0;
+	vertex_attributes[0].format = mesh_format_to_gpu(renderer->position_format);
+	vertex_attributes[0].location = 0;
+	vertex_attributes[0].offset = 0;
+
+	vertex_attributes[1].buffer_slot = 0;
+	vertex_attributes[1].format = mesh_format_to_gpu(renderer->color_format);
+	vertex_attributes[1].location = 1;
+	vertex_attributes[1].offset = mesh_format_size(renderer->position_format);
+
+	pipelinedesc.vertex_input_state.num_vertex_buffers = 1;
+	pipelinedesc.vertex_input_state.vertex_buffer_descriptions = &vertex_buffer_desc;
+	pipelinedesc.vertex_input_state.num_vertex_attributes = 2;
+	pipelinedesc.vertex_input_state.vertex_attributes = (SDL_GPUVertexAttribute*)&vertex_attributes;
+
+	pipelinedesc.props = 0;
+
+	renderer->render_state.pipeline = SDL_CreateGPUGraphicsPipeline(renderer->gpu_device, &pipelinedesc);
+	CHECK_CREATE(renderer->render_state.pipeline, "Render Pipeline");
+
+	/* These are reference-counted; once the pipeline is created, you don't need to keep these. */
+	SDL_ReleaseGPUShader(renderer->gpu_device, vertex_shader);
+	SDL_ReleaseGPUShader(renderer->gpu_device, fragment_shader);
+	startup_mark("pipeline created");
+
+	bool loaded = renderer->render_state.buf_vertex && renderer->render_state.buf_stack &&
+		renderer->render_state.buf_index && renderer->render_state.buf_indirect && renderer->render_state.uploads && map && renderer->render_state.pipeline;
+	SDL_SetAtomicInt(&renderer->loaded, loaded ? 1 : -1);
+	return loaded ? 0 : -1;
+}
+
+/* Takes the cell mesh and its vertex layout from mesh, or the built-in one if NULL */
+static bool
+set_mesh(Renderer* renderer, const Mesh* mesh, int lod)
+{
+	Mesh* builtin = NULL;
+	if (!mesh)
+	{
+		mesh = builtin = mesh_create_builtin();
+		if (!mesh)
+		{
+			return false;
+		}
+	}
+	mesh_get_lod(mesh, lod, &renderer->mesh);
+	renderer->position_format = mesh_position_format(mesh);
+	renderer->color_format = mesh_color_format(mesh);
+	renderer->vertex_size = mesh_format_size(renderer->position_format) + mesh_format_size(renderer->color_format);
+	renderer->cell_size = renderer->mesh.num_vertices * renderer->vertex_size;
+	renderer->position_range = renderer->position_format == MESH_FORMAT_BYTE4_NORM ? BYTE_POSITION_RANGE : 1.0f;
+	mesh_close(builtin);
+
+	SDL_Log("Cell mesh: %u vertices, %u indices, %u bytes per vertex",
+		renderer->mesh.num_vertices, renderer->mesh.num_indices, renderer->vertex_size);
+	return true;
+}
+
+static Renderer*
+create_renderer(const char* gpudriver, SDL_Window** windows, int num_windows, int msaa, const Mesh* mesh, int lod, bool headless)
+{
+	Uint32 drawablew, drawableh;
+
+	Renderer* renderer = SDL_calloc(1, sizeof(Renderer));
+	if (!renderer)
+	{
+		return NULL;
+	}
+	renderer->windows = windows;
+	renderer->num_windows = num_windows;
+	renderer->headless = headless;
+
+	if (!set_mesh(renderer, mesh, lod))
+	{
+		SDL_Log("Failed to set up the cell mesh: %s", SDL_GetError());
+		renderer_destroy(renderer);
+		return NULL;
+	}
+
+	renderer->gpu_device = SDL_CreateGPUDevice(
+		TESTGPU_SUPPORTED_FORMATS,
+		true,
+		gpudriver
+	);
+	if (!renderer->gpu_device) {
+		SDL_Log("Failed to create GPU device: %s", SDL_GetError());
+		renderer_destroy(renderer);
+		return NULL;
+	}
+	startup_mark("GPU device created");
+
+	/* Claim the windows; headless ones only give the size of their frames */
+	for (int i = 0; i < renderer->num_windows && !headless; ++i) {
+		if (!SDL_ClaimWindowForGPUDevice(
+			renderer->gpu_device,
+			renderer->windows[i]
+		)) {
+			SDL_Log("Failed to claim window: %s", SDL_GetError());
+			renderer_destroy(renderer);
+			return NULL;
+		}
+	}
+	startup_mark("windows claimed");
+	renderer->target_format = headless ? HEADLESS_FORMAT : SDL_GetGPUSwapchainTextureFormat(renderer->gpu_device, renderer->windows[0]);
+
+	/* Determine which sample count to use: the highest one up to msaa that the color and depth targets support */
+	renderer->render_state.sample_count = SDL_GPU_SAMPLECOUNT_1;
+	for (SDL_GPUSampleCount count = SDL_GPU_SAMPLECOUNT_8; count > SDL_GPU_SAMPLECOUNT_1; --count) {
+		if (msaa >= 1 << count &&
+			SDL_GPUTextureSupportsSampleCount(renderer->gpu_device, renderer->target_format, count) &&
+			SDL_GPUTextureSupportsSampleCount(renderer->gpu_device, SDL_GPU_TEXTUREFORMAT_D16_UNORM, count)) {
+			renderer->render_state.sample_count = count;
+			break;
+		}
+	}
+
+	/* SDL_gpu lets any swapchain texture be a resolve target, so the blit is only ever asked for */
+	renderer->render_state.msaa_blit = false;
+	if (msaa > 1) {
+		SDL_Log("MSAA: %dx asked for, %dx used, %s", msaa, 1 << renderer->render_state.sample_count,
+			renderer->render_state.msaa_blit ? "resolved into a texture and blitted" :
+			headless ? "resolved into the color target" : "resolved into the swapchain");
+	}
+
+	renderer->render_state.targets = target_pool_create(renderer->gpu_device);
+	CHECK_CREATE(renderer->render_state.targets, "Render target pool");
+
+	/* Set up per-window state */
+	renderer->window_states = (WindowState*)SDL_calloc(renderer->num_windows, sizeof(WindowState));
+	renderer->jobs = (VertexJob*)SDL_calloc(renderer->num_windows, sizeof(VertexJob));
+	if (!renderer->window_states || !renderer->jobs)
+	{
+		SDL_Log("Out of memory!\n");
+		renderer_destroy(renderer);
+		return NULL;
+	}
+
+	for (int i = 0; i < renderer->num_windows; ++i)
+	{
+		WindowState* winstate = &renderer->window_states[i];
+
+		/* take the window's targets from the pool */
+		SDL_GetWindowSizeInPixels(renderer->windows[i], (int*)&drawablew, (int*)&drawableh);
+		resize_window_targets(renderer, winstate, drawablew, drawableh);
+
+		/* make each window different */
+		winstate->angle_x = (i * 10) % 360;
+		winstate->angle_y = (i * 20) % 360;
+		winstate->angle_z = (i * 30) % 360;
+	}
+
+	startup_mark("render targets created");
+
+	/* The rest goes on in the background; until it is done, frames are only cleared */
+	renderer->loader = SDL_CreateThread(load_thread, "renderload", renderer);
+	if (!renderer->loader)
+	{
+		load_thread(renderer);
+		renderer->ready = SDL_GetAtomicInt(&renderer->loaded) > 0;
+	}
+
+	return renderer;
+}
+
+Renderer*
+renderer_create(const char* gpudriver, SDL_Window** windows, int num_windows, int msaa, const Mesh* mesh, int lod)
+{
+	return create_renderer(gpudriver, windows, num_windows, msaa, mesh, lod, false);
+}
+
+Renderer*
+renderer_create_headless(const char* gpudriver, SDL_Window** windows, int num_windows, int msaa, const Mesh* mesh, int lod)
+{
+	return create_renderer(gpudriver, windows, num_windows, msaa, mesh, lod, true);
+}
+
+void
+renderer_destroy(Renderer* renderer)
+{
+	if (!renderer) {
+		return;
+	}
+
+	if (renderer->loader) {
+		SDL_WaitThread(renderer->loader, NULL);
+	}
+	if (renderer->workers) {
+		SDL_SetAtomicInt(&renderer->quit, 1);
+		for (int i = 0; i < renderer->num_workers; ++i) {
+			SDL_SignalSemaphore(renderer->start);
+		}
+		for (int i = 0; i < renderer->num_workers; ++i) {
+			SDL_WaitThread(renderer->workers[i], NULL);
+		}
+		SDL_free(renderer->workers);
+	}
+	SDL_DestroySemaphore(renderer->start);
+	SDL_DestroySemaphore(renderer->done);
+	SDL_free(renderer->jobs);
+
+	while (renderer->num_frame_fences > 0) {
+		retire_frame(renderer);
+	}
+	if (renderer->skipped_frames > 0) {
+		SDL_Log("%u frames skipped, no swapchain texture to draw into", renderer->skipped_frames);
+	}
+
+	if (renderer->window_states) {
+		int i;
+		renderer_finish_frames(renderer);
+		for (i = 0; i < renderer->num_windows; i++) {
+			for (int j = 0; j < FRAME_DOWNLOADS; ++j) {
+				SDL_ReleaseGPUTransferBuffer(renderer->gpu_device, renderer->window_states[i].downloads[j].buffer);
+			}
+			if (!renderer->headless) {
+				SDL_ReleaseWindowFromGPUDevice(renderer->gpu_device, renderer->windows[i]);
+			}
+		}
+		SDL_free(renderer->window_states);
+		renderer->window_states = NULL;
+	}
+
+	SDL_ReleaseGPUBuffer(renderer->gpu_device, renderer->render_state.buf_vertex);
+	SDL_ReleaseGPUBuffer(renderer->gpu_device, renderer->render_state.buf_stack);
+	SDL_ReleaseGPUBuffer(renderer->gpu_device, renderer->render_state.buf_index);
+	SDL_ReleaseGPUBuffer(renderer->gpu_device, renderer->render_state.buf_indirect);
+	SDL_ReleaseGPUBuffer(renderer->gpu_device, renderer->wall.buf_stacks);
+	SDL_ReleaseGPUBuffer(renderer->gpu_device, renderer->wall.buf_draws);
+	SDL_ReleaseGPUBuffer(renderer->gpu_device, renderer->wall.buf_pieces);
+	SDL_free(renderer->wall.boards);
+	upload_arena_destroy(renderer->render_state.uploads);
+	if (renderer->render_state.targets) {
+		TargetPoolStats stats;
+		target_pool_get_stats(renderer->render_state.targets, &stats);
+		SDL_Log("Render targets: %u created, %u released, %u allocations avoided (%u kept while resizing, %u reused)",
+			stats.created, stats.released, stats.kept + stats.reused, stats.kept, stats.reused);
+		target_pool_destroy(renderer->render_state.targets);
+	}
+	SDL_ReleaseGPUGraphicsPipeline(renderer->gpu_device, renderer->render_state.pipeline);
+	SDL_DestroyGPUDevice(renderer->gpu_device);
+	SDL_free(renderer);
+}
+
+int
+renderer_get_msaa(Renderer* renderer)
+{
+	return 1 << renderer->render_state.sample_count;
+}
+
+void
+renderer_set_msaa_blit(Renderer* renderer, bool blit)
+{
+	RenderState* render_state = &renderer->render_state;
+	if (renderer->headless) {
+		return;
+	}
+	render_state->msaa_blit = blit;
+
+	/* Refit now rather than on the next resize: MSAA targets change between pooled and exact sizes */
+	for (int i = 0; i < renderer->num_windows; ++i) {
+		WindowState* winstate = &renderer->window_states[i];
+		target_pool_return(render_state->targets, &winstate->tex_msaa);
+		target_pool_return(render_state->targets, &winstate->tex_resolve);
+		FitMSAATexture(renderer, &winstate->tex_msaa, winstate->prev_drawablew, winstate->prev_drawableh, true);
+		FitResolveTexture(renderer, &winstate->tex_resolve, winstate->prev_drawablew, winstate->prev_drawableh, true);
+	}
+}
+
+bool
+renderer_set_present_mode(Renderer* renderer, SDL_GPUPresentMode mode)
+{
+	if (renderer->headless) {
+		return true;
+	}
+	for (int i = 0; i < renderer->num_windows; ++i) {
+		if (!SDL_WindowSupportsGPUPresentMode(renderer->gpu_device, renderer->windows[i], mode)) {
+			return SDL_SetError("Present mode %d is not supported", (int)mode);
+		}
+	}
+	for (int i = 0; i < renderer->num_windows; ++i) {
+		if (!SDL_SetGPUSwapchainParameters(renderer->gpu_device, renderer->windows[i], SDL_GPU_SWAPCHAINCOMPOSITION_SDR, mode)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+renderer_set_frames_in_flight(Renderer* renderer, int frames)
+{
+	renderer->frames_in_flight = SDL_clamp(frames, 0, MAX_FRAMES_IN_FLIGHT);
+}
+
+void
+renderer_begin_frame(Renderer* renderer)
+{
+	/* Once per frame however many windows it draws, so pooled targets age in frames */
+	target_pool_end_frame(renderer->render_state.targets);
+	if (renderer->frames_in_flight == 0) {
+		return;
+	}
+	Uint64 lap = frametimes_now(renderer->frame_times);
+
+	/* An empty submit fences everything submitted for the previous frame, the GPU runs them in order */
+	SDL_GPUCommandBuffer* cmd = SDL_AcquireGPUCommandBuffer(renderer->gpu_device);
+	SDL_GPUFence* fence = cmd ? SDL_SubmitGPUCommandBufferAndAcquireFence(cmd) : NULL;
+	if (fence) {
+		renderer->frame_fences[renderer->num_frame_fences++] = fence;
+	}
+
+	/* The new frame makes one more in flight */
+	while (renderer->num_frame_fences > renderer->frames_in_flight - 1) {
+		retire_frame(renderer);
+	}
+	frametimes_lap(renderer->frame_times, FRAME_STAGE_ACQUIRE, lap);
+}
+
+void
+renderer_set_frame_times(Renderer* renderer, FrameTimes* times)
+{
+	renderer->frame_times = times;
+}
+
+void
+renderer_set_frame_callback(Renderer* renderer, RendererFrameFunc func, void* userdata)
+{
+	renderer_finish_frames(renderer);
+	renderer->frame_func = func;
+	renderer->frame_userdata = userdata;
+}
+
+void
+renderer_finish_frames(Renderer* renderer)
+{
+	for (int i = 0; i < renderer->num_windows; ++i)
+	{
+		WindowState* winstate = &renderer->window_states[i];
+		for (int j = 0; j < FRAME_DOWNLOADS; ++j)
+		{
+			/* Oldest first */
+			FrameDownload* download = &winstate->downloads[(winstate->next_download + j) % FRAME_DOWNLOADS];
+			if (download->fence)
+			{
+				deliver_download(renderer, i, download);
+			}
+		}
+	}
+}
+
+bool
+renderer_is_ready(Renderer* renderer)
+{
+	return finish_loading(renderer, false);
+}
+
+bool
+renderer_wait_ready(Renderer* renderer)
+{
+	return finish_loading(renderer, true);
+}
+
+void
+renderer_get_target_stats(Renderer* renderer, TargetPoolStats* stats)
+{
+	target_pool_get_stats(renderer->render_state.targets, stats);
+}
+
+void
+renderer_set_direct_stack(Renderer* renderer, bool direct)
+{
+	renderer->direct_stack = direct;
+}
+
+void
+renderer_set_mirrored(Renderer* renderer, bool mirrored)
+{
+	renderer->mirrored = mirrored;
+}
+
+bool
+renderer_start_workers(Renderer* renderer, int num_threads)
+{
+	if (renderer->workers) {
+		SDL_SetError("Render workers already started");
+		return false;
+	}
+	if (num_threads <= 0) {
+		num_threads = SDL_max(SDL_GetNumLogicalCPUCores() - 1, 1);
+	}
+
+	renderer->start = SDL_CreateSemaphore(0);
+	renderer->done = SDL_CreateSemaphore(0);
+	renderer->workers = (SDL_Thread**)SDL_calloc(num_threads, sizeof(SDL_Thread*));
+	if (!renderer->start || !renderer->done || !renderer->workers) {
+		return false;
+	}
+	for (int i = 0; i < num_threads; ++i) {
+		renderer->workers[i] = SDL_CreateThread(worker_thread, "render", renderer);
+		if (!renderer->workers[i]) {
+			return false;
+		}
+		renderer->num_workers += 1;
+	}
+	return true;
+}
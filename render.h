@@ -0,0 +1,144 @@
+/*
+ * Draws a game as spinning cubes into one or more windows with SDL_gpu.
+ * Used by sdlgputest and, headless, by sdlgputest_bench.
+ */
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_video.h>
+
+#include "frametimes.h"
+#include "mesh.h"
+#include "targetpool.h"
+#include "tetris.h"
+
+typedef struct Renderer Renderer;
+
+/*
+ * Creates a GPU device for the named driver (NULL picks one) and claims
+ * the windows. Shaders, buffers and the pipeline are set up on a thread of
+ * their own; until they are ready the draw functions only clear the
+ * windows. msaa asks for that many samples, 2, 4 or 8 (0 or 1 for
+ * none); the most up to that which the GPU supports are used. Every cell
+ * is drawn as the given level of detail of mesh, which is only read here;
+ * NULL uses the built-in one. The windows array must stay valid until
+ * renderer_destroy.
+ */
+Renderer* renderer_create(const char* gpudriver, SDL_Window** windows, int num_windows, int msaa, const Mesh* mesh, int lod);
+
+/*
+ * Like renderer_create, but without swapchains: each window's frames are
+ * drawn into an RGBA8 texture of its size and never presented, so nothing
+ * waits for vsync. The windows are not claimed, only their sizes are
+ * used, so ones of the offscreen video driver will do.
+ */
+Renderer* renderer_create_headless(const char* gpudriver, SDL_Window** windows, int num_windows, int msaa, const Mesh* mesh, int lod);
+
+/* Whether frames show the game yet, false while loading or if loading failed */
+bool renderer_is_ready(Renderer* renderer);
+
+/* Waits for the loader thread. Returns false if loading failed. */
+bool renderer_wait_ready(Renderer* renderer);
+
+/* Releases the windows from the GPU device and destroys it */
+void renderer_destroy(Renderer* renderer);
+
+/* Records and submits one frame of the game for one window */
+void renderer_draw(Renderer* renderer, int window_index, const Tetris* tetris);
+
+/*
+ * Records one frame of the game for every window into a single command
+ * buffer and submits it once. The board is read once for all windows.
+ */
+void renderer_draw_all(Renderer* renderer, const Tetris* tetris);
+
+/*
+ * Records one frame showing every one of num_boards games at once, each
+ * in a viewport of its own, in a grid filling the window. When they would
+ * be too small to make out, the grid keeps a minimum size and scrolls, see
+ * renderer_scroll_wall; only the boards on screen are uploaded, and only
+ * as much of those per frame as a fixed budget allows, so a wall of
+ * hundreds costs about what a handful of boards do.
+ */
+void renderer_draw_wall(Renderer* renderer, int window_index, const Tetris* boards, Uint32 num_boards);
+
+/* Scrolls the wall by rows of boards, down for positive; clamped when drawn */
+void renderer_scroll_wall(Renderer* renderer, int rows);
+
+/*
+ * With mirrored set, renderer_draw_all shows the first window's view in
+ * every window, so the board vertices are written and uploaded only once.
+ */
+void renderer_set_mirrored(Renderer* renderer, bool mirrored);
+
+/*
+ * The locked cells are drawn indirectly, one command per run of occupied
+ * slots built when the board changes. With direct set they are drawn as
+ * one plain draw over every slot up to the highest row, empty ones too.
+ */
+void renderer_set_direct_stack(Renderer* renderer, bool direct);
+
+/*
+ * Lets renderer_draw_all write each window's vertices on num_threads
+ * helper threads as well (<= 0 for one per spare core). Call once.
+ */
+bool renderer_start_workers(Renderer* renderer, int num_threads);
+
+/* Samples per pixel in use, 1 without MSAA */
+int renderer_get_msaa(Renderer* renderer);
+
+/*
+ * MSAA frames resolve straight into the swapchain texture, which SDL_gpu
+ * always allows. With blit set they resolve into a texture of their own
+ * that is then blitted to the swapchain, which costs that texture's
+ * memory and a blit per window per frame. Headless frames always resolve
+ * straight into their color target.
+ */
+void renderer_set_msaa_blit(Renderer* renderer, bool blit);
+
+/* How often the depth, MSAA and resolve targets were allocated or spared so far */
+void renderer_get_target_stats(Renderer* renderer, TargetPoolStats* stats);
+
+/*
+ * Receives a headless frame: width * height RGBA8 pixels, rows top to
+ * bottom and tightly packed, valid during the call. frame counts the
+ * window's frames showing the game, from 0.
+ */
+typedef void (*RendererFrameFunc)(void* userdata, int window_index, Uint64 frame, const Uint8* pixels, Uint32 width, Uint32 height);
+
+/*
+ * Downloads every frame a headless renderer draws from now on and passes
+ * it to func, NULL to stop. Downloads overlap with the following frames,
+ * so func runs a few frames late, in order for each window.
+ */
+void renderer_set_frame_callback(Renderer* renderer, RendererFrameFunc func, void* userdata);
+
+/* Waits for the frames still being downloaded and passes them on. renderer_destroy does too. */
+void renderer_finish_frames(Renderer* renderer);
+
+/*
+ * Sets how windows present, for every window. Returns false, leaving
+ * vsync on, if one of them does not support mode. Does nothing headless.
+ */
+bool renderer_set_present_mode(Renderer* renderer, SDL_GPUPresentMode mode);
+
+/*
+ * Lets at most frames (1 to 3) frames be queued on the GPU at once, fewer
+ * trading throughput for latency; 0, the default, leaves it to SDL. The
+ * limit is kept by renderer_begin_frame.
+ */
+void renderer_set_frames_in_flight(Renderer* renderer, int frames);
+
+/*
+ * Waits until the GPU has room for another frame under the frames in
+ * flight limit. Call once per frame, before reading the state to draw, so
+ * the frame shows input as fresh as the limit allows; without a limit it
+ * still ages the render targets kept for resizes.
+ */
+void renderer_begin_frame(Renderer* renderer);
+
+/* Adds the time of each render stage to the current frame of times, NULL to stop */
+void renderer_set_frame_times(Renderer* renderer, FrameTimes* times);
+
+#endif /* RENDER_H */
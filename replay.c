@@ -0,0 +1,516 @@
+#include "replay.h"
+#include "mapfile.h"
+
+#include <SDL3/SDL_endian.h>
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_iostream.h>
+
+#include <stddef.h>
+
+#define REPLAY_MAGIC 0x31505254u         /* "TRP1" */
+#define REPLAY_TRAILER_MAGIC 0x58505254u /* "TRPX" */
+#define REPLAY_VERSION 1
+
+#define REPLAY_HEADER_SIZE 16
+#define REPLAY_TRAILER_SIZE 24
+#define REPLAY_INDEX_ENTRY_SIZE 16
+
+/* Room for one record: a 64-bit varint */
+#define REPLAY_MAX_RECORD 10
+
+/* Everything up to and including piece, leaving out the tail padding */
+#define REPLAY_STATE_BYTES (offsetof(Tetris, piece) + 1)
+
+typedef struct ReplayBlockIndex
+{
+	Uint64 tick;
+	Uint64 offset;
+} ReplayBlockIndex;
+
+struct ReplayWriter
+{
+	SDL_IOStream* io;
+	Uint32 keyframe_interval;
+	bool failed;
+
+	Uint64 offset; /* bytes written so far */
+	Uint64 tick;   /* ticks recorded so far */
+
+	/* Block being recorded */
+	Tetris keyframe;
+	Uint32 block_ticks;
+	Uint64 prev_dt;
+	Uint8* records;
+	size_t num_records_bytes;
+	size_t records_capacity;
+
+	ReplayBlockIndex* blocks;
+	Uint32 num_blocks;
+	Uint32 blocks_capacity;
+};
+
+struct Replay
+{
+	const Uint8* data;
+	size_t size;
+	Uint64 num_ticks;
+	Uint32 num_blocks;
+	const Uint8* index;
+	Uint32 state_size;
+	MappedFile file;
+};
+
+static void
+put_u32(Uint8* out, Uint32 value)
+{
+	value = SDL_Swap32LE(value);
+	SDL_memcpy(out, &value, 4);
+}
+
+static void
+put_u64(Uint8* out, Uint64 value)
+{
+	value = SDL_Swap64LE(value);
+	SDL_memcpy(out, &value, 8);
+}
+
+static Uint32
+get_u32(const Uint8* in)
+{
+	Uint32 value;
+	SDL_memcpy(&value, in, 4);
+	return SDL_Swap32LE(value);
+}
+
+static Uint64
+get_u64(const Uint8* in)
+{
+	Uint64 value;
+	SDL_memcpy(&value, in, 8);
+	return SDL_Swap64LE(value);
+}
+
+static int
+put_varint(Uint8* out, Uint64 value)
+{
+	int length = 0;
+	while (value >= 0x80)
+	{
+		out[length++] = (Uint8)(value | 0x80);
+		value >>= 7;
+	}
+	out[length++] = (Uint8)value;
+	return length;
+}
+
+/* Returns NULL on a truncated or overlong varint */
+static const Uint8*
+get_varint(const Uint8* in, const Uint8* end, Uint64* value)
+{
+	Uint64 result = 0;
+	for (int shift = 0; shift < 64 && in < end; shift += 7)
+	{
+		Uint8 byte = *in++;
+		result |= (Uint64)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			*value = result;
+			return in;
+		}
+	}
+	return NULL;
+}
+
+static void
+write_bytes(ReplayWriter* writer, const void* data, size_t size)
+{
+	if (!writer->failed && SDL_WriteIO(writer->io, data, size) != size)
+	{
+		writer->failed = true;
+	}
+	writer->offset += size;
+}
+
+/* Writes out the block recorded so far, if any */
+static void
+flush_block(ReplayWriter* writer)
+{
+	if (writer->block_ticks == 0)
+	{
+		return;
+	}
+
+	if (writer->num_blocks == writer->blocks_capacity)
+	{
+		Uint32 capacity = writer->blocks_capacity ? writer->blocks_capacity * 2 : 64;
+		ReplayBlockIndex* blocks = SDL_realloc(writer->blocks, capacity * sizeof(ReplayBlockIndex));
+		if (!blocks)
+		{
+			writer->failed = true;
+			return;
+		}
+		writer->blocks = blocks;
+		writer->blocks_capacity = capacity;
+	}
+
+	Uint64 first_tick = writer->tick - writer->block_ticks;
+	writer->blocks[writer->num_blocks].tick = first_tick;
+	writer->blocks[writer->num_blocks].offset = writer->offset;
+	writer->num_blocks += 1;
+
+	Uint8 header[8];
+	put_u64(header, first_tick);
+	write_bytes(writer, header, 8);
+	write_bytes(writer, &writer->keyframe, REPLAY_STATE_BYTES);
+	put_u32(header, (Uint32)writer->num_records_bytes);
+	write_bytes(writer, header, 4);
+	write_bytes(writer, writer->records, writer->num_records_bytes);
+
+	writer->block_ticks = 0;
+	writer->num_records_bytes = 0;
+	writer->prev_dt = 0;
+}
+
+ReplayWriter*
+replay_writer_open(const char* path, Uint32 keyframe_interval)
+{
+	ReplayWriter* writer = SDL_calloc(1, sizeof(ReplayWriter));
+	if (!writer)
+	{
+		return NULL;
+	}
+
+	writer->keyframe_interval = keyframe_interval ? keyframe_interval : REPLAY_DEFAULT_KEYFRAME_INTERVAL;
+	writer->io = SDL_IOFromFile(path, "wb");
+	if (!writer->io)
+	{
+		SDL_free(writer);
+		return NULL;
+	}
+
+	Uint8 header[REPLAY_HEADER_SIZE];
+	put_u32(header + 0, REPLAY_MAGIC);
+	put_u32(header + 4, REPLAY_VERSION);
+	put_u32(header + 8, (Uint32)REPLAY_STATE_BYTES);
+	put_u32(header + 12, writer->keyframe_interval);
+	write_bytes(writer, header, sizeof(header));
+	return writer;
+}
+
+void
+replay_record_tick(ReplayWriter* writer, const Tetris* tetris, Uint32 inputs, Uint64 dt_ns)
+{
+	if (writer->block_ticks == writer->keyframe_interval)
+	{
+		flush_block(writer);
+	}
+	if (writer->block_ticks == 0)
+	{
+		writer->keyframe = *tetris;
+	}
+
+	if (writer->records_capacity - writer->num_records_bytes < REPLAY_MAX_RECORD)
+	{
+		size_t capacity = writer->records_capacity ? writer->records_capacity * 2 : 4096;
+		Uint8* records = SDL_realloc(writer->records, capacity);
+		if (!records)
+		{
+			writer->failed = true;
+			return;
+		}
+		writer->records = records;
+		writer->records_capacity = capacity;
+	}
+
+	Uint64 record = inputs & 0x1F;
+	if (dt_ns != 0)
+	{
+		Sint64 delta = (Sint64)(dt_ns - writer->prev_dt);
+		Uint64 zigzag = ((Uint64)delta << 1) ^ (Uint64)(delta >> 63);
+		record |= 0x20 | zigzag << 6;
+		writer->prev_dt = dt_ns;
+	}
+	writer->num_records_bytes += put_varint(writer->records + writer->num_records_bytes, record);
+	writer->block_ticks += 1;
+	writer->tick += 1;
+}
+
+bool
+replay_writer_close(ReplayWriter* writer)
+{
+	if (!writer)
+	{
+		return false;
+	}
+
+	flush_block(writer);
+
+	Uint64 index_offset = writer->offset;
+	for (Uint32 i = 0; i < writer->num_blocks; ++i)
+	{
+		Uint8 entry[REPLAY_INDEX_ENTRY_SIZE];
+		put_u64(entry + 0, writer->blocks[i].tick);
+		put_u64(entry + 8, writer->blocks[i].offset);
+		write_bytes(writer, entry, sizeof(entry));
+	}
+
+	Uint8 trailer[REPLAY_TRAILER_SIZE];
+	put_u64(trailer + 0, index_offset);
+	put_u64(trailer + 8, writer->tick);
+	put_u32(trailer + 16, writer->num_blocks);
+	put_u32(trailer + 20, REPLAY_TRAILER_MAGIC);
+	write_bytes(writer, trailer, sizeof(trailer));
+
+	bool ok = !writer->failed;
+	if (!SDL_CloseIO(writer->io))
+	{
+		ok = false;
+	}
+	if (writer->failed)
+	{
+		SDL_SetError("Failed to write replay");
+	}
+
+	SDL_free(writer->records);
+	SDL_free(writer->blocks);
+	SDL_free(writer);
+	return ok;
+}
+
+Replay*
+replay_open(const char* path)
+{
+	Replay* replay = SDL_calloc(1, sizeof(Replay));
+	if (!replay)
+	{
+		return NULL;
+	}
+	if (!mapped_file_open(&replay->file, path))
+	{
+		replay_close(replay);
+		return NULL;
+	}
+	replay->data = replay->file.data;
+	replay->size = replay->file.size;
+
+	const Uint8* data = replay->data;
+	if (replay->size < REPLAY_HEADER_SIZE + REPLAY_TRAILER_SIZE ||
+		get_u32(data) != REPLAY_MAGIC ||
+		get_u32(data + replay->size - 4) != REPLAY_TRAILER_MAGIC)
+	{
+		SDL_SetError("%s is not a complete replay", path);
+		replay_close(replay);
+		return NULL;
+	}
+	if (get_u32(data + 4) != REPLAY_VERSION || get_u32(data + 8) != REPLAY_STATE_BYTES)
+	{
+		SDL_SetError("%s was recorded by an incompatible version", path);
+		replay_close(replay);
+		return NULL;
+	}
+
+	const Uint8* trailer = data + replay->size - REPLAY_TRAILER_SIZE;
+	Uint64 index_offset = get_u64(trailer);
+	replay->num_ticks = get_u64(trailer + 8);
+	replay->num_blocks = get_u32(trailer + 16);
+	replay->state_size = get_u32(data + 8);
+	if (index_offset > replay->size - REPLAY_TRAILER_SIZE ||
+		(replay->size - REPLAY_TRAILER_SIZE - index_offset) / REPLAY_INDEX_ENTRY_SIZE != replay->num_blocks)
+	{
+		SDL_SetError("%s has a broken index", path);
+		replay_close(replay);
+		return NULL;
+	}
+	replay->index = data + index_offset;
+
+	/* Block offsets are only trusted once they point inside the blocks */
+	for (Uint32 i = 0; i < replay->num_blocks; ++i)
+	{
+		Uint64 offset = get_u64(replay->index + i * REPLAY_INDEX_ENTRY_SIZE + 8);
+		if (offset < REPLAY_HEADER_SIZE || offset + 12 + replay->state_size > index_offset ||
+			offset + 12 + replay->state_size + get_u32(data + offset + 8 + replay->state_size) > index_offset)
+		{
+			SDL_SetError("%s has a broken block %u", path, i);
+			replay_close(replay);
+			return NULL;
+		}
+	}
+	return replay;
+}
+
+void
+replay_close(Replay* replay)
+{
+	if (!replay)
+	{
+		return;
+	}
+	mapped_file_close(&replay->file);
+	SDL_free(replay);
+}
+
+Uint64
+replay_num_ticks(const Replay* replay)
+{
+	return replay->num_ticks;
+}
+
+static Uint64
+block_tick(const Replay* replay, Uint32 block)
+{
+	return get_u64(replay->index + block * REPLAY_INDEX_ENTRY_SIZE);
+}
+
+/* Points the cursor at the first record of a block and returns its keyframe */
+static const Uint8*
+enter_block(ReplayCursor* cursor, Uint32 block)
+{
+	const Replay* replay = cursor->replay;
+	const Uint8* keyframe = replay->data + get_u64(replay->index + block * REPLAY_INDEX_ENTRY_SIZE + 8) + 8;
+	Uint32 num_bytes = get_u32(keyframe + replay->state_size);
+
+	cursor->block = block;
+	cursor->pos = keyframe + replay->state_size + 4;
+	cursor->end = cursor->pos + num_bytes;
+	cursor->tick = block_tick(replay, block);
+	cursor->prev_dt = 0;
+	return keyframe;
+}
+
+static void
+load_keyframe(const Replay* replay, const Uint8* keyframe, Tetris* tetris)
+{
+	SDL_zerop(tetris);
+	SDL_memcpy(tetris, keyframe, replay->state_size);
+	tetris_update_heights(tetris); /* derived from rows, not stored */
+}
+
+bool
+replay_next(ReplayCursor* cursor, Uint32* inputs, Uint64* dt_ns)
+{
+	if (cursor->pos == cursor->end)
+	{
+		if (cursor->block + 1 >= cursor->replay->num_blocks)
+		{
+			return false;
+		}
+		enter_block(cursor, cursor->block + 1);
+	}
+
+	Uint64 record;
+	const Uint8* next = get_varint(cursor->pos, cursor->end, &record);
+	if (!next)
+	{
+		cursor->pos = cursor->end;
+		cursor->block = cursor->replay->num_blocks;
+		SDL_SetError("Corrupt replay record at tick %" SDL_PRIu64, cursor->tick);
+		return false;
+	}
+	cursor->pos = next;
+	cursor->tick += 1;
+
+	*inputs = (Uint32)(record & 0x1F);
+	*dt_ns = 0;
+	if (record & 0x20)
+	{
+		Uint64 zigzag = record >> 6;
+		Sint64 delta = (Sint64)(zigzag >> 1) ^ -(Sint64)(zigzag & 1);
+		cursor->prev_dt += (Uint64)delta;
+		*dt_ns = cursor->prev_dt;
+	}
+	return true;
+}
+
+bool
+replay_seek(const Replay* replay, Uint64 tick, Tetris* tetris, ReplayCursor* cursor)
+{
+	if (replay->num_blocks == 0 || tick > replay->num_ticks)
+	{
+		SDL_SetError("Tick %" SDL_PRIu64 " is past the end of the replay", tick);
+		return false;
+	}
+
+	/* Last block starting at or before tick */
+	Uint32 lo = 0;
+	Uint32 hi = replay->num_blocks;
+	while (hi - lo > 1)
+	{
+		Uint32 mid = lo + (hi - lo) / 2;
+		if (block_tick(replay, mid) <= tick)
+		{
+			lo = mid;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	ReplayCursor local;
+	if (!cursor)
+	{
+		cursor = &local;
+	}
+	cursor->replay = replay;
+	load_keyframe(replay, enter_block(cursor, lo), tetris);
+
+	while (cursor->tick < tick)
+	{
+		Uint32 inputs;
+		Uint64 dt_ns;
+		if (!replay_next(cursor, &inputs, &dt_ns))
+		{
+			return false;
+		}
+		tetris_tick(tetris, inputs, dt_ns);
+	}
+	return true;
+}
+
+bool
+replay_simulate(const Replay* replay, Tetris* tetris)
+{
+	ReplayCursor cursor;
+	if (!replay_seek(replay, 0, tetris, &cursor))
+	{
+		return false;
+	}
+
+	for (Uint32 block = 0; block < replay->num_blocks; ++block)
+	{
+		if (block > 0)
+		{
+			const Uint8* keyframe = enter_block(&cursor, block);
+			if (SDL_memcmp(tetris, keyframe, replay->state_size) != 0)
+			{
+				SDL_SetError("Replay diverged from its keyframe at tick %" SDL_PRIu64, cursor.tick);
+				return false;
+			}
+		}
+
+		/* Decode the block inline, this is the loop that has to be fast */
+		const Uint8* pos = cursor.pos;
+		const Uint8* end = cursor.end;
+		Uint64 prev_dt = 0;
+		while (pos < end)
+		{
+			Uint64 record;
+			pos = get_varint(pos, end, &record);
+			if (!pos)
+			{
+				SDL_SetError("Corrupt replay record in block %u", block);
+				return false;
+			}
+
+			Uint64 dt_ns = 0;
+			if (record & 0x20)
+			{
+				Uint64 zigzag = record >> 6;
+				prev_dt += (Uint64)((Sint64)(zigzag >> 1) ^ -(Sint64)(zigzag & 1));
+				dt_ns = prev_dt;
+			}
+			tetris_tick(tetris, (Uint32)(record & 0x1F), dt_ns);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,73 @@
+/*
+ * Game recordings. A replay is the sequence of tetris_tick calls of a game,
+ * (inputs, dt_ns) each, varint coded, split into blocks that start with a
+ * full Tetris snapshot so playback can seek to any tick.
+ *
+ * File layout, little endian:
+ *   header:  "TRP1", version, state bytes, keyframe interval (u32 each)
+ *   blocks:  first tick (u64), Tetris snapshot, record bytes (u32), records
+ *   index:   first tick (u64) and file offset (u64) of every block
+ *   trailer: index offset (u64), total ticks (u64), block count (u32), "TRPX"
+ *
+ * The state bytes are offsetof(Tetris, piece) + 1: each snapshot is the
+ * Tetris up to and including piece; heights are rebuilt from the rows.
+ *
+ * A record is one varint: bits 0-4 inputs, bit 5 set if dt_ns is not zero,
+ * and if so the zigzag coded difference to the previous non-zero dt_ns of
+ * the block from bit 6 up. Key presses (dt_ns 0) take a single byte.
+ */
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <SDL3/SDL_stdinc.h>
+
+#include "tetris.h"
+
+#define REPLAY_DEFAULT_KEYFRAME_INTERVAL 1024
+
+typedef struct ReplayWriter ReplayWriter;
+typedef struct Replay Replay;
+
+/* Position in a replay, for stepping through it tick by tick */
+typedef struct ReplayCursor
+{
+	const Replay* replay;
+	Uint32 block;
+	const Uint8* pos;
+	const Uint8* end;
+	Uint64 tick;
+	Uint64 prev_dt;
+} ReplayCursor;
+
+/* Returns NULL on failure, see SDL_GetError */
+ReplayWriter* replay_writer_open(const char* path, Uint32 keyframe_interval);
+
+/* Records one tetris_tick call. Call it before the tick, with the state it starts from. */
+void replay_record_tick(ReplayWriter* writer, const Tetris* tetris, Uint32 inputs, Uint64 dt_ns);
+
+/* Writes the index and closes the file. Returns false on failure. */
+bool replay_writer_close(ReplayWriter* writer);
+
+/* Memory maps a recording. Returns NULL on failure, see SDL_GetError. */
+Replay* replay_open(const char* path);
+void replay_close(Replay* replay);
+
+Uint64 replay_num_ticks(const Replay* replay);
+
+/*
+ * Restores the state before the given tick from the nearest keyframe and
+ * re-simulates the rest of the way. cursor may be NULL; otherwise it is
+ * left at that tick.
+ */
+bool replay_seek(const Replay* replay, Uint64 tick, Tetris* tetris, ReplayCursor* cursor);
+
+/* Decodes the tick at the cursor and advances it. Returns false at the end. */
+bool replay_next(ReplayCursor* cursor, Uint32* inputs, Uint64* dt_ns);
+
+/*
+ * Re-simulates the whole replay as fast as possible, checking the state
+ * against every keyframe on the way. Returns false if the game diverged.
+ */
+bool replay_simulate(const Replay* replay, Tetris* tetris);
+
+#endif /* REPLAY_H */
@@ -0,0 +1,327 @@
+#include "rewind.h"
+
+#include <SDL3/SDL_error.h>
+
+/*
+ * Largest delta record: its length (u16), then at worst one zero byte and
+ * one changed byte by turns, a (zeros, literals) pair (u8 each) per change.
+ */
+#define REWIND_MAX_DELTA (2 + TETRIS_STATE_BYTES / 2 * 3 + 2)
+
+/*
+ * A keyframe and the deltas after it, in one contiguous stretch of the
+ * arena. A segment ends early when the arena wraps.
+ */
+typedef struct RewindSegment
+{
+	Uint64 first_tick;
+	Uint32 offset;
+	Uint32 size;
+	Uint32 num_ticks;
+} RewindSegment;
+
+struct RewindBuffer
+{
+	Uint8* arena;
+	Uint32 capacity;
+	Uint32 keyframe_interval;
+
+	/* Ring of segments, oldest first */
+	RewindSegment* segments;
+	Uint32 max_segments;
+	Uint32 first_segment;
+	Uint32 num_segments;
+
+	Uint64 next_tick;
+	Tetris last; /* state of the newest tick, the next delta is against it */
+	Uint8 delta[REWIND_MAX_DELTA];
+};
+
+static RewindSegment*
+segment_at(const RewindBuffer* buffer, Uint32 index)
+{
+	return &buffer->segments[(buffer->first_segment + index) % buffer->max_segments];
+}
+
+/*
+ * XORs after into before and run-length codes it: (zeros, literals) byte
+ * pairs, each followed by that many changed bytes. Unchanged bytes at the
+ * end are left out, so an unchanged state codes to nothing.
+ */
+static Uint32
+encode_delta(const Uint8* before, const Uint8* after, Uint8* out)
+{
+	Uint32 size = 0;
+	Uint32 i = 0;
+	while (i < TETRIS_STATE_BYTES)
+	{
+		Uint32 zeros = 0;
+		while (i + zeros < TETRIS_STATE_BYTES && zeros < 255 && before[i + zeros] == after[i + zeros])
+		{
+			++zeros;
+		}
+		i += zeros;
+		if (i == TETRIS_STATE_BYTES)
+		{
+			break;
+		}
+		Uint32 literals = 0;
+		while (i + literals < TETRIS_STATE_BYTES && literals < 255 && before[i + literals] != after[i + literals])
+		{
+			++literals;
+		}
+		out[size++] = (Uint8)zeros;
+		out[size++] = (Uint8)literals;
+		for (Uint32 j = 0; j < literals; ++j)
+		{
+			out[size++] = before[i + j] ^ after[i + j];
+		}
+		i += literals;
+	}
+	return size;
+}
+
+static void
+apply_delta(Uint8* state, const Uint8* delta, Uint32 size)
+{
+	Uint32 i = 0;
+	for (Uint32 pos = 0; pos < size;)
+	{
+		i += delta[pos];
+		Uint32 literals = delta[pos + 1];
+		pos += 2;
+		for (Uint32 j = 0; j < literals; ++j)
+		{
+			state[i + j] ^= delta[pos + j];
+		}
+		i += literals;
+		pos += literals;
+	}
+}
+
+static Uint32
+delta_size(const Uint8* record)
+{
+	return record[0] | (Uint32)record[1] << 8;
+}
+
+/*
+ * Makes room for size bytes at offset, dropping the oldest segments in
+ * the way. Returns false if the newest segment itself is in the way.
+ */
+static bool
+make_room(RewindBuffer* buffer, Uint32 offset, Uint32 size, Uint32 keep)
+{
+	while (buffer->num_segments > keep)
+	{
+		const RewindSegment* oldest = segment_at(buffer, 0);
+		if (oldest->offset >= offset + size || oldest->offset + oldest->size <= offset)
+		{
+			return true;
+		}
+		buffer->first_segment = (buffer->first_segment + 1) % buffer->max_segments;
+		buffer->num_segments -= 1;
+	}
+	return buffer->num_segments == 0 || keep == 0;
+}
+
+static void
+push_keyframe(RewindBuffer* buffer, const Tetris* state)
+{
+	Uint32 offset = 0;
+	if (buffer->num_segments > 0)
+	{
+		const RewindSegment* newest = segment_at(buffer, buffer->num_segments - 1);
+		offset = newest->offset + newest->size;
+		if (offset + TETRIS_STATE_BYTES + REWIND_MAX_DELTA > buffer->capacity)
+		{
+			offset = 0;
+		}
+	}
+	make_room(buffer, offset, TETRIS_STATE_BYTES, 0);
+	if (buffer->num_segments == buffer->max_segments)
+	{
+		buffer->first_segment = (buffer->first_segment + 1) % buffer->max_segments;
+		buffer->num_segments -= 1;
+	}
+
+	RewindSegment* segment = segment_at(buffer, buffer->num_segments++);
+	segment->first_tick = buffer->next_tick;
+	segment->offset = offset;
+	segment->size = TETRIS_STATE_BYTES;
+	segment->num_ticks = 1;
+	SDL_memcpy(buffer->arena + offset, state, TETRIS_STATE_BYTES);
+}
+
+RewindBuffer*
+rewind_create(Uint32 capacity, Uint32 keyframe_interval)
+{
+	keyframe_interval = SDL_max(keyframe_interval, 1);
+	if (capacity < 4 * keyframe_interval * (Uint32)REWIND_MAX_DELTA)
+	{
+		SDL_SetError("A rewind buffer of %u bytes is too small for keyframes every %u ticks", capacity, keyframe_interval);
+		return NULL;
+	}
+
+	RewindBuffer* buffer = SDL_calloc(1, sizeof(RewindBuffer));
+	if (!buffer)
+	{
+		return NULL;
+	}
+	buffer->capacity = capacity;
+	buffer->keyframe_interval = keyframe_interval;
+	buffer->max_segments = capacity / TETRIS_STATE_BYTES + 1;
+	buffer->arena = SDL_malloc(capacity);
+	buffer->segments = SDL_calloc(buffer->max_segments, sizeof(RewindSegment));
+	if (!buffer->arena || !buffer->segments)
+	{
+		rewind_destroy(buffer);
+		return NULL;
+	}
+	return buffer;
+}
+
+void
+rewind_destroy(RewindBuffer* buffer)
+{
+	if (!buffer)
+	{
+		return;
+	}
+	SDL_free(buffer->arena);
+	SDL_free(buffer->segments);
+	SDL_free(buffer);
+}
+
+void
+rewind_push(RewindBuffer* buffer, const Tetris* state)
+{
+	RewindSegment* newest = buffer->num_segments > 0 ? segment_at(buffer, buffer->num_segments - 1) : NULL;
+	if (!newest || newest->num_ticks == buffer->keyframe_interval)
+	{
+		push_keyframe(buffer, state);
+	}
+	else
+	{
+		Uint32 size = encode_delta((const Uint8*)&buffer->last, (const Uint8*)state, buffer->delta + 2);
+		Uint32 offset = newest->offset + newest->size;
+		if (offset + 2 + size > buffer->capacity || !make_room(buffer, offset, 2 + size, 1))
+		{
+			/* No room to go on here: start over from a keyframe at the front */
+			push_keyframe(buffer, state);
+		}
+		else
+		{
+			buffer->delta[0] = (Uint8)size;
+			buffer->delta[1] = (Uint8)(size >> 8);
+			SDL_memcpy(buffer->arena + offset, buffer->delta, 2 + size);
+			newest->size += 2 + size;
+			newest->num_ticks += 1;
+		}
+	}
+	SDL_memcpy(&buffer->last, state, sizeof(Tetris));
+	buffer->next_tick += 1;
+}
+
+bool
+rewind_range(const RewindBuffer* buffer, Uint64* first, Uint64* last)
+{
+	if (buffer->num_segments == 0)
+	{
+		return false;
+	}
+	*first = segment_at(buffer, 0)->first_tick;
+	*last = buffer->next_tick - 1;
+	return true;
+}
+
+/*
+ * Finds tick's segment and the state after it. Returns the offset just
+ * past its delta, or 0 if it is not kept.
+ */
+static Uint32
+find_tick(const RewindBuffer* buffer, Uint64 tick, Uint32* segment_index, Tetris* state)
+{
+	if (buffer->num_segments == 0 || tick < segment_at(buffer, 0)->first_tick || tick >= buffer->next_tick)
+	{
+		return 0;
+	}
+
+	/* Segments are in tick order: the last one starting at or before tick */
+	Uint32 low = 0, high = buffer->num_segments - 1;
+	while (low < high)
+	{
+		Uint32 mid = (low + high + 1) / 2;
+		if (segment_at(buffer, mid)->first_tick <= tick)
+		{
+			low = mid;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+
+	const RewindSegment* segment = segment_at(buffer, low);
+	const Uint8* record = buffer->arena + segment->offset;
+	SDL_memcpy(state, record, TETRIS_STATE_BYTES);
+	record += TETRIS_STATE_BYTES;
+	for (Uint64 t = segment->first_tick; t < tick; ++t)
+	{
+		Uint32 size = delta_size(record);
+		apply_delta((Uint8*)state, record + 2, size);
+		record += 2 + size;
+	}
+	*segment_index = low;
+	return (Uint32)(record - buffer->arena);
+}
+
+bool
+rewind_restore(const RewindBuffer* buffer, Uint64 tick, Tetris* state)
+{
+	Uint32 segment_index;
+	Tetris restored = buffer->last;
+	if (!find_tick(buffer, tick, &segment_index, &restored))
+	{
+		return false;
+	}
+	*state = restored;
+	return true;
+}
+
+bool
+rewind_truncate(RewindBuffer* buffer, Uint64 tick)
+{
+	Uint32 segment_index;
+	Tetris restored = buffer->last;
+	Uint32 end = find_tick(buffer, tick, &segment_index, &restored);
+	if (!end)
+	{
+		return false;
+	}
+	RewindSegment* segment = segment_at(buffer, segment_index);
+	segment->size = end - segment->offset;
+	segment->num_ticks = (Uint32)(tick - segment->first_tick) + 1;
+	buffer->num_segments = segment_index + 1;
+	buffer->last = restored;
+	buffer->next_tick = tick + 1;
+	return true;
+}
+
+void
+rewind_get_stats(const RewindBuffer* buffer, RewindStats* stats)
+{
+	SDL_zerop(stats);
+	stats->capacity = buffer->capacity;
+	stats->num_keyframes = buffer->num_segments;
+	if (buffer->num_segments == 0)
+	{
+		return;
+	}
+	stats->first_tick = segment_at(buffer, 0)->first_tick;
+	stats->num_ticks = buffer->next_tick - stats->first_tick;
+	for (Uint32 i = 0; i < buffer->num_segments; ++i)
+	{
+		stats->bytes_used += segment_at(buffer, i)->size;
+	}
+}
@@ -0,0 +1,55 @@
+/*
+ * Live rewind: the game state after every tick, kept in one arena of
+ * fixed size that is allocated up front and then reused as a ring, the
+ * oldest ticks giving way to new ones. Every keyframe_interval-th state
+ * is stored whole; the ones in between as the XOR with the state before,
+ * run-length coded, which is a few bytes when only the drop timer moved.
+ * Restoring a tick copies its keyframe and applies at most
+ * keyframe_interval - 1 deltas.
+ */
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <SDL3/SDL_stdinc.h>
+
+#include "tetris.h"
+
+#define REWIND_DEFAULT_KEYFRAME_INTERVAL 64
+
+typedef struct RewindBuffer RewindBuffer;
+
+typedef struct RewindStats
+{
+	Uint64 first_tick;   /* oldest tick still kept */
+	Uint64 num_ticks;    /* ticks kept */
+	Uint32 bytes_used;   /* of the arena, by the kept ticks */
+	Uint32 capacity;     /* arena bytes */
+	Uint32 num_keyframes;
+} RewindStats;
+
+/*
+ * Allocates the arena and everything else the buffer will ever use.
+ * capacity must hold a few keyframe intervals' worth of states. Returns
+ * NULL on failure, see SDL_GetError.
+ */
+RewindBuffer* rewind_create(Uint32 capacity, Uint32 keyframe_interval);
+void rewind_destroy(RewindBuffer* buffer);
+
+/* Appends the state after the next tick. Never allocates. */
+void rewind_push(RewindBuffer* buffer, const Tetris* state);
+
+/* The oldest and newest ticks kept, counted from 0 for the first push; false if none are */
+bool rewind_range(const RewindBuffer* buffer, Uint64* first, Uint64* last);
+
+/* Copies out the state after tick. Returns false if it is not kept. */
+bool rewind_restore(const RewindBuffer* buffer, Uint64 tick, Tetris* state);
+
+/*
+ * Forgets every tick after tick, so the next push follows it: for going
+ * on from a state rewound to. Returns false if tick is not kept.
+ */
+bool rewind_truncate(RewindBuffer* buffer, Uint64 tick);
+
+void rewind_get_stats(const RewindBuffer* buffer, RewindStats* stats);
+
+#endif /* REWIND_H */
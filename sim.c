@@ -0,0 +1,170 @@
+#include "sim.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_timer.h>
+
+/* Key presses that can wait for the next tick, far more than anyone can type */
+#define SIM_QUEUE_SIZE 256
+
+/* Further behind than this, e.g. after a debugger break, the lost time is dropped instead of caught up */
+#define SIM_MAX_LAG_NS 250000000
+
+/* Set in the shared triple buffer index when the reader has not picked it up yet */
+#define SIM_SNAPSHOT_FRESH 4
+
+struct SimThread
+{
+	Tetris tetris; /* simulation thread only */
+	Uint64 tick_ns;
+	SimStepFunc step;
+	void* userdata;
+	SDL_Thread* thread;
+	SDL_AtomicInt quit;
+
+	/* Key presses: the producer writes queue[head] and moves head, the simulation reads and moves tail */
+	Uint32 queue[SIM_QUEUE_SIZE];
+	SDL_AtomicU32 head;
+	SDL_AtomicU32 tail;
+
+	/*
+	 * Triple buffer. The simulation writes snapshots[back] and swaps it
+	 * with latest, the reader swaps front with latest when it is fresh.
+	 */
+	Tetris snapshots[3];
+	Uint32 snapshot_inputs[3]; /* key presses applied, tail at publish time */
+	int back;
+	SDL_AtomicInt latest;
+	int front;
+};
+
+static bool
+pop_input(SimThread* sim, Uint32* inputs)
+{
+	Uint32 tail = SDL_GetAtomicU32(&sim->tail);
+	if (tail == SDL_GetAtomicU32(&sim->head))
+	{
+		return false;
+	}
+	*inputs = sim->queue[tail % SIM_QUEUE_SIZE];
+	SDL_SetAtomicU32(&sim->tail, tail + 1);
+	return true;
+}
+
+static void
+publish(SimThread* sim)
+{
+	sim->snapshots[sim->back] = sim->tetris;
+	sim->snapshot_inputs[sim->back] = SDL_GetAtomicU32(&sim->tail);
+	sim->back = SDL_SetAtomicInt(&sim->latest, sim->back | SIM_SNAPSHOT_FRESH) & ~SIM_SNAPSHOT_FRESH;
+}
+
+static int SDLCALL
+sim_thread(void* data)
+{
+	SimThread* sim = data;
+	Uint64 next_ns = SDL_GetTicksNS() + sim->tick_ns;
+
+	while (!SDL_GetAtomicInt(&sim->quit))
+	{
+		Uint64 now = SDL_GetTicksNS();
+		if (now < next_ns)
+		{
+			SDL_DelayNS(next_ns - now);
+			continue;
+		}
+		if (now - next_ns > SIM_MAX_LAG_NS)
+		{
+			next_ns = now;
+		}
+
+		Uint32 inputs;
+		while (pop_input(sim, &inputs))
+		{
+			sim->step(sim->userdata, &sim->tetris, inputs, 0);
+		}
+		sim->step(sim->userdata, &sim->tetris, 0, sim->tick_ns);
+		publish(sim);
+
+		next_ns += sim->tick_ns;
+	}
+	return 0;
+}
+
+SimThread*
+sim_create(const Tetris* initial, Uint32 tick_rate, SimStepFunc step, void* userdata)
+{
+	if (tick_rate == 0 || tick_rate > SIM_MAX_TICK_RATE)
+	{
+		SDL_SetError("Tick rate must be 1 to %u per second", SIM_MAX_TICK_RATE);
+		return NULL;
+	}
+
+	SimThread* sim = SDL_calloc(1, sizeof(SimThread));
+	if (!sim)
+	{
+		return NULL;
+	}
+
+	sim->tetris = *initial;
+	sim->tick_ns = SDL_NS_PER_SECOND / tick_rate;
+	sim->step = step;
+	sim->userdata = userdata;
+	for (int i = 0; i < 3; ++i)
+	{
+		sim->snapshots[i] = *initial;
+	}
+	sim->back = 0;
+	SDL_SetAtomicInt(&sim->latest, 1);
+	sim->front = 2;
+
+	sim->thread = SDL_CreateThread(sim_thread, "sim", sim);
+	if (!sim->thread)
+	{
+		SDL_free(sim);
+		return NULL;
+	}
+	return sim;
+}
+
+void
+sim_destroy(SimThread* sim)
+{
+	if (!sim)
+	{
+		return;
+	}
+	SDL_SetAtomicInt(&sim->quit, 1);
+	SDL_WaitThread(sim->thread, NULL);
+	SDL_free(sim);
+}
+
+bool
+sim_push_input(SimThread* sim, Uint32 inputs)
+{
+	Uint32 head = SDL_GetAtomicU32(&sim->head);
+	if (head - SDL_GetAtomicU32(&sim->tail) == SIM_QUEUE_SIZE)
+	{
+		return false;
+	}
+	sim->queue[head % SIM_QUEUE_SIZE] = inputs;
+	SDL_SetAtomicU32(&sim->head, head + 1);
+	return true;
+}
+
+const Tetris*
+sim_acquire_snapshot(SimThread* sim)
+{
+	if (SDL_GetAtomicInt(&sim->latest) & SIM_SNAPSHOT_FRESH)
+	{
+		sim->front = SDL_SetAtomicInt(&sim->latest, sim->front) & ~SIM_SNAPSHOT_FRESH;
+	}
+	return &sim->snapshots[sim->front];
+}
+
+Uint32
+sim_snapshot_inputs(SimThread* sim)
+{
+	return sim->snapshot_inputs[sim->front];
+}
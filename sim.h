@@ -0,0 +1,48 @@
+/*
+ * Runs the game on its own thread at a fixed tick rate, so the simulation
+ * never waits on the GPU. Key presses reach it through a lock-free
+ * single-producer/single-consumer queue; the render thread reads the
+ * latest state from a triple buffer without ever blocking the simulation.
+ */
+#ifndef SIM_H
+#define SIM_H
+
+#include <SDL3/SDL_stdinc.h>
+
+#include "tetris.h"
+
+#define SIM_DEFAULT_TICK_RATE 1000
+
+/* Above this a tick is too short to sleep between, the thread would only spin */
+#define SIM_MAX_TICK_RATE 1000000
+
+typedef struct SimThread SimThread;
+
+/*
+ * Advances the game, on the simulation thread: once with dt_ns 0 for each
+ * queued key press, then once per tick with the tick length and no inputs.
+ */
+typedef void (*SimStepFunc)(void* userdata, Tetris* tetris, Uint32 inputs, Uint64 dt_ns);
+
+/* Starts ticking from a copy of initial, tick_rate 1 to SIM_MAX_TICK_RATE. Returns NULL on failure. */
+SimThread* sim_create(const Tetris* initial, Uint32 tick_rate, SimStepFunc step, void* userdata);
+
+/* Stops the thread; no step runs after this returns */
+void sim_destroy(SimThread* sim);
+
+/* Queues TETRIS_INPUT_* key presses. One producer thread only. Returns false if the queue is full. */
+bool sim_push_input(SimThread* sim, Uint32 inputs);
+
+/*
+ * Returns the most recently completed tick's state. One consumer thread
+ * only; the pointer stays valid until its next call.
+ */
+const Tetris* sim_acquire_snapshot(SimThread* sim);
+
+/*
+ * How many of the key presses pushed so far the state last returned by
+ * sim_acquire_snapshot has applied. Same thread as sim_acquire_snapshot.
+ */
+Uint32 sim_snapshot_inputs(SimThread* sim);
+
+#endif /* SIM_H */
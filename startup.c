@@ -0,0 +1,52 @@
+#include "startup.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_timer.h>
+
+/* Further marks are dropped */
+#define STARTUP_MAX_MARKS 32
+
+typedef struct StartupMark
+{
+	const char* name;
+	SDL_ThreadID thread;
+	Uint64 ns; /* SDL_GetTicksNS */
+} StartupMark;
+
+static SDL_SpinLock lock;
+static StartupMark marks[STARTUP_MAX_MARKS];
+static int num_marks;
+
+void
+startup_mark(const char* name)
+{
+	Uint64 ns = SDL_GetTicksNS();
+	SDL_ThreadID thread = SDL_GetCurrentThreadID();
+
+	SDL_LockSpinlock(&lock);
+	if (num_marks < STARTUP_MAX_MARKS)
+	{
+		marks[num_marks].name = name;
+		marks[num_marks].thread = thread;
+		marks[num_marks].ns = ns;
+		num_marks += 1;
+	}
+	SDL_UnlockSpinlock(&lock);
+}
+
+void
+startup_log(void)
+{
+	SDL_LockSpinlock(&lock);
+	Uint64 prev_ns = 0;
+	for (int i = 0; i < num_marks; ++i)
+	{
+		/* The first mark comes from the main thread */
+		SDL_Log("startup %8.2f ms  +%7.2f ms  %-10s %s", marks[i].ns / 1e6, (marks[i].ns - prev_ns) / 1e6,
+			marks[i].thread == marks[0].thread ? "main" : "background", marks[i].name);
+		prev_ns = marks[i].ns;
+	}
+	SDL_UnlockSpinlock(&lock);
+}
@@ -0,0 +1,21 @@
+/*
+ * Timeline of the phases between launch and the first frame, for keeping
+ * time-to-first-frame down. Any thread can mark a phase; the marks are
+ * kept in a fixed table and logged together once the game is on screen.
+ */
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <SDL3/SDL_stdinc.h>
+
+/* Records that phase just finished. name must outlive the timeline (a string literal). */
+void startup_mark(const char* name);
+
+/*
+ * Logs every phase with the time since SDL started, the time since the
+ * phase before it (on whichever thread) and whether it ran on the main
+ * thread, which is taken to be the one that made the first mark.
+ */
+void startup_log(void);
+
+#endif /* STARTUP_H */
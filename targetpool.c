@@ -0,0 +1,202 @@
+#include "targetpool.h"
+
+/* Widths and heights are rounded up to a multiple of this */
+#define TARGET_SIZE_STEP 256
+
+/* Frames an unused texture stays around, far beyond any frame still in flight */
+#define TARGET_KEEP_FRAMES 120
+
+typedef struct PooledTarget
+{
+	SDL_GPUTexture* texture;
+	SDL_GPUTextureCreateInfo info; /* width and height are the size class */
+	bool in_use;
+	Uint64 free_since;
+} PooledTarget;
+
+struct TargetPool
+{
+	SDL_GPUDevice* device;
+	PooledTarget* targets;
+	int num_targets;
+	int max_targets;
+	Uint64 frame;
+	TargetPoolStats stats;
+};
+
+static Uint32
+size_class(Uint32 size)
+{
+	return (SDL_max(size, 1) + TARGET_SIZE_STEP - 1) / TARGET_SIZE_STEP * TARGET_SIZE_STEP;
+}
+
+/* Samples times texel size; every format the renderer draws to is one texel per block */
+static Uint64
+texture_bytes(const SDL_GPUTextureCreateInfo* info)
+{
+	Uint64 samples = (Uint64)1 << info->sample_count;
+	return (Uint64)info->width * info->height * SDL_GPUTextureFormatTexelBlockSize(info->format) * samples;
+}
+
+static bool
+same_kind(const SDL_GPUTextureCreateInfo* a, const SDL_GPUTextureCreateInfo* b)
+{
+	return a->type == b->type && a->format == b->format && a->usage == b->usage &&
+		a->sample_count == b->sample_count && a->layer_count_or_depth == b->layer_count_or_depth &&
+		a->num_levels == b->num_levels;
+}
+
+static PooledTarget*
+find(TargetPool* pool, SDL_GPUTexture* texture)
+{
+	for (int i = 0; i < pool->num_targets; ++i)
+	{
+		if (pool->targets[i].texture == texture)
+		{
+			return &pool->targets[i];
+		}
+	}
+	return NULL;
+}
+
+TargetPool*
+target_pool_create(SDL_GPUDevice* device)
+{
+	TargetPool* pool = SDL_calloc(1, sizeof(TargetPool));
+	if (!pool)
+	{
+		return NULL;
+	}
+	pool->device = device;
+	return pool;
+}
+
+void
+target_pool_destroy(TargetPool* pool)
+{
+	if (!pool)
+	{
+		return;
+	}
+	for (int i = 0; i < pool->num_targets; ++i)
+	{
+		SDL_ReleaseGPUTexture(pool->device, pool->targets[i].texture);
+	}
+	SDL_free(pool->targets);
+	SDL_free(pool);
+}
+
+/* width x height is the size class, or info's own size if exact */
+static bool
+fit(TargetPool* pool, SDL_GPUTexture** texture, const SDL_GPUTextureCreateInfo* info, Uint32 width, Uint32 height, bool shrink)
+{
+	PooledTarget* current = *texture ? find(pool, *texture) : NULL;
+	if (current)
+	{
+		bool fits = current->info.width >= info->width && current->info.height >= info->height;
+		bool oversized = current->info.width > width || current->info.height > height;
+		if (fits && !(shrink && oversized))
+		{
+			pool->stats.kept += !shrink;
+			return true;
+		}
+		target_pool_return(pool, texture);
+	}
+
+	/*
+	 * A texture returned this frame may still be drawn to by commands in
+	 * flight; the render passes cycle their targets, so it can be handed
+	 * out again right away.
+	 */
+	for (int i = 0; i < pool->num_targets; ++i)
+	{
+		PooledTarget* target = &pool->targets[i];
+		if (!target->in_use && same_kind(&target->info, info) && target->info.width == width && target->info.height == height)
+		{
+			target->in_use = true;
+			*texture = target->texture;
+			pool->stats.reused += 1;
+			pool->stats.bytes_in_use += texture_bytes(&target->info);
+			return true;
+		}
+	}
+
+	if (pool->num_targets == pool->max_targets)
+	{
+		int max_targets = SDL_max(pool->max_targets * 2, 8);
+		PooledTarget* targets = SDL_realloc(pool->targets, max_targets * sizeof(PooledTarget));
+		if (!targets)
+		{
+			return false;
+		}
+		pool->targets = targets;
+		pool->max_targets = max_targets;
+	}
+
+	PooledTarget* target = &pool->targets[pool->num_targets];
+	target->info = *info;
+	target->info.width = width;
+	target->info.height = height;
+	target->texture = SDL_CreateGPUTexture(pool->device, &target->info);
+	if (!target->texture)
+	{
+		return false;
+	}
+	target->in_use = true;
+	pool->num_targets += 1;
+	pool->stats.created += 1;
+	pool->stats.bytes_in_use += texture_bytes(&target->info);
+	*texture = target->texture;
+	return true;
+}
+
+bool
+target_pool_fit(TargetPool* pool, SDL_GPUTexture** texture, const SDL_GPUTextureCreateInfo* info, bool shrink)
+{
+	return fit(pool, texture, info, size_class(info->width), size_class(info->height), shrink);
+}
+
+bool
+target_pool_fit_exact(TargetPool* pool, SDL_GPUTexture** texture, const SDL_GPUTextureCreateInfo* info)
+{
+	return fit(pool, texture, info, SDL_max(info->width, 1), SDL_max(info->height, 1), true);
+}
+
+void
+target_pool_return(TargetPool* pool, SDL_GPUTexture** texture)
+{
+	PooledTarget* target = *texture ? find(pool, *texture) : NULL;
+	if (target)
+	{
+		target->in_use = false;
+		target->free_since = pool->frame;
+		pool->stats.bytes_in_use -= texture_bytes(&target->info);
+	}
+	*texture = NULL;
+}
+
+void
+target_pool_end_frame(TargetPool* pool)
+{
+	pool->frame += 1;
+	for (int i = 0; i < pool->num_targets;)
+	{
+		PooledTarget* target = &pool->targets[i];
+		if (!target->in_use && pool->frame - target->free_since > TARGET_KEEP_FRAMES)
+		{
+			SDL_ReleaseGPUTexture(pool->device, target->texture);
+			pool->stats.released += 1;
+			*target = pool->targets[--pool->num_targets];
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+void
+target_pool_get_stats(const TargetPool* pool, TargetPoolStats* stats)
+{
+	*stats = pool->stats;
+}
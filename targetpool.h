@@ -0,0 +1,53 @@
+/*
+ * Render targets bucketed by size class, so a window being drag-resized
+ * keeps drawing into a slightly larger texture (with the viewport set to
+ * the window size) instead of reallocating every frame. Returned textures
+ * stay in the pool for a while before they are released, ready for the
+ * next window or size that needs the same class.
+ */
+#ifndef TARGETPOOL_H
+#define TARGETPOOL_H
+
+#include <SDL3/SDL_gpu.h>
+
+typedef struct TargetPool TargetPool;
+
+typedef struct TargetPoolStats
+{
+	Uint32 created;  /* textures allocated */
+	Uint32 released; /* textures that sat unused long enough to be freed */
+	Uint32 kept;     /* size changes the current texture was already large enough for */
+	Uint32 reused;   /* requests served from the pool instead of a new allocation */
+	Uint64 bytes_in_use; /* of the textures handed out now */
+} TargetPoolStats;
+
+TargetPool* target_pool_create(SDL_GPUDevice* device);
+
+/* Releases every texture, including those still handed out */
+void target_pool_destroy(TargetPool* pool);
+
+/*
+ * Makes *texture a target of info's type, format, usage and sample count
+ * at least info's width x height. The current texture (NULL for none) is
+ * kept if it is large enough, unless shrink is set and a smaller size
+ * class would do; otherwise it goes back to the pool and one of the right
+ * class is taken out or created. Returns false on failure.
+ */
+bool target_pool_fit(TargetPool* pool, SDL_GPUTexture** texture, const SDL_GPUTextureCreateInfo* info, bool shrink);
+
+/*
+ * Like target_pool_fit, for targets that must be exactly info's size, such
+ * as MSAA ones resolved into a swapchain texture: every size change takes
+ * another texture, though returned ones are still handed out again.
+ */
+bool target_pool_fit_exact(TargetPool* pool, SDL_GPUTexture** texture, const SDL_GPUTextureCreateInfo* info);
+
+/* Hands *texture (NULL for none) back to the pool and sets it to NULL */
+void target_pool_return(TargetPool* pool, SDL_GPUTexture** texture);
+
+/* Frees textures nobody has taken for a while. Call once per frame. */
+void target_pool_end_frame(TargetPool* pool);
+
+void target_pool_get_stats(const TargetPool* pool, TargetPoolStats* stats);
+
+#endif /* TARGETPOOL_H */
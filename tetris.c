@@ -0,0 +1,350 @@
+#include "tetris.h"
+
+#include <assert.h>
+#include <string.h>
+
+#define TETRIS_MIN(x, y) (((x) < (y)) ? (x) : (y))
+#define TETRIS_MAX(x, y) (((x) > (y)) ? (x) : (y))
+
+/*
+ * The table below is expanded by the preprocessor from the three non-pivot
+ * offsets of each piece in rotation 0. Rotation r turns (x, y) clockwise r
+ * times: (x, y) -> (y, -x) -> (-x, -y) -> (-y, x).
+ */
+#define ROT_X(r, x, y) ((r) == 0 ? (x) : (r) == 1 ? (y) : (r) == 2 ? -(x) : -(y))
+#define ROT_Y(r, x, y) ((r) == 0 ? (y) : (r) == 1 ? -(x) : (r) == 2 ? -(y) : (x))
+
+#define MIN4(a, b, c, d) TETRIS_MIN(TETRIS_MIN(a, b), TETRIS_MIN(c, d))
+#define MAX4(a, b, c, d) TETRIS_MAX(TETRIS_MAX(a, b), TETRIS_MAX(c, d))
+
+#define SHAPE_LEFT(r, x0, y0, x1, y1, x2, y2)   MIN4(ROT_X(r, x0, y0), ROT_X(r, x1, y1), ROT_X(r, x2, y2), 0)
+#define SHAPE_RIGHT(r, x0, y0, x1, y1, x2, y2)  MAX4(ROT_X(r, x0, y0), ROT_X(r, x1, y1), ROT_X(r, x2, y2), 0)
+#define SHAPE_BOTTOM(r, x0, y0, x1, y1, x2, y2) MIN4(ROT_Y(r, x0, y0), ROT_Y(r, x1, y1), ROT_Y(r, x2, y2), 0)
+#define SHAPE_TOP(r, x0, y0, x1, y1, x2, y2)    MAX4(ROT_Y(r, x0, y0), ROT_Y(r, x1, y1), ROT_Y(r, x2, y2), 0)
+
+/* Bit of cell (x, y) in mask row i, or 0 if the cell is on another row */
+#define CELL_BIT(r, i, x, y, left, bottom) \
+	(ROT_Y(r, x, y) == (bottom) + (i) ? 1 << (ROT_X(r, x, y) - (left)) : 0)
+
+#define SHAPE_ROW(r, i, x0, y0, x1, y1, x2, y2) ( \
+	CELL_BIT(r, i, x0, y0, SHAPE_LEFT(r, x0, y0, x1, y1, x2, y2), SHAPE_BOTTOM(r, x0, y0, x1, y1, x2, y2)) | \
+	CELL_BIT(r, i, x1, y1, SHAPE_LEFT(r, x0, y0, x1, y1, x2, y2), SHAPE_BOTTOM(r, x0, y0, x1, y1, x2, y2)) | \
+	CELL_BIT(r, i, x2, y2, SHAPE_LEFT(r, x0, y0, x1, y1, x2, y2), SHAPE_BOTTOM(r, x0, y0, x1, y1, x2, y2)) | \
+	CELL_BIT(r, i, 0, 0, SHAPE_LEFT(r, x0, y0, x1, y1, x2, y2), SHAPE_BOTTOM(r, x0, y0, x1, y1, x2, y2)))
+
+#define SHAPE(r, n, x0, y0, x1, y1, x2, y2) { \
+	{ ROT_X(r, x0, y0), ROT_X(r, x1, y1), ROT_X(r, x2, y2), 0 }, \
+	{ ROT_Y(r, x0, y0), ROT_Y(r, x1, y1), ROT_Y(r, x2, y2), 0 }, \
+	SHAPE_LEFT(r, x0, y0, x1, y1, x2, y2), SHAPE_RIGHT(r, x0, y0, x1, y1, x2, y2), \
+	SHAPE_BOTTOM(r, x0, y0, x1, y1, x2, y2), SHAPE_TOP(r, x0, y0, x1, y1, x2, y2), \
+	{ SHAPE_ROW(r, 0, x0, y0, x1, y1, x2, y2), SHAPE_ROW(r, 1, x0, y0, x1, y1, x2, y2), \
+	  SHAPE_ROW(r, 2, x0, y0, x1, y1, x2, y2), SHAPE_ROW(r, 3, x0, y0, x1, y1, x2, y2) }, \
+	{ ((r) + (n) - 1) % (n), (r) % (n), ((r) + 1) % (n) } }
+#define PIECE_SHAPES(n, x0, y0, x1, y1, x2, y2) { \
+	SHAPE(0, n, x0, y0, x1, y1, x2, y2), SHAPE(1, n, x0, y0, x1, y1, x2, y2), \
+	SHAPE(2, n, x0, y0, x1, y1, x2, y2), SHAPE(3, n, x0, y0, x1, y1, x2, y2) }
+
+const PieceShape piece_shapes[8][4] = {
+	/*          rots, non-pivot (x, y) offsets in rotation 0 */
+	PIECE_SHAPES(1, 0, 0, 0, 0, 0, 0),
+	PIECE_SHAPES(4, -1, -1, -1, 0, 1, 0),  /* L */
+	PIECE_SHAPES(4, -1, 0, 1, 0, 1, -1),   /* J */
+	PIECE_SHAPES(2, -1, -1, 0, -1, 1, 0),  /* S */
+	PIECE_SHAPES(2, -1, 0, 0, -1, -1, -1), /* Z */
+	PIECE_SHAPES(4, -1, 0, 0, -1, 1, 0),   /* T */
+	PIECE_SHAPES(1, -1, -1, -1, 0, 0, -1), /* O */
+	PIECE_SHAPES(2, -2, 0, -1, 0, 1, 0),   /* I */
+};
+
+/* Whether the piece in rotation rot fits with its pivot at x, y */
+static int
+fits(const Tetris* tetris, int x, int y, int rot)
+{
+	const PieceShape* shape = &piece_shapes[tetris->piece][rot];
+	if (x + shape->left < 0 || x + shape->right >= 10 || y + shape->bottom < 0 || y + shape->top >= 22)
+	{
+		return 0;
+	}
+
+	const uint16_t* rows = &tetris->rows[y + shape->bottom];
+	int shift = x + shape->left;
+	return !((rows[0] & (shape->rows[0] << shift)) |
+		(rows[1] & (shape->rows[1] << shift)) |
+		(rows[2] & (shape->rows[2] << shift)) |
+		(rows[3] & (shape->rows[3] << shift)));
+}
+
+int
+try_move(Tetris* tetris, int dx, int dy, int drot)
+{
+	assert(drot >= -1 && drot <= 1);
+	int x = tetris->x + dx;
+	int y = tetris->y + dy;
+	int rot = piece_shapes[tetris->piece][tetris->rot].next_rot[drot + 1];
+	if (!fits(tetris, x, y, rot))
+	{
+		return 0;
+	}
+
+	tetris->x = x;
+	tetris->y = y;
+	tetris->rot = rot;
+	return 1;
+}
+
+void
+glue(Tetris* tetris)
+{
+	const PieceShape* shape = &piece_shapes[tetris->piece][tetris->rot];
+	uint8_t* pivot = &tetris->board[tetris->x + tetris->y * 10];
+	pivot[shape->xs[0] + shape->ys[0] * 10] = tetris->piece;
+	pivot[shape->xs[1] + shape->ys[1] * 10] = tetris->piece;
+	pivot[shape->xs[2] + shape->ys[2] * 10] = tetris->piece;
+	pivot[shape->xs[3] + shape->ys[3] * 10] = tetris->piece;
+	for (int i = 0; i < 4; ++i)
+	{
+		int x = tetris->x + shape->xs[i];
+		int height = tetris->y + shape->ys[i] + 1;
+		tetris->heights[x] = (uint8_t)TETRIS_MAX(tetris->heights[x], height);
+	}
+
+	int bottom = tetris->y + shape->bottom;
+	int top = tetris->y + shape->top;
+	int shift = tetris->x + shape->left;
+	for (int i = 0; i < 4; ++i)
+	{
+		tetris->rows[bottom + i] |= shape->rows[i] << shift;
+	}
+
+	tetris->piece = (tetris->piece % 7) + 1;
+	tetris->x = 5;
+	tetris->y = 20;
+	tetris->rot = 0;
+
+	/* Only rows touched by the piece can have become full */
+	int cleared = 0;
+	int full[4];
+	for (int y = bottom; y <= top; ++y)
+	{
+		if (tetris->rows[y] == BOARD_FULL_ROW)
+		{
+			full[cleared++] = y;
+		}
+	}
+
+	if (cleared)
+	{
+		/* Compact everything from the lowest full row up */
+		int dst = bottom;
+		while (tetris->rows[dst] != BOARD_FULL_ROW)
+		{
+			++dst;
+		}
+		for (int src = dst; src < 22; ++src)
+		{
+			if (tetris->rows[src] == BOARD_FULL_ROW)
+			{
+				continue;
+			}
+			tetris->rows[dst] = tetris->rows[src];
+			memcpy(&tetris->board[dst * 10], &tetris->board[src * 10], 10);
+			++dst;
+		}
+		for (; dst < 22; ++dst)
+		{
+			tetris->rows[dst] = 0;
+			memset(&tetris->board[dst * 10], 0, 10);
+		}
+
+		/*
+		 * Every column comes down by the full rows under its top. If its top
+		 * cell was in one of them, it also comes down past the gap below.
+		 */
+		for (int x = 0; x < 10; ++x)
+		{
+			int height = tetris->heights[x];
+			for (int i = 0; i < cleared; ++i)
+			{
+				height -= full[i] < tetris->heights[x];
+			}
+			while (height > 0 && !(tetris->rows[height - 1] & (1 << x)))
+			{
+				--height;
+			}
+			tetris->heights[x] = (uint8_t)height;
+		}
+	}
+
+	tetris->score += (tetris->lines / 10 + 1) << cleared;
+	tetris->lines += cleared;
+
+	if (!try_move(tetris, 0, 0, 0))
+	{
+		// Game over
+		tetris->piece = 0;
+	}
+}
+
+void
+tetris_add_garbage(Tetris* tetris, int count, int hole)
+{
+	count = TETRIS_MIN(count, 22);
+	if (count <= 0)
+	{
+		return;
+	}
+
+	int lost = 0;
+	for (int y = 22 - count; y < 22; ++y)
+	{
+		lost |= tetris->rows[y] != 0;
+	}
+	memmove(&tetris->rows[count], &tetris->rows[0], (22 - count) * sizeof(tetris->rows[0]));
+	memmove(&tetris->board[count * 10], &tetris->board[0], (22 - count) * 10);
+	for (int y = 0; y < count; ++y)
+	{
+		tetris->rows[y] = (uint16_t)(BOARD_FULL_ROW & ~(1 << hole));
+		memset(&tetris->board[y * 10], TETRIS_GARBAGE, 10);
+		tetris->board[y * 10 + hole] = 0;
+	}
+	tetris_update_heights(tetris);
+
+	if (tetris->piece == 0)
+	{
+		return;
+	}
+	while (tetris->y < 21 && !fits(tetris, tetris->x, tetris->y, tetris->rot))
+	{
+		++tetris->y;
+	}
+	if (lost || !fits(tetris, tetris->x, tetris->y, tetris->rot))
+	{
+		tetris->piece = 0;
+	}
+}
+
+void
+tetris_update_heights(Tetris* tetris)
+{
+	for (int x = 0; x < 10; ++x)
+	{
+		int height = 22;
+		while (height > 0 && !(tetris->rows[height - 1] & (1 << x)))
+		{
+			--height;
+		}
+		tetris->heights[x] = (uint8_t)height;
+	}
+}
+
+int
+tetris_drop_distance(const Tetris* tetris)
+{
+	const PieceShape* shape = &piece_shapes[tetris->piece][tetris->rot];
+	int distance = 22;
+	for (int i = 0; i < 4; ++i)
+	{
+		int x = tetris->x + shape->xs[i];
+		int y = tetris->y + shape->ys[i];
+		if (y < tetris->heights[x])
+		{
+			/* Under an overhang, the skyline says nothing about what is below */
+			distance = 0;
+			while (fits(tetris, tetris->x, tetris->y - distance - 1, tetris->rot))
+			{
+				++distance;
+			}
+			return distance;
+		}
+		distance = TETRIS_MIN(distance, y - tetris->heights[x]);
+	}
+	return distance;
+}
+
+int
+try_rotate(Tetris* tetris)
+{
+	int i_nudge = tetris->x == 0 && tetris->piece == 8;
+	int d = 1;
+	return try_move(tetris, 0, 0, d) ||
+		try_move(tetris, -1, 0, d) ||
+		try_move(tetris, 1, 0, d) ||
+		(i_nudge && try_move(tetris, 2, 0, d)) ||
+		try_move(tetris, 0, -1, d) ||
+		try_move(tetris, 0, 1, d);
+}
+
+uint64_t
+tetris_drop_interval(const Tetris* tetris)
+{
+	return 1000000000 >> (tetris->lines / 10);
+}
+
+void
+tetris_reset(Tetris* tetris)
+{
+	memset(tetris, 0, sizeof(Tetris));
+	tetris->piece = 1;
+	tetris->x = 5;
+	tetris->y = 21;
+}
+
+int
+tetris_tick(Tetris* tetris, uint32_t inputs, uint64_t dt_ns)
+{
+	int events = 0;
+
+	if (tetris->piece == 0)
+	{
+		tetris_reset(tetris);
+	}
+
+	if (inputs & TETRIS_INPUT_LEFT)
+		try_move(tetris, -1, 0, 0);
+	if (inputs & TETRIS_INPUT_RIGHT)
+		try_move(tetris, 1, 0, 0);
+	if (inputs & TETRIS_INPUT_ROTATE)
+		try_rotate(tetris);
+
+	int drop = (inputs & TETRIS_INPUT_DROP) != 0;
+	int down = (inputs & TETRIS_INPUT_DOWN) != 0;
+	if (drop || down)
+	{
+		if (drop)
+		{
+			tetris->y -= (uint8_t)tetris_drop_distance(tetris);
+		}
+
+		if (drop || (down && !try_move(tetris, 0, -1, 0)))
+		{
+			glue(tetris);
+			events |= TETRIS_TICK_LOCKED;
+		}
+
+		tetris->drop_timer += tetris_drop_interval(tetris);
+	}
+
+	/* Gravity. The game may have ended on a drop above, it restarts on the next tick. */
+	if (dt_ns > 0 && tetris->piece != 0)
+	{
+		if (tetris->drop_timer > dt_ns)
+		{
+			tetris->drop_timer -= dt_ns;
+		}
+		else
+		{
+			if (!try_move(tetris, 0, -1, 0))
+			{
+				glue(tetris);
+				events |= TETRIS_TICK_LOCKED;
+			}
+			tetris->drop_timer += tetris_drop_interval(tetris);
+		}
+	}
+
+	if (tetris->piece == 0)
+	{
+		events |= TETRIS_TICK_GAME_OVER;
+	}
+	return events;
+}
@@ -0,0 +1,129 @@
+/*
+ * Tetris game rules. No SDL or GPU dependency, so the simulation can run
+ * headless: the caller feeds inputs and elapsed time through tetris_tick.
+ */
+#ifndef TETRIS_H
+#define TETRIS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Row occupancy with all 10 columns set */
+#define BOARD_FULL_ROW 0x3FF
+
+/* board[] value of the cells tetris_add_garbage pushes in */
+#define TETRIS_GARBAGE 8
+
+typedef struct Tetris
+{
+	uint64_t drop_timer; /* nanoseconds until the next gravity step */
+	uint32_t score;
+	uint32_t lines;
+	/*
+	 * Occupancy bitmask per row, bit x set for column x. Mirrors board[] and
+	 * is padded with 3 always-empty rows so a 4-row piece mask can be tested
+	 * from any row.
+	 */
+	uint16_t rows[22 + 3];
+	uint8_t board[220]; /* piece of each locked cell, 0 if empty, TETRIS_GARBAGE */
+	uint8_t rot;
+	uint8_t x;
+	uint8_t y;
+	uint8_t piece; /* 1..7, 0 once the game is over */
+	/*
+	 * Skyline: one above the highest locked cell of each column, 0 for an
+	 * empty column. glue keeps it up to date; after filling rows[] and
+	 * board[] any other way, call tetris_update_heights.
+	 */
+	uint8_t heights[10];
+} Tetris;
+
+/*
+ * Bytes of a Tetris holding the game, up to and including heights. Struct
+ * copies need not keep the tail padding, so hash and compare only these.
+ */
+#define TETRIS_STATE_BYTES (offsetof(Tetris, heights) + sizeof(((Tetris*)0)->heights))
+
+/*
+ * Footprint of one piece in one rotation relative to its pivot cell: the
+ * cell offsets (pivot last), the inclusive bounding box and one column
+ * bitmask per row counted from the bottom, with bit 0 at the left edge of
+ * the box. Unused rows are zero.
+ */
+typedef struct PieceShape
+{
+	int8_t xs[4], ys[4];
+	int8_t left, right, bottom, top;
+	uint16_t rows[4];
+	uint8_t next_rot[3]; /* rotation reached by drot -1, 0 and +1 */
+} PieceShape;
+
+/* Indexed by [piece][rot]. Piece 0 (no piece) is just the pivot cell. */
+extern const PieceShape piece_shapes[8][4];
+
+/* Inputs for tetris_tick, one bit per key press */
+#define TETRIS_INPUT_LEFT   0x01
+#define TETRIS_INPUT_RIGHT  0x02
+#define TETRIS_INPUT_ROTATE 0x04
+#define TETRIS_INPUT_DOWN   0x08
+#define TETRIS_INPUT_DROP   0x10
+
+/* Things that happened during tetris_tick */
+#define TETRIS_TICK_LOCKED    0x01 /* a piece was glued to the board */
+#define TETRIS_TICK_GAME_OVER 0x02 /* the next piece did not fit, piece is now 0 */
+
+/* Starts a new game */
+void tetris_reset(Tetris* tetris);
+
+/*
+ * Advances the game: starts a new one if the last one is over, applies the
+ * key presses in inputs (left, right, rotate, then down or drop) and then
+ * gravity for dt_ns nanoseconds. Returns TETRIS_TICK_* flags.
+ */
+int tetris_tick(Tetris* tetris, uint32_t inputs, uint64_t dt_ns);
+
+/* Moves and/or rotates (drot -1, 0 or 1) the piece if it fits. Returns 1 on success. */
+int try_move(Tetris* tetris, int dx, int dy, int drot);
+
+/* Rotates the piece clockwise, trying the wall kicks in order. Returns 1 on success. */
+int try_rotate(Tetris* tetris);
+
+/* Locks the piece to the board, clears full lines and spawns the next piece */
+void glue(Tetris* tetris);
+
+/*
+ * Versus attack: pushes count full rows, each with a gap in column hole,
+ * in under the stack. The piece moves up if it has to; if it cannot, or
+ * locked cells are pushed off the top, the game is over.
+ */
+void tetris_add_garbage(Tetris* tetris, int count, int hole);
+
+/* Rebuilds heights[] from rows[] */
+void tetris_update_heights(Tetris* tetris);
+
+/*
+ * Rows the piece would fall in a hard drop. Taken from the skyline when
+ * every cell of the piece is above it, which is all but the rare piece
+ * tucked under an overhang; those are followed down row by row.
+ */
+int tetris_drop_distance(const Tetris* tetris);
+
+/* Column x's height, for bots scoring a board: one above its highest cell, 0 if empty */
+static inline int
+tetris_column_height(const Tetris* tetris, int x)
+{
+	return tetris->heights[x];
+}
+
+/* Nanoseconds between gravity steps at the current level */
+uint64_t tetris_drop_interval(const Tetris* tetris);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TETRIS_H */
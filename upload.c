@@ -0,0 +1,280 @@
+#include "upload.h"
+
+#include <SDL3/SDL_error.h>
+
+/* Frames the arena keeps fences for; a further frame waits for the oldest */
+#define UPLOAD_MAX_FRAMES 8
+
+/* Copies a frame can schedule per block, the list of them is allocated up front */
+#define UPLOAD_COPIES_PER_BLOCK 512
+
+typedef struct UploadBlock
+{
+	SDL_GPUTransferBuffer* buffer;
+	Uint8* map; /* while filling, NULL otherwise */
+	Uint32 used;
+	Uint64 frame; /* last frame that filled it, 0 for never */
+} UploadBlock;
+
+typedef struct UploadCopy
+{
+	SDL_GPUTransferBufferLocation source;
+	SDL_GPUBufferRegion destination;
+	bool cycle;
+} UploadCopy;
+
+typedef struct UploadFrame
+{
+	Uint64 frame;
+	SDL_GPUFence* fence;
+} UploadFrame;
+
+struct UploadArena
+{
+	SDL_GPUDevice* device;
+	Uint32 block_size;
+	UploadBlock* blocks;
+	int num_blocks;
+	int current; /* block being filled, -1 for none */
+	int next;    /* where the search for a block starts, so they are reused oldest first */
+
+	Uint64 frame;   /* the one being recorded, from 1 */
+	bool frame_used;
+	Uint64 retired; /* the GPU is done with every frame up to this one */
+	UploadFrame in_flight[UPLOAD_MAX_FRAMES];
+	int first_in_flight;
+	int num_in_flight;
+
+	UploadCopy* copies;
+	int num_copies;
+	int max_copies;
+};
+
+/* Moves retired up past every finished frame, first waiting for the oldest one if asked */
+static void
+retire(UploadArena* arena, bool wait)
+{
+	while (arena->num_in_flight > 0)
+	{
+		UploadFrame* oldest = &arena->in_flight[arena->first_in_flight];
+		if (!SDL_QueryGPUFence(arena->device, oldest->fence))
+		{
+			if (!wait)
+			{
+				return;
+			}
+			SDL_WaitForGPUFences(arena->device, true, &oldest->fence, 1);
+		}
+		wait = false;
+
+		arena->retired = oldest->frame;
+		SDL_ReleaseGPUFence(arena->device, oldest->fence);
+		arena->first_in_flight = (arena->first_in_flight + 1) % UPLOAD_MAX_FRAMES;
+		arena->num_in_flight -= 1;
+	}
+}
+
+/*
+ * Maps a block not yet used this frame, preferring one the GPU is done
+ * with. A block still in flight is mapped with cycling, so SDL gives it
+ * fresh memory instead of stalling.
+ */
+static bool
+next_block(UploadArena* arena)
+{
+	retire(arena, false);
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (int i = 0; i < arena->num_blocks; ++i)
+		{
+			int index = (arena->next + i) % arena->num_blocks;
+			UploadBlock* block = &arena->blocks[index];
+			bool in_flight = block->frame > arena->retired;
+			if (block->frame == arena->frame || (pass == 0 && in_flight))
+			{
+				continue;
+			}
+
+			block->map = SDL_MapGPUTransferBuffer(arena->device, block->buffer, in_flight);
+			if (!block->map)
+			{
+				return false;
+			}
+			block->used = 0;
+			block->frame = arena->frame;
+			arena->current = index;
+			arena->next = (index + 1) % arena->num_blocks;
+			arena->frame_used = true;
+			return true;
+		}
+	}
+
+	SDL_SetError("Upload arena full, all %d blocks used this frame", arena->num_blocks);
+	return false;
+}
+
+UploadArena*
+upload_arena_create(SDL_GPUDevice* device, Uint32 block_size, int num_blocks)
+{
+	UploadArena* arena = SDL_calloc(1, sizeof(UploadArena));
+	if (!arena)
+	{
+		return NULL;
+	}
+	arena->device = device;
+	arena->block_size = block_size;
+	arena->current = -1;
+	arena->frame = 1;
+
+	arena->blocks = SDL_calloc(num_blocks, sizeof(UploadBlock));
+	arena->max_copies = num_blocks * UPLOAD_COPIES_PER_BLOCK;
+	arena->copies = SDL_malloc(arena->max_copies * sizeof(UploadCopy));
+	if (!arena->blocks || !arena->copies)
+	{
+		upload_arena_destroy(arena);
+		return NULL;
+	}
+
+	SDL_GPUTransferBufferCreateInfo createinfo;
+	createinfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+	createinfo.size = block_size;
+	createinfo.props = 0;
+	for (int i = 0; i < num_blocks; ++i)
+	{
+		arena->blocks[i].buffer = SDL_CreateGPUTransferBuffer(device, &createinfo);
+		if (!arena->blocks[i].buffer)
+		{
+			upload_arena_destroy(arena);
+			return NULL;
+		}
+		arena->num_blocks += 1;
+	}
+	return arena;
+}
+
+void
+upload_arena_destroy(UploadArena* arena)
+{
+	if (!arena)
+	{
+		return;
+	}
+
+	while (arena->num_in_flight > 0)
+	{
+		retire(arena, true);
+	}
+	for (int i = 0; i < arena->num_blocks; ++i)
+	{
+		if (arena->blocks[i].map)
+		{
+			SDL_UnmapGPUTransferBuffer(arena->device, arena->blocks[i].buffer);
+		}
+		SDL_ReleaseGPUTransferBuffer(arena->device, arena->blocks[i].buffer);
+	}
+	SDL_free(arena->blocks);
+	SDL_free(arena->copies);
+	SDL_free(arena);
+}
+
+void*
+upload_arena_alloc(UploadArena* arena, Uint32 size, Uint32 alignment, SDL_GPUTransferBufferLocation* location)
+{
+	if (size > arena->block_size)
+	{
+		SDL_SetError("Upload of %u bytes does not fit a %u byte block", size, arena->block_size);
+		return NULL;
+	}
+
+	UploadBlock* block = arena->current >= 0 ? &arena->blocks[arena->current] : NULL;
+	Uint32 offset = block ? (block->used + alignment - 1) & ~(alignment - 1) : 0;
+	if (!block || offset + size > arena->block_size)
+	{
+		if (!next_block(arena))
+		{
+			return NULL;
+		}
+		block = &arena->blocks[arena->current];
+		offset = 0;
+	}
+
+	block->used = offset + size;
+	location->transfer_buffer = block->buffer;
+	location->offset = offset;
+	return block->map + offset;
+}
+
+bool
+upload_arena_copy(UploadArena* arena, const SDL_GPUTransferBufferLocation* location, SDL_GPUBuffer* buffer,
+	Uint32 offset, Uint32 size, bool cycle)
+{
+	if (arena->num_copies == arena->max_copies)
+	{
+		return SDL_SetError("Upload arena full, %d copies scheduled this frame", arena->max_copies);
+	}
+
+	UploadCopy* copy = &arena->copies[arena->num_copies++];
+	copy->source = *location;
+	copy->destination.buffer = buffer;
+	copy->destination.offset = offset;
+	copy->destination.size = size;
+	copy->cycle = cycle;
+	return true;
+}
+
+void
+upload_arena_flush(UploadArena* arena, SDL_GPUCommandBuffer* cmd)
+{
+	for (int i = 0; i < arena->num_blocks; ++i)
+	{
+		if (arena->blocks[i].map)
+		{
+			SDL_UnmapGPUTransferBuffer(arena->device, arena->blocks[i].buffer);
+			arena->blocks[i].map = NULL;
+		}
+	}
+	arena->current = -1;
+
+	if (arena->num_copies > 0)
+	{
+		SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(cmd);
+		for (int i = 0; i < arena->num_copies; ++i)
+		{
+			SDL_UploadToGPUBuffer(copy_pass, &arena->copies[i].source, &arena->copies[i].destination, arena->copies[i].cycle);
+		}
+		SDL_EndGPUCopyPass(copy_pass);
+		arena->num_copies = 0;
+	}
+}
+
+bool
+upload_arena_submit(UploadArena* arena, SDL_GPUCommandBuffer* cmd)
+{
+	bool result;
+
+	upload_arena_flush(arena, cmd);
+	if (!arena->frame_used)
+	{
+		result = SDL_SubmitGPUCommandBuffer(cmd);
+	}
+	else
+	{
+		if (arena->num_in_flight == UPLOAD_MAX_FRAMES)
+		{
+			retire(arena, true);
+		}
+		SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmd);
+		result = fence != NULL;
+		if (fence)
+		{
+			UploadFrame* frame = &arena->in_flight[(arena->first_in_flight + arena->num_in_flight) % UPLOAD_MAX_FRAMES];
+			frame->frame = arena->frame;
+			frame->fence = fence;
+			arena->num_in_flight += 1;
+		}
+	}
+
+	arena->frame += 1;
+	arena->frame_used = false;
+	return result;
+}
@@ -0,0 +1,48 @@
+/*
+ * Per-frame GPU uploads without creating GPU objects at runtime. A fixed
+ * ring of transfer buffers is sub-allocated front to back; callers write
+ * into the returned pointer and schedule a copy into a GPU buffer. A block
+ * is reused once the frame that last filled it has retired on the GPU, or
+ * mapped with cycling if it is still in flight.
+ */
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include <SDL3/SDL_gpu.h>
+
+typedef struct UploadArena UploadArena;
+
+/* num_blocks transfer buffers of block_size bytes each. Returns NULL on failure. */
+UploadArena* upload_arena_create(SDL_GPUDevice* device, Uint32 block_size, int num_blocks);
+
+/* Waits for the frames still using the arena */
+void upload_arena_destroy(UploadArena* arena);
+
+/*
+ * Returns size bytes of mapped memory, aligned to alignment (a power of
+ * two), that stay valid until upload_arena_flush. location receives where
+ * they are for SDL_UploadToGPUBuffer. Returns NULL if the request is larger
+ * than a block or every block is already used this frame.
+ */
+void* upload_arena_alloc(UploadArena* arena, Uint32 size, Uint32 alignment, SDL_GPUTransferBufferLocation* location);
+
+/*
+ * Schedules a copy of size bytes from an allocation into buffer at offset.
+ * cycle is passed on to SDL_UploadToGPUBuffer: only set it when the copies
+ * this frame rewrite everything the draws read from buffer. Never
+ * allocates; returns false if the frame already has as many copies as the
+ * arena has room for, see SDL_GetError.
+ */
+bool upload_arena_copy(UploadArena* arena, const SDL_GPUTransferBufferLocation* location, SDL_GPUBuffer* buffer,
+	Uint32 offset, Uint32 size, bool cycle);
+
+/* Unmaps this frame's blocks and records every scheduled copy in one copy pass on cmd */
+void upload_arena_flush(UploadArena* arena, SDL_GPUCommandBuffer* cmd);
+
+/*
+ * Submits cmd and ends the frame; the blocks it used retire when the GPU
+ * is done with it. Use instead of SDL_SubmitGPUCommandBuffer.
+ */
+bool upload_arena_submit(UploadArena* arena, SDL_GPUCommandBuffer* cmd);
+
+#endif /* UPLOAD_H */
@@ -0,0 +1,43 @@
+#include "vecmath.h"
+
+void
+mat4_identity(mat4* r)
+{
+	r->col[0] = vec4_set(1.0f, 0.0f, 0.0f, 0.0f);
+	r->col[1] = vec4_set(0.0f, 1.0f, 0.0f, 0.0f);
+	r->col[2] = vec4_set(0.0f, 0.0f, 1.0f, 0.0f);
+	r->col[3] = vec4_set(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void
+mat4_rotate(float angle, float x, float y, float z, mat4* r)
+{
+	float radians, c, s, c1, length;
+
+	radians = angle * SDL_PI_F / 180.0f;
+
+	c = SDL_cosf(radians);
+	s = SDL_sinf(radians);
+	c1 = 1.0f - c;
+
+	length = SDL_sqrtf(x * x + y * y + z * z);
+	x /= length;
+	y /= length;
+	z /= length;
+
+	r->col[0] = vec4_set(c1 * x * x + c, c1 * x * y + z * s, c1 * x * z - y * s, 0.0f);
+	r->col[1] = vec4_set(c1 * y * x - z * s, c1 * y * y + c, c1 * y * z + x * s, 0.0f);
+	r->col[2] = vec4_set(c1 * z * x + y * s, c1 * z * y - x * s, c1 * z * z + c, 0.0f);
+	r->col[3] = vec4_set(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void
+mat4_perspective(float fovy, float aspect, float znear, float zfar, mat4* r)
+{
+	float f = 1.0f / SDL_tanf(fovy * 0.5f);
+
+	r->col[0] = vec4_set(f / aspect, 0.0f, 0.0f, 0.0f);
+	r->col[1] = vec4_set(0.0f, f, 0.0f, 0.0f);
+	r->col[2] = vec4_set(0.0f, 0.0f, (znear + zfar) / (znear - zfar), -1.0f);
+	r->col[3] = vec4_set(0.0f, 0.0f, (2.0f * znear * zfar) / (znear - zfar), 0.0f);
+}
@@ -0,0 +1,124 @@
+/*
+ * Small 4x4 matrix / 4-vector math for the renderer. Matrices are column
+ * major like the old float[16] helpers, so a mat4 can be handed straight to
+ * SDL_PushGPUVertexUniformData.
+ *
+ * Uses SSE2 or NEON when the compiler targets them, plain C otherwise.
+ * Define VECMATH_SCALAR to force the plain C path.
+ */
+#ifndef VECMATH_H
+#define VECMATH_H
+
+#include <SDL3/SDL_stdinc.h>
+
+#if !defined(VECMATH_SCALAR)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VECMATH_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define VECMATH_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+typedef union vec4
+{
+	float f[4];
+#if defined(VECMATH_SSE2)
+	__m128 v;
+#elif defined(VECMATH_NEON)
+	float32x4_t v;
+#endif
+} vec4;
+
+typedef struct mat4
+{
+	vec4 col[4];
+} mat4;
+
+SDL_FORCE_INLINE vec4
+vec4_set(float x, float y, float z, float w)
+{
+	vec4 r;
+#if defined(VECMATH_SSE2)
+	r.v = _mm_setr_ps(x, y, z, w);
+#else
+	r.f[0] = x; r.f[1] = y; r.f[2] = z; r.f[3] = w;
+#endif
+	return r;
+}
+
+SDL_FORCE_INLINE vec4
+vec4_add(vec4 a, vec4 b)
+{
+	vec4 r;
+#if defined(VECMATH_SSE2)
+	r.v = _mm_add_ps(a.v, b.v);
+#elif defined(VECMATH_NEON)
+	r.v = vaddq_f32(a.v, b.v);
+#else
+	for (int i = 0; i < 4; ++i) {
+		r.f[i] = a.f[i] + b.f[i];
+	}
+#endif
+	return r;
+}
+
+/* m * v */
+SDL_FORCE_INLINE vec4
+mat4_mul_vec4(const mat4* m, vec4 v)
+{
+	vec4 r;
+#if defined(VECMATH_SSE2)
+	r.v = _mm_mul_ps(m->col[0].v, _mm_shuffle_ps(v.v, v.v, _MM_SHUFFLE(0, 0, 0, 0)));
+	r.v = _mm_add_ps(r.v, _mm_mul_ps(m->col[1].v, _mm_shuffle_ps(v.v, v.v, _MM_SHUFFLE(1, 1, 1, 1))));
+	r.v = _mm_add_ps(r.v, _mm_mul_ps(m->col[2].v, _mm_shuffle_ps(v.v, v.v, _MM_SHUFFLE(2, 2, 2, 2))));
+	r.v = _mm_add_ps(r.v, _mm_mul_ps(m->col[3].v, _mm_shuffle_ps(v.v, v.v, _MM_SHUFFLE(3, 3, 3, 3))));
+#elif defined(VECMATH_NEON)
+	r.v = vmulq_n_f32(m->col[0].v, v.f[0]);
+	r.v = vmlaq_n_f32(r.v, m->col[1].v, v.f[1]);
+	r.v = vmlaq_n_f32(r.v, m->col[2].v, v.f[2]);
+	r.v = vmlaq_n_f32(r.v, m->col[3].v, v.f[3]);
+#else
+	for (int i = 0; i < 4; ++i) {
+		r.f[i] = m->col[0].f[i] * v.f[0] + m->col[1].f[i] * v.f[1] +
+			m->col[2].f[i] * v.f[2] + m->col[3].f[i] * v.f[3];
+	}
+#endif
+	return r;
+}
+
+/* r = lhs * rhs. r may alias either operand. */
+SDL_FORCE_INLINE void
+mat4_mul(const mat4* lhs, const mat4* rhs, mat4* r)
+{
+	mat4 tmp;
+	tmp.col[0] = mat4_mul_vec4(lhs, rhs->col[0]);
+	tmp.col[1] = mat4_mul_vec4(lhs, rhs->col[1]);
+	tmp.col[2] = mat4_mul_vec4(lhs, rhs->col[2]);
+	tmp.col[3] = mat4_mul_vec4(lhs, rhs->col[3]);
+	*r = tmp;
+}
+
+/*
+ * Equivalent to m * translate(x, y, z), but only touches the translation
+ * column. Cheap enough to do per object once the rest of m is fixed.
+ */
+SDL_FORCE_INLINE void
+mat4_translate(const mat4* m, float x, float y, float z, mat4* r)
+{
+	r->col[0] = m->col[0];
+	r->col[1] = m->col[1];
+	r->col[2] = m->col[2];
+	r->col[3] = mat4_mul_vec4(m, vec4_set(x, y, z, 1.0f));
+}
+
+void mat4_identity(mat4* r);
+
+/* Simulates desktop's glRotatef. Angle is in degrees. */
+void mat4_rotate(float angle, float x, float y, float z, mat4* r);
+
+/* Simulates gluPerspectiveMatrix. fovy is in radians. */
+void mat4_perspective(float fovy, float aspect, float znear, float zfar, mat4* r);
+
+#endif /* VECMATH_H */
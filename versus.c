@@ -0,0 +1,328 @@
+#include "versus.h"
+
+#include <SDL3/SDL_endian.h>
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_timer.h>
+
+/* Snapshots kept; room for VERSUS_MAX_ROLLBACK ticks either way with margin */
+#define VERSUS_RING 64
+
+/* Inputs in one packet, every one the peer can still be missing */
+#define VERSUS_MAX_INPUTS (2 * VERSUS_MAX_ROLLBACK)
+
+#define VERSUS_MAGIC 0x31535654 /* "TVS1" */
+#define VERSUS_HEADER_SIZE 21
+
+/* Everything a tick changes: the two games and the garbage each has coming */
+typedef struct VersusState
+{
+	Tetris games[2];
+	Uint8 garbage[2];
+} VersusState;
+
+/* The state before a tick and the inputs it was simulated with */
+typedef struct VersusFrame
+{
+	VersusState state;
+	Uint8 inputs[2];
+} VersusFrame;
+
+struct Versus
+{
+	NetSocket* socket;
+	NetAddress peer;
+	bool connected;
+
+	VersusState state;                /* before tick */
+	VersusFrame frames[VERSUS_RING];  /* frames[t % VERSUS_RING] for the ticks since remote_next */
+	Uint8 remote_inputs[VERSUS_RING]; /* confirmed, for the ticks before remote_next */
+	Uint32 tick;
+	Uint32 remote_next; /* remote inputs are known for the ticks before this */
+	Uint32 peer_ack;    /* the peer knows our inputs for the ticks before this */
+
+	/* The peer's hash of its state before check_tick, until ours is final too */
+	bool check_pending;
+	Uint32 check_tick;
+	Uint32 check_crc;
+
+	VersusStats stats;
+};
+
+/* Garbage rows for clearing 0 to 4 lines at once */
+static const Uint8 garbage_sent[5] = { 0, 0, 1, 2, 4 };
+
+/*
+ * What the remote player pressed on a tick not heard of yet. Inputs are
+ * key presses, not held keys, and most ticks have none, so repeating the
+ * last one would mostly be wrong: predict nothing.
+ */
+static Uint8
+predict_input(void)
+{
+	return 0;
+}
+
+/* The same on both peers, whichever player is first on each */
+static int
+garbage_hole(Uint32 tick)
+{
+	Uint32 hash = tick * 0x9E3779B1u;
+	return (int)((hash >> 16) % 10);
+}
+
+static void
+step(VersusState* state, const Uint8 inputs[2], Uint32 tick)
+{
+	int cleared[2];
+	for (int p = 0; p < 2; ++p)
+	{
+		Tetris* tetris = &state->games[p];
+		tetris_add_garbage(tetris, state->garbage[p], garbage_hole(tick));
+		state->garbage[p] = 0;
+
+		/* A game over restarts the game, lines and all */
+		Uint32 lines = tetris->lines;
+		tetris_tick(tetris, inputs[p], VERSUS_TICK_NS);
+		cleared[p] = tetris->lines > lines ? (int)(tetris->lines - lines) : 0;
+	}
+	state->garbage[0] = garbage_sent[SDL_min(cleared[1], 4)];
+	state->garbage[1] = garbage_sent[SDL_min(cleared[0], 4)];
+}
+
+/* CRC-32 of a state with the given player's game first, so both peers hash it the same */
+static Uint32
+state_crc(const VersusState* state, int first)
+{
+	Uint32 crc = SDL_crc32(0, &state->games[first], TETRIS_STATE_BYTES);
+	crc = SDL_crc32(crc, &state->games[1 - first], TETRIS_STATE_BYTES);
+	crc = SDL_crc32(crc, &state->garbage[first], 1);
+	return SDL_crc32(crc, &state->garbage[1 - first], 1);
+}
+
+/* The state before tick, if every input up to it is known and it is still kept */
+static const VersusState*
+final_state(const Versus* versus, Uint32 tick)
+{
+	if (tick > versus->tick || tick > versus->remote_next || versus->tick - tick >= VERSUS_RING)
+	{
+		return NULL;
+	}
+	return tick == versus->tick ? &versus->state : &versus->frames[tick % VERSUS_RING].state;
+}
+
+/* Restores the state before tick and simulates again up to the current tick */
+static void
+roll_back(Versus* versus, Uint32 tick)
+{
+	Uint64 start = SDL_GetPerformanceCounter();
+	VersusState state = versus->frames[tick % VERSUS_RING].state;
+	for (Uint32 t = tick; t < versus->tick; ++t)
+	{
+		VersusFrame* frame = &versus->frames[t % VERSUS_RING];
+		frame->state = state;
+		frame->inputs[1] = t < versus->remote_next ? versus->remote_inputs[t % VERSUS_RING] : predict_input();
+		step(&state, frame->inputs, t);
+	}
+	versus->state = state;
+
+	Uint64 ns = (SDL_GetPerformanceCounter() - start) * SDL_NS_PER_SECOND / SDL_GetPerformanceFrequency();
+	Uint32 ticks = versus->tick - tick;
+	versus->stats.rollbacks += 1;
+	versus->stats.resim_ticks += ticks;
+	versus->stats.max_rollback = SDL_max(versus->stats.max_rollback, ticks);
+	versus->stats.resim_ns += ns;
+	versus->stats.max_resim_ns = SDL_max(versus->stats.max_resim_ns, ns);
+}
+
+static Uint32
+read_u32(const Uint8* in)
+{
+	Uint32 value;
+	SDL_memcpy(&value, in, sizeof(value));
+	return SDL_Swap32LE(value);
+}
+
+static void
+write_u32(Uint8* out, Uint32 value)
+{
+	value = SDL_Swap32LE(value);
+	SDL_memcpy(out, &value, sizeof(value));
+}
+
+/*
+ * Takes in one packet's inputs. Returns the first tick that was simulated
+ * with a wrong prediction, or the current tick if none was.
+ */
+static Uint32
+receive_packet(Versus* versus, const Uint8* packet, int size)
+{
+	Uint32 mispredicted = versus->tick;
+	if (size < VERSUS_HEADER_SIZE || read_u32(packet) != VERSUS_MAGIC || size < VERSUS_HEADER_SIZE + packet[20])
+	{
+		return mispredicted;
+	}
+	Uint32 first = read_u32(packet + 4);
+	Uint32 ack = read_u32(packet + 8);
+	versus->connected = true;
+	versus->stats.packets_received += 1;
+	if (ack > versus->peer_ack && ack <= versus->tick)
+	{
+		versus->peer_ack = ack;
+	}
+	if (!versus->check_pending || read_u32(packet + 12) > versus->check_tick)
+	{
+		versus->check_pending = true;
+		versus->check_tick = read_u32(packet + 12);
+		versus->check_crc = read_u32(packet + 16);
+	}
+
+	for (int i = 0; i < packet[20]; ++i)
+	{
+		Uint32 tick = first + i;
+		/* Only the next one in order; the later ones come again until acked */
+		if (tick != versus->remote_next || tick >= versus->tick + VERSUS_RING - VERSUS_MAX_ROLLBACK)
+		{
+			continue;
+		}
+		Uint8 inputs = packet[VERSUS_HEADER_SIZE + i];
+		versus->remote_inputs[tick % VERSUS_RING] = inputs;
+		if (tick < versus->tick && versus->frames[tick % VERSUS_RING].inputs[1] != inputs)
+		{
+			mispredicted = SDL_min(mispredicted, tick);
+		}
+		versus->remote_next += 1;
+	}
+	return mispredicted;
+}
+
+static void
+send_inputs(Versus* versus)
+{
+	Uint8 packet[VERSUS_HEADER_SIZE + VERSUS_MAX_INPUTS];
+
+	Uint32 first = versus->peer_ack;
+	Uint32 count = SDL_min(versus->tick - first, VERSUS_MAX_INPUTS);
+	Uint32 check_tick = SDL_min(versus->tick, versus->remote_next);
+	write_u32(packet, VERSUS_MAGIC);
+	write_u32(packet + 4, first);
+	write_u32(packet + 8, versus->remote_next);
+	write_u32(packet + 12, check_tick);
+	write_u32(packet + 16, state_crc(final_state(versus, check_tick), 0));
+	packet[20] = (Uint8)count;
+	for (Uint32 i = 0; i < count; ++i)
+	{
+		packet[VERSUS_HEADER_SIZE + i] = versus->frames[(first + i) % VERSUS_RING].inputs[0];
+	}
+	if (net_send(versus->socket, &versus->peer, packet, VERSUS_HEADER_SIZE + count))
+	{
+		versus->stats.packets_sent += 1;
+	}
+}
+
+Versus*
+versus_create(NetSocket* socket, const NetAddress* peer)
+{
+	Versus* versus = SDL_calloc(1, sizeof(Versus));
+	if (!versus)
+	{
+		return NULL;
+	}
+	versus->socket = socket;
+	versus->peer = *peer;
+	tetris_reset(&versus->state.games[0]);
+	tetris_reset(&versus->state.games[1]);
+	return versus;
+}
+
+void
+versus_destroy(Versus* versus)
+{
+	SDL_free(versus);
+}
+
+/* Takes in every waiting packet and rolls back if one showed a wrong prediction */
+static void
+receive_all(Versus* versus)
+{
+	Uint8 packet[NET_MAX_PACKET];
+	NetAddress from;
+	int size;
+
+	Uint32 mispredicted = versus->tick;
+	while ((size = net_receive(versus->socket, packet, sizeof(packet), &from)) >= 0)
+	{
+		if (from.host == versus->peer.host && from.port == versus->peer.port)
+		{
+			Uint32 tick = receive_packet(versus, packet, size);
+			mispredicted = SDL_min(mispredicted, tick);
+		}
+	}
+	if (mispredicted < versus->tick)
+	{
+		roll_back(versus, mispredicted);
+	}
+
+	/* Compare hashes once both sides have the same final state */
+	const VersusState* state = versus->check_pending ? final_state(versus, versus->check_tick) : NULL;
+	if (state)
+	{
+		if (state_crc(state, 1) != versus->check_crc)
+		{
+			if (versus->stats.desyncs == 0)
+			{
+				SDL_Log("Versus: out of sync with the peer at tick %u", versus->check_tick);
+			}
+			versus->stats.desyncs += 1;
+		}
+		versus->check_pending = false;
+	}
+	else if (versus->check_pending && versus->tick - SDL_min(versus->tick, versus->check_tick) >= VERSUS_RING)
+	{
+		/* Too old to check any more */
+		versus->check_pending = false;
+	}
+}
+
+void
+versus_poll(Versus* versus)
+{
+	receive_all(versus);
+	send_inputs(versus);
+}
+
+bool
+versus_tick(Versus* versus, Uint32 local_inputs)
+{
+	receive_all(versus);
+	if (!versus->connected || versus->tick >= versus->remote_next + VERSUS_MAX_ROLLBACK)
+	{
+		versus->stats.stalls += 1;
+		send_inputs(versus);
+		return false;
+	}
+
+	VersusFrame* frame = &versus->frames[versus->tick % VERSUS_RING];
+	frame->state = versus->state;
+	frame->inputs[0] = (Uint8)local_inputs;
+	frame->inputs[1] = versus->tick < versus->remote_next ? versus->remote_inputs[versus->tick % VERSUS_RING] : predict_input();
+	step(&versus->state, frame->inputs, versus->tick);
+	versus->tick += 1;
+
+	/* Right away, so the peer predicts as few ticks as it can */
+	send_inputs(versus);
+	return true;
+}
+
+const Tetris*
+versus_boards(const Versus* versus)
+{
+	return versus->state.games;
+}
+
+void
+versus_get_stats(const Versus* versus, VersusStats* stats)
+{
+	*stats = versus->stats;
+	stats->tick = versus->tick;
+	stats->confirmed_tick = SDL_min(versus->tick, versus->remote_next);
+}
@@ -0,0 +1,77 @@
+/*
+ * Two-player versus over UDP with rollback. Both peers run both games in
+ * lockstep at a fixed tick; each tick's key presses are sent to the other
+ * peer, and the remote player's presses that have not arrived yet are
+ * predicted, so neither side waits on the network. When a prediction
+ * turns out wrong, the state before that tick is restored from a ring of
+ * per-tick snapshots and the ticks since are simulated again.
+ *
+ * Lines cleared two or more at a time push garbage rows under the other
+ * player's stack on the next tick, so each game depends on the other and
+ * both roll back together.
+ *
+ * Packet, little endian: "TVS1", first tick, ack (the first of the
+ * receiver's ticks still missing), check tick, check CRC-32 (u32 each),
+ * input count (u8), then that many ticks of TETRIS_INPUT_* bits (u8 each).
+ * Every packet repeats all inputs not acked yet, so a lost one costs
+ * nothing but a later rollback.
+ */
+#ifndef VERSUS_H
+#define VERSUS_H
+
+#include <SDL3/SDL_stdinc.h>
+
+#include "net.h"
+#include "tetris.h"
+
+/* Game time per tick, the same on both peers */
+#define VERSUS_TICK_NS (SDL_NS_PER_SECOND / 60)
+
+/* Ticks a peer may run ahead of the other's last input before it waits */
+#define VERSUS_MAX_ROLLBACK 15
+
+typedef struct Versus Versus;
+
+typedef struct VersusStats
+{
+	Uint32 tick;            /* ticks simulated */
+	Uint32 confirmed_tick;  /* ticks with both players' inputs known */
+	Uint64 rollbacks;       /* times a wrong prediction was re-simulated */
+	Uint64 resim_ticks;     /* ticks simulated again in those */
+	Uint32 max_rollback;    /* most ticks re-simulated at once */
+	Uint64 resim_ns;        /* time spent re-simulating, restores included */
+	Uint64 max_resim_ns;
+	Uint64 stalls;          /* versus_tick calls that had to wait for the peer */
+	Uint64 packets_sent;
+	Uint64 packets_received;
+	Uint64 desyncs;         /* confirmed states the peer hashed differently */
+} VersusStats;
+
+/*
+ * Starts a match against peer, sending and receiving through socket,
+ * which must outlive it. Both games start from tetris_reset once the peer
+ * is heard from. Returns NULL on failure.
+ */
+Versus* versus_create(NetSocket* socket, const NetAddress* peer);
+void versus_destroy(Versus* versus);
+
+/*
+ * Receives what the peer sent, rolls back if it shows a prediction was
+ * wrong, and sends the inputs the peer has not acked.
+ */
+void versus_poll(Versus* versus);
+
+/*
+ * Receives as versus_poll does, then simulates one tick with the local
+ * player's TETRIS_INPUT_* presses and sends them. Returns false without
+ * simulating while the peer has not been heard from or is
+ * VERSUS_MAX_ROLLBACK ticks behind; keep the inputs for the next call.
+ */
+bool versus_tick(Versus* versus, Uint32 local_inputs);
+
+/* Both games as of the latest tick, the local player's first; the remote one may be predicted */
+const Tetris* versus_boards(const Versus* versus);
+
+void versus_get_stats(const Versus* versus, VersusStats* stats);
+
+#endif /* VERSUS_H */